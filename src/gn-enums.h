@@ -63,4 +63,13 @@ typedef enum
   GN_FEATURE_MODIFICATION_DATE = 1 << 6,
 } GnFeature;
 
+/* Should match the SortMode enum in the settings schema */
+typedef enum
+{
+  GN_SORT_MODE_TITLE,
+  GN_SORT_MODE_MODIFICATION_TIME,
+  GN_SORT_MODE_CREATION_TIME,
+  GN_SORT_MODE_COLOR
+} GnSortMode;
+
 G_END_DECLS
@@ -96,6 +96,12 @@ xml_reader_dup_inner_xml (xmlTextReader *reader)
   return (gchar *)xmlTextReaderReadInnerXml (reader);
 }
 
+static inline gboolean
+xml_reader_is_empty_element (xmlTextReader *reader)
+{
+  return xmlTextReaderIsEmptyElement (reader) == 1;
+}
+
 static inline gchar *
 xml_reader_dup_string (xmlTextReader *reader)
 {
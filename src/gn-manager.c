@@ -27,6 +27,8 @@
 #include "gn-goa-provider.h"
 #include "gn-memo-provider.h"
 #include "gn-local-provider.h"
+#include "gn-search-index.h"
+#include "gn-search-query.h"
 #include "gn-settings.h"
 #include "gn-tag-store.h"
 #include "gn-utils.h"
@@ -43,10 +45,13 @@
 /*
  * TODO:
  * 0. The search feature can have lots of improvement.
- *    * Current design assums items are not added/updated/removed midst search
  */
 
 #define MAX_ITEMS_TO_LOAD 30
+/* Delay in milliseconds to wait for more key strokes before searching */
+#define SEARCH_DELAY        100
+/* Search results added to the store in a main loop iteration */
+#define SEARCH_BATCH_SIZE   500
 
 struct _GnManager
 {
@@ -62,17 +67,43 @@ struct _GnManager
 
   GListStore   *list_of_notes_store;
   GListStore   *list_of_trash_store;
+  /* Sorted in the order set in settings, before sliced */
+  GtkSortListModel *notes_sort_model;
+  GtkSortListModel *trash_sort_model;
   GtkSliceListModel *notes_store;
   GtkSliceListModel *trash_store;
-  GtkFilterListModel *search_store;
+  GListStore *search_results;
+  GtkSliceListModel *search_store;
   GListStore *tag_store;
 
   GList       *delete_queue;
 
   /* Search */
-  gchar *search_needle;
+  gchar *search_text;
+  /* The query of search_text, to find matches to highlight */
+  GnSearchQuery *search_query;
+  GnSearchIndex *search_index;
+  GCancellable *search_cancellable;
+  /* The task of the last gn_manager_search_async(), till the results are added */
+  GTask *search_task;
+  /* Results of the last search yet to be added, owned by the documents */
+  GPtrArray *search_items;
+  GPtrArray *search_documents;
+  guint search_items_added;
+  /* Items to be (re)indexed before the next search */
+  GHashTable *search_pending;
+  /* Items being indexed in a thread, if any */
+  GHashTable *search_indexing;
+  GCancellable *index_cancellable;
+  guint search_update_id;
+  guint search_timeout_id;
+  guint search_add_id;
 
   gint providers_to_load;
+
+  /* Time when loading providers started, in microseconds */
+  gint64 load_start_time;
+  gulong first_row_id;
 };
 
 G_DEFINE_TYPE (GnManager, gn_manager, G_TYPE_OBJECT)
@@ -93,16 +124,653 @@ enum {
 static GParamSpec *properties[N_PROPS];
 static guint signals[N_SIGNALS];
 
+static void gn_manager_run_search (GnManager *self);
+
+/*
+ * The fields searched for in an item: the casefolded title and
+ * content as @text, and the casefolded tag names as @tags, in
+ * the format of #GnSearchDocument.  These are built in a thread,
+ * see gn_manager_index_items().
+ */
+typedef struct
+{
+  GnItem *item;
+  gchar  *title;
+  gchar  *content;  /* %NULL for XML notes, loaded in the thread */
+  gchar  *text;
+  gchar  *tags;
+} IndexItem;
+
+static void
+index_item_clear (gpointer data)
+{
+  IndexItem *index_item = data;
+
+  g_clear_object (&index_item->item);
+  g_clear_pointer (&index_item->title, g_free);
+  g_clear_pointer (&index_item->content, g_free);
+  g_clear_pointer (&index_item->text, g_free);
+  g_clear_pointer (&index_item->tags, g_free);
+}
+
+/*
+ * Get the fields of @item that can be read only in the main thread.
+ * The content of XML notes may have to be read from the file, and is
+ * left to the thread.  Their content is guarded, and can be read from
+ * any thread.
+ */
+static void
+gn_manager_get_index_item (GnItem    *item,
+                           IndexItem *index_item)
+{
+  GString *tag_names;
+
+  g_assert (GN_IS_ITEM (item));
+  g_assert (index_item != NULL);
+
+  index_item->item = g_object_ref (item);
+  index_item->title = g_strdup (gn_item_get_title (item));
+  tag_names = g_string_new ("\n");
+
+  if (GN_IS_NOTE (item))
+    {
+      if (!GN_IS_XML_NOTE (item))
+        index_item->content = gn_note_get_text_content (GN_NOTE (item));
+
+      for (GList *node = gn_note_get_tags (GN_NOTE (item)); node != NULL; node = node->next)
+        {
+          g_autofree gchar *name = NULL;
+
+          name = g_utf8_casefold (gn_tag_get_name (node->data), -1);
+          g_string_append (tag_names, name);
+          g_string_append_c (tag_names, '\n');
+        }
+    }
+
+  index_item->tags = g_string_free (tag_names, FALSE);
+}
+
+static void
+gn_manager_index_thread (GTask        *task,
+                         gpointer      source_object,
+                         gpointer      task_data,
+                         GCancellable *cancellable)
+{
+  GArray *index_items = task_data;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (index_items != NULL);
+
+  for (guint i = 0; i < index_items->len; i++)
+    {
+      IndexItem *index_item = &g_array_index (index_items, IndexItem, i);
+      g_autofree gchar *full_text = NULL;
+
+      if (g_task_return_error_if_cancelled (task))
+        return;
+
+      if (GN_IS_XML_NOTE (index_item->item))
+        index_item->content = gn_note_get_text_content (GN_NOTE (index_item->item));
+
+      full_text = g_strconcat (index_item->title, "\n", index_item->content, NULL);
+      index_item->text = g_utf8_casefold (full_text, -1);
+    }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+static void
+gn_manager_index_cb (GObject      *object,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+  GnManager *self = (GnManager *)object;
+  GArray *index_items;
+
+  GN_ENTRY;
+
+  g_assert (GN_IS_MANAGER (self));
+  g_assert (G_IS_TASK (result));
+
+  if (!g_task_propagate_boolean (G_TASK (result), NULL))
+    GN_EXIT;
+
+  index_items = g_task_get_task_data (G_TASK (result));
+
+  /* Items removed while indexing are no more in @search_indexing */
+  for (guint i = 0; i < index_items->len; i++)
+    {
+      IndexItem *index_item = &g_array_index (index_items, IndexItem, i);
+
+      if (!g_hash_table_contains (self->search_indexing, index_item->item))
+        continue;
+
+      gn_search_index_add_full (self->search_index, g_object_ref (index_item->item),
+                                index_item->text, index_item->tags,
+                                gn_item_get_modification_time (index_item->item));
+    }
+
+  g_clear_pointer (&self->search_indexing, g_hash_table_unref);
+
+  /* Items changed while indexing are pending again, and are indexed first */
+  if (self->search_text != NULL)
+    gn_manager_run_search (self);
+
+  GN_EXIT;
+}
+
+/*
+ * Index the items changed since the last search in a thread, as the
+ * content of the items may have to be loaded from files.  The search
+ * is run again once done.
+ */
+static void
+gn_manager_index_items (GnManager *self)
+{
+  g_autoptr(GTask) task = NULL;
+  GHashTableIter iter;
+  GArray *index_items;
+  gpointer item;
+
+  GN_ENTRY;
+
+  g_assert (GN_IS_MANAGER (self));
+  g_assert (self->search_indexing == NULL);
+
+  index_items = g_array_sized_new (FALSE, TRUE, sizeof (IndexItem),
+                                   g_hash_table_size (self->search_pending));
+  g_array_set_clear_func (index_items, index_item_clear);
+
+  g_hash_table_iter_init (&iter, self->search_pending);
+  while (g_hash_table_iter_next (&iter, &item, NULL))
+    {
+      IndexItem index_item = { 0 };
+
+      gn_manager_get_index_item (item, &index_item);
+      g_array_append_val (index_items, index_item);
+    }
+
+  self->search_indexing = g_steal_pointer (&self->search_pending);
+  self->search_pending = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                g_object_unref, NULL);
+
+  task = g_task_new (self, self->index_cancellable, gn_manager_index_cb, NULL);
+  g_task_set_source_tag (task, gn_manager_index_items);
+  g_task_set_task_data (task, index_items, (GDestroyNotify)g_array_unref);
+  g_task_run_in_thread (task, gn_manager_index_thread);
+
+  GN_EXIT;
+}
+
+/* The search run in a thread, see gn_manager_run_search() */
+typedef struct
+{
+  GnSearchQuery *query;
+  GPtrArray     *documents;
+  gint64         now;
+} SearchData;
+
+static void
+search_data_free (gpointer data)
+{
+  SearchData *search_data = data;
+
+  g_clear_pointer (&search_data->query, gn_search_query_free);
+  g_clear_pointer (&search_data->documents, g_ptr_array_unref);
+  g_slice_free (SearchData, search_data);
+}
+
+static void
+gn_manager_search_thread (GTask        *task,
+                          gpointer      source_object,
+                          gpointer      task_data,
+                          GCancellable *cancellable)
+{
+  SearchData *search_data = task_data;
+  GPtrArray *items;
+  GError *error = NULL;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (search_data != NULL);
+
+  items = gn_search_query_evaluate (search_data->query, search_data->documents,
+                                    search_data->now, cancellable, &error);
+
+  if (error != NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, items, (GDestroyNotify)g_ptr_array_unref);
+}
+
+/* Complete the task of gn_manager_search_async(), if any */
+static void
+gn_manager_complete_search (GnManager *self,
+                            GError    *error)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_assert (GN_IS_MANAGER (self));
+
+  task = g_steal_pointer (&self->search_task);
+
+  if (task == NULL)
+    {
+      g_clear_error (&error);
+      return;
+    }
+
+  if (error != NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+/* Cancel the search in progress, and stop adding its results */
+static void
+gn_manager_stop_search (GnManager *self)
+{
+  g_assert (GN_IS_MANAGER (self));
+
+  g_cancellable_cancel (self->search_cancellable);
+  g_clear_object (&self->search_cancellable);
+
+  if (self->search_add_id != 0)
+    g_source_remove (self->search_add_id);
+  self->search_add_id = 0;
+
+  g_clear_pointer (&self->search_items, g_ptr_array_unref);
+  g_clear_pointer (&self->search_documents, g_ptr_array_unref);
+  self->search_items_added = 0;
+}
+
+/*
+ * Add the next batch of search results to the store, replacing
+ * the old results with the first batch.  Returns %TRUE if there
+ * are more results to be added.
+ */
 static gboolean
-gn_manager_search_filter (gpointer item,
-                          gpointer pp)
+gn_manager_add_search_results (GnManager *self)
 {
-  gchar *search_string = *(gchar **)pp;
+  GTask *task = self->search_task;
+  GPtrArray *items = self->search_items;
+  guint n_items, position, removed;
 
-  if (search_string == NULL)
-    return FALSE;
+  GN_ENTRY;
+
+  g_assert (GN_IS_MANAGER (self));
+  g_assert (items != NULL);
+
+  if (task != NULL && g_task_return_error_if_cancelled (task))
+    {
+      g_clear_object (&self->search_task);
+      gn_manager_stop_search (self);
+      GN_RETURN (FALSE);
+    }
+
+  n_items = MIN (SEARCH_BATCH_SIZE, items->len - self->search_items_added);
+
+  if (self->search_items_added == 0)
+    {
+      position = 0;
+      removed = g_list_model_get_n_items (G_LIST_MODEL (self->search_results));
+    }
+  else
+    {
+      position = g_list_model_get_n_items (G_LIST_MODEL (self->search_results));
+      removed = 0;
+    }
+
+  g_list_store_splice (self->search_results, position, removed,
+                       items->pdata + self->search_items_added, n_items);
+  self->search_items_added += n_items;
+
+  if (self->search_items_added < items->len)
+    GN_RETURN (TRUE);
+
+  g_clear_pointer (&self->search_items, g_ptr_array_unref);
+  g_clear_pointer (&self->search_documents, g_ptr_array_unref);
+  self->search_items_added = 0;
+  gn_manager_complete_search (self, NULL);
+
+  GN_RETURN (FALSE);
+}
+
+static gboolean
+gn_manager_add_search_results_cb (gpointer user_data)
+{
+  GnManager *self = user_data;
+
+  g_assert (GN_IS_MANAGER (self));
+
+  if (gn_manager_add_search_results (self))
+    return G_SOURCE_CONTINUE;
+
+  self->search_add_id = 0;
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gn_manager_search_cb (GObject      *object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+  GnManager *self = (GnManager *)object;
+  g_autoptr(GPtrArray) items = NULL;
+  g_autoptr(GHashTable) delete_queue = NULL;
+  GError *error = NULL;
+  SearchData *search_data;
+
+  GN_ENTRY;
+
+  g_assert (GN_IS_MANAGER (self));
+  g_assert (G_IS_TASK (result));
+
+  search_data = g_task_get_task_data (G_TASK (result));
+  items = g_task_propagate_pointer (G_TASK (result), &error);
+
+  /* Cancelled searches are superseded by a new one */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_clear_error (&error);
+      goto out;
+    }
+
+  if (error != NULL)
+    {
+      g_warning ("Error searching items: %s", error->message);
+      gn_manager_complete_search (self, error);
+      goto out;
+    }
+
+  /* Items queued for deletion are still in the index, as they may be restored */
+  if (self->delete_queue != NULL)
+    {
+      guint n = 0;
+
+      delete_queue = g_hash_table_new (g_direct_hash, g_direct_equal);
+      for (GList *node = self->delete_queue; node != NULL; node = node->next)
+        g_hash_table_add (delete_queue, node->data);
+
+      for (guint i = 0; i < items->len; i++)
+        if (!g_hash_table_contains (delete_queue, items->pdata[i]))
+          items->pdata[n++] = items->pdata[i];
+
+      g_ptr_array_set_size (items, n);
+    }
+
+  g_clear_object (&self->search_cancellable);
+
+  /*
+   * Add the results in batches, so that large number of results
+   * don't block the UI.  The first batch has the best results,
+   * which are the ones shown first.
+   */
+  self->search_items = g_steal_pointer (&items);
+  self->search_documents = g_steal_pointer (&search_data->documents);
+  self->search_items_added = 0;
+
+  if (gn_manager_add_search_results (self))
+    self->search_add_id = g_idle_add (gn_manager_add_search_results_cb, self);
+
+ out:
+  /*
+   * The items are owned by the documents, and the last reference
+   * of an item may be dropped with them, which should be done here
+   * in the main thread.
+   */
+  g_clear_pointer (&search_data->documents, g_ptr_array_unref);
+
+  GN_EXIT;
+}
+
+/*
+ * Run the current query, and update the search results.  The
+ * documents to be matched are collected from the index here,
+ * and are matched in a thread, so that the UI isn't blocked
+ * on large number of items.  A search in progress is cancelled.
+ * Items changed since the last search are indexed first, also
+ * in a thread.
+ */
+static void
+gn_manager_run_search (GnManager *self)
+{
+  g_autoptr(GTask) task = NULL;
+  SearchData *search_data;
+
+  GN_ENTRY;
+
+  g_assert (GN_IS_MANAGER (self));
+
+  gn_manager_stop_search (self);
+
+  if (self->search_update_id != 0)
+    g_source_remove (self->search_update_id);
+  self->search_update_id = 0;
+
+  if (self->search_timeout_id != 0)
+    g_source_remove (self->search_timeout_id);
+  self->search_timeout_id = 0;
+
+  if (self->search_text == NULL)
+    {
+      g_list_store_remove_all (self->search_results);
+      gn_manager_complete_search (self, NULL);
+      GN_EXIT;
+    }
+
+  /* The search is run again when the items are indexed */
+  if (self->search_indexing != NULL)
+    GN_EXIT;
+
+  if (g_hash_table_size (self->search_pending) > 0)
+    {
+      gn_manager_index_items (self);
+      GN_EXIT;
+    }
+
+  search_data = g_slice_new0 (SearchData);
+  search_data->query = gn_search_query_new (self->search_text);
+  gn_search_query_set_max_distance (search_data->query,
+                                    gn_settings_get_search_max_distance (self->settings));
+  search_data->documents = gn_search_query_collect (search_data->query,
+                                                    self->search_index);
+  search_data->now = g_get_real_time () / G_USEC_PER_SEC;
+
+  self->search_cancellable = g_cancellable_new ();
+  task = g_task_new (self, self->search_cancellable, gn_manager_search_cb, NULL);
+  g_task_set_source_tag (task, gn_manager_run_search);
+  g_task_set_task_data (task, search_data, search_data_free);
+  g_task_run_in_thread (task, gn_manager_search_thread);
+
+  GN_EXIT;
+}
+
+static gboolean
+gn_manager_update_search_cb (gpointer user_data)
+{
+  GnManager *self = user_data;
+
+  g_assert (GN_IS_MANAGER (self));
+
+  self->search_update_id = 0;
+  gn_manager_run_search (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+gn_manager_search_timeout_cb (gpointer user_data)
+{
+  GnManager *self = user_data;
+
+  g_assert (GN_IS_MANAGER (self));
+
+  self->search_timeout_id = 0;
+  gn_manager_run_search (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Run the search again when the main loop is idle, if
+ * there's an ongoing search, so that changes to many items
+ * (eg: when a provider is loaded) run the search only once.
+ */
+static void
+gn_manager_queue_search_update (GnManager *self)
+{
+  g_assert (GN_IS_MANAGER (self));
+
+  /* The search is run with the pending timeout, if any */
+  if (self->search_text == NULL ||
+      self->search_update_id != 0 ||
+      self->search_timeout_id != 0)
+    return;
+
+  self->search_update_id = g_idle_add (gn_manager_update_search_cb, self);
+}
+
+static void
+gn_manager_search_settings_changed_cb (GnManager   *self,
+                                       const gchar *key,
+                                       GSettings   *settings)
+{
+  g_assert (GN_IS_MANAGER (self));
+
+  gn_manager_queue_search_update (self);
+}
+
+static GCompareDataFunc
+gn_manager_get_sort_func (GnManager *self)
+{
+  g_assert (GN_IS_MANAGER (self));
+
+  switch (gn_settings_get_sort_mode (self->settings))
+    {
+    case GN_SORT_MODE_MODIFICATION_TIME:
+      return gn_item_compare_modification_time;
+
+    case GN_SORT_MODE_CREATION_TIME:
+      return gn_item_compare_creation_time;
+
+    case GN_SORT_MODE_COLOR:
+      return gn_item_compare_color;
+
+    case GN_SORT_MODE_TITLE:
+    default:
+      return gn_item_compare;
+    }
+}
+
+static void
+gn_manager_sort_mode_changed_cb (GnManager   *self,
+                                 const gchar *key,
+                                 GSettings   *settings)
+{
+  GCompareDataFunc sort_func;
+
+  GN_ENTRY;
+
+  g_assert (GN_IS_MANAGER (self));
+
+  /*
+   * Setting the function resorts the whole model once.  Items
+   * added, removed or changed later are moved one at a time.
+   */
+  sort_func = gn_manager_get_sort_func (self);
+  gtk_sort_list_model_set_sort_func (self->notes_sort_model,
+                                     sort_func, NULL, NULL);
+  gtk_sort_list_model_set_sort_func (self->trash_sort_model,
+                                     sort_func, NULL, NULL);
+
+  GN_EXIT;
+}
+
+static void
+gn_manager_item_changed_cb (GnManager  *self,
+                            GnItem     *item,
+                            GnProvider *provider)
+{
+  g_assert (GN_IS_MANAGER (self));
+  g_assert (GN_IS_ITEM (item));
+
+  g_hash_table_add (self->search_pending, g_object_ref (item));
+  gn_manager_queue_search_update (self);
+}
+
+static void
+gn_manager_item_removed_cb (GnManager  *self,
+                            GnItem     *item,
+                            GnProvider *provider)
+{
+  g_assert (GN_IS_MANAGER (self));
+  g_assert (GN_IS_ITEM (item));
 
-  return gn_item_match (GN_ITEM (item), search_string);
+  g_hash_table_remove (self->search_pending, item);
+  if (self->search_indexing != NULL)
+    g_hash_table_remove (self->search_indexing, item);
+  gn_search_index_remove (self->search_index, item);
+  gn_manager_queue_search_update (self);
+}
+
+static void
+gn_manager_items_changed_cb (GnManager  *self,
+                             GPtrArray  *items,
+                             GnProvider *provider)
+{
+  g_assert (GN_IS_MANAGER (self));
+  g_assert (items != NULL);
+
+  for (guint i = 0; i < items->len; i++)
+    g_hash_table_add (self->search_pending, g_object_ref (items->pdata[i]));
+
+  gn_manager_queue_search_update (self);
+}
+
+static void
+gn_manager_items_removed_cb (GnManager  *self,
+                             GPtrArray  *items,
+                             GnProvider *provider)
+{
+  g_assert (GN_IS_MANAGER (self));
+  g_assert (items != NULL);
+
+  for (guint i = 0; i < items->len; i++)
+    {
+      g_hash_table_remove (self->search_pending, items->pdata[i]);
+      if (self->search_indexing != NULL)
+        g_hash_table_remove (self->search_indexing, items->pdata[i]);
+      gn_search_index_remove (self->search_index, items->pdata[i]);
+    }
+
+  gn_manager_queue_search_update (self);
+}
+
+static void
+gn_manager_provider_items_changed_cb (GnManager  *self,
+                                      guint       position,
+                                      guint       removed,
+                                      guint       added,
+                                      GListModel *model)
+{
+  g_assert (GN_IS_MANAGER (self));
+  g_assert (G_IS_LIST_MODEL (model));
+
+  /*
+   * Removed items are left in the index till they are trashed
+   * or deleted, as they may be restored back.
+   */
+  for (guint i = position; i < position + added; i++)
+    {
+      g_autoptr(GnItem) item = g_list_model_get_item (model, i);
+
+      if (!gn_search_index_contains (self->search_index, item))
+        g_hash_table_add (self->search_pending, g_object_ref (item));
+    }
+
+  if (added > 0)
+    gn_manager_queue_search_update (self);
 }
 
 void
@@ -158,16 +826,69 @@ gn_manager_save_item_cb (GObject      *object,
     g_warning ("Failed to save item: %s", error->message);
 }
 
-/* Load items from the provider to the store and queue */
+static void
+gn_manager_notes_changed_cb (GnManager  *self,
+                             guint       position,
+                             guint       removed,
+                             guint       added,
+                             GListModel *model)
+{
+  gint64 elapsed;
+
+  g_assert (GN_IS_MANAGER (self));
+  g_assert (G_IS_LIST_MODEL (model));
+
+  if (g_list_model_get_n_items (model) == 0)
+    return;
+
+  elapsed = g_get_monotonic_time () - self->load_start_time;
+  g_debug ("Time to first row: %.3f ms", elapsed / 1000.0);
+
+  g_signal_handler_disconnect (model, self->first_row_id);
+  self->first_row_id = 0;
+}
+
+/*
+ * Add the stores of the provider to the list of stores.  This is
+ * done before the provider is loaded so that the items are shown
+ * as soon as the provider adds them to the stores.
+ */
 static void
 gn_manager_load_items (GnManager  *self,
                        GnProvider *provider)
 {
-  GListStore *items;
+  GnItemStore *items;
 
   items = gn_provider_get_notes (provider);
   if (items != NULL)
-    g_list_store_append (self->list_of_notes_store, items);
+    {
+      g_list_store_append (self->list_of_notes_store, items);
+      g_signal_connect_object (items, "items-changed",
+                               G_CALLBACK (gn_manager_provider_items_changed_cb),
+                               self, G_CONNECT_SWAPPED);
+      gn_manager_provider_items_changed_cb (self, 0, 0,
+                                            g_list_model_get_n_items (G_LIST_MODEL (items)),
+                                            G_LIST_MODEL (items));
+    }
+
+  g_signal_connect_object (provider, "item-added",
+                           G_CALLBACK (gn_manager_item_changed_cb),
+                           self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (provider, "item-trashed",
+                           G_CALLBACK (gn_manager_item_removed_cb),
+                           self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (provider, "item-deleted",
+                           G_CALLBACK (gn_manager_item_removed_cb),
+                           self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (provider, "items-added",
+                           G_CALLBACK (gn_manager_items_changed_cb),
+                           self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (provider, "items-trashed",
+                           G_CALLBACK (gn_manager_items_removed_cb),
+                           self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (provider, "items-deleted",
+                           G_CALLBACK (gn_manager_items_removed_cb),
+                           self, G_CONNECT_SWAPPED);
 
   items = gn_provider_get_trash_notes (provider);
   if (items != NULL)
@@ -186,9 +907,8 @@ gn_manager_items_loaded_cb (GObject      *object,
   g_assert (GN_IS_PROVIDER (provider));
   g_assert (GN_IS_MANAGER (self));
 
-  if (gn_provider_load_items_finish (provider, result, &error))
-    gn_manager_load_items (self, provider);
-  else if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+  if (!gn_provider_load_items_finish (provider, result, &error) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
     g_warning ("Failed to load items: %s", error->message);
 
   g_signal_emit (self, signals[PROVIDER_ADDED], 0, provider);
@@ -206,6 +926,7 @@ gn_manager_load_and_save_provider (GnManager *self,
                        gn_provider_get_uid (provider),
                        provider);
   gn_manager_increment_pending_providers (self);
+  gn_manager_load_items (self, provider);
   gn_provider_load_items_async (provider,
                                 self->provider_cancellable,
                                 gn_manager_items_loaded_cb, self);
@@ -308,9 +1029,40 @@ gn_manager_dispose (GObject *object)
 
   g_clear_object (&self->settings);
 
+  if (self->first_row_id != 0)
+    g_signal_handler_disconnect (self->notes_store, self->first_row_id);
+  self->first_row_id = 0;
+
   g_clear_object (&self->notes_store);
+  g_clear_object (&self->trash_store);
+  g_clear_object (&self->notes_sort_model);
+  g_clear_object (&self->trash_sort_model);
   g_clear_pointer (&self->providers, g_hash_table_unref);
 
+  if (self->search_update_id != 0)
+    g_source_remove (self->search_update_id);
+  self->search_update_id = 0;
+
+  if (self->search_timeout_id != 0)
+    g_source_remove (self->search_timeout_id);
+  self->search_timeout_id = 0;
+
+  gn_manager_stop_search (self);
+
+  if (self->search_task != NULL)
+    gn_manager_complete_search (self, g_error_new (G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                                   "Search cancelled"));
+
+  g_clear_object (&self->search_store);
+  g_clear_object (&self->search_results);
+  g_clear_pointer (&self->search_text, g_free);
+  g_clear_pointer (&self->search_query, gn_search_query_free);
+  g_cancellable_cancel (self->index_cancellable);
+  g_clear_object (&self->index_cancellable);
+  g_clear_pointer (&self->search_pending, g_hash_table_unref);
+  g_clear_pointer (&self->search_indexing, g_hash_table_unref);
+  g_clear_pointer (&self->search_index, gn_search_index_free);
+
   G_OBJECT_CLASS (gn_manager_parent_class)->dispose (object);
 
   GN_EXIT;
@@ -414,6 +1166,12 @@ gn_manager_init (GnManager *self)
   GtkFlattenListModel *model;
 
   self->settings = gn_settings_new (PACKAGE_ID);
+  g_signal_connect_object (self->settings, "changed::search-max-distance",
+                           G_CALLBACK (gn_manager_search_settings_changed_cb),
+                           self, G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->settings, "changed::sort-mode",
+                           G_CALLBACK (gn_manager_sort_mode_changed_cb),
+                           self, G_CONNECT_SWAPPED);
 
   self->providers = g_hash_table_new_full (g_str_hash, g_str_equal,
                                            g_free, NULL);
@@ -421,20 +1179,40 @@ gn_manager_init (GnManager *self)
   self->list_of_trash_store = g_list_store_new (G_TYPE_LIST_MODEL);
   model = gtk_flatten_list_model_new (GN_TYPE_ITEM,
                                       G_LIST_MODEL (self->list_of_notes_store));
-  self->notes_store = gtk_slice_list_model_new (G_LIST_MODEL (model),
+  self->notes_sort_model = gtk_sort_list_model_new (G_LIST_MODEL (model),
+                                                    gn_manager_get_sort_func (self),
+                                                    NULL, NULL);
+  self->notes_store = gtk_slice_list_model_new (G_LIST_MODEL (self->notes_sort_model),
                                                 0, MAX_ITEMS_TO_LOAD);
   g_object_unref (model);
+
+  /*
+   * Search every note, not just the ones loaded to notes_store.
+   * The results are then loaded in slices the same way.
+   */
+  self->search_results = g_list_store_new (GN_TYPE_ITEM);
+  self->search_store = gtk_slice_list_model_new (G_LIST_MODEL (self->search_results),
+                                                 0, MAX_ITEMS_TO_LOAD);
+
   model = gtk_flatten_list_model_new (GN_TYPE_ITEM,
                                       G_LIST_MODEL (self->list_of_trash_store));
-  self->trash_store = gtk_slice_list_model_new (G_LIST_MODEL (model),
+  self->trash_sort_model = gtk_sort_list_model_new (G_LIST_MODEL (model),
+                                                    gn_manager_get_sort_func (self),
+                                                    NULL, NULL);
+  self->trash_store = gtk_slice_list_model_new (G_LIST_MODEL (self->trash_sort_model),
                                                 0, MAX_ITEMS_TO_LOAD);
   g_object_unref (model);
   self->provider_cancellable = g_cancellable_new ();
 
-  self->search_store = gtk_filter_list_model_new (G_LIST_MODEL (self->notes_store),
-                                                  gn_manager_search_filter,
-                                                  &self->search_needle, NULL);
+  self->search_index = gn_search_index_new (g_object_unref);
+  self->search_pending = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                g_object_unref, NULL);
+  self->index_cancellable = g_cancellable_new ();
 
+  self->load_start_time = g_get_monotonic_time ();
+  self->first_row_id = g_signal_connect_swapped (self->notes_store, "items-changed",
+                                                 G_CALLBACK (gn_manager_notes_changed_cb),
+                                                 self);
   gn_manager_load_providers (self);
 }
 
@@ -504,7 +1282,8 @@ gn_manager_get_default_provider (GnManager *self,
  * gn_manager_get_notes_store:
  * @self: A #GnManager
  *
- * Get a sorted list of notes loaded from providers.
+ * Get a list of notes loaded from providers, sorted in
+ * the order set in #GnSettings:sort-mode.
  *
  * Returns: (transfer none): a #GListStore
  */
@@ -532,7 +1311,8 @@ gn_manager_get_tag_store (GnManager *self)
  * gn_manager_get_trash_notes_store:
  * @self: A #GnManager
  *
- * Get a sorted list of trashed notes loaded from providers.
+ * Get a list of trashed notes loaded from providers, sorted
+ * in the order set in #GnSettings:sort-mode.
  *
  * Returns: (transfer none): a #GListStore
  */
@@ -546,9 +1326,11 @@ gn_manager_get_trash_notes_store (GnManager *self)
  * gn_manager_get_search_store:
  * @self: A #GnManager
  *
- * Get a sorted list of items for search results.
+ * Get a list of items for search results, sorted by
+ * rank.  The results are from every note of all providers,
+ * and are loaded in slices like the notes store.
  *
- * Returns: (transfer none): a #GListStore
+ * Returns: (transfer none): a #GtkSliceListModel
  */
 GListModel *
 gn_manager_get_search_store (GnManager *self)
@@ -602,6 +1384,50 @@ gn_manager_save_item (GnManager *self,
                                gn_manager_save_item_cb, NULL);
 }
 
+/*
+ * Group @items by their provider.  Returns a #GHashTable of
+ * #GnProvider to a #GPtrArray of its items, in the same order.
+ */
+static GHashTable *
+gn_manager_group_by_provider (GList *items)
+{
+  GHashTable *groups;
+
+  groups = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                  (GDestroyNotify)g_ptr_array_unref);
+
+  for (GList *node = items; node != NULL; node = node->next)
+    {
+      GnProvider *provider;
+      GPtrArray *group;
+
+      provider = g_object_get_data (G_OBJECT (node->data), "provider");
+      g_assert (GN_IS_PROVIDER (provider));
+      group = g_hash_table_lookup (groups, provider);
+
+      if (group == NULL)
+        {
+          group = g_ptr_array_new ();
+          g_hash_table_insert (groups, provider, group);
+        }
+
+      g_ptr_array_add (group, node->data);
+    }
+
+  return groups;
+}
+
+static void
+gn_manager_trash_items_cb (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  g_autoptr(GError) error = NULL;
+
+  if (!gn_provider_trash_items_finish (GN_PROVIDER (object), result, &error))
+    g_warning ("Error deleting items: %s", error->message);
+}
+
 /**
  * gn_manager_queue_for_delete:
  * @self: A #GnManager
@@ -621,33 +1447,42 @@ gn_manager_queue_for_delete (GnManager  *self,
                              GListModel *note_store,
                              GList      *items)
 {
-  guint position;
+  g_autoptr(GHashTable) groups = NULL;
+  GHashTableIter iter;
+  gpointer provider, group;
   guint count = 0;
 
+  GN_ENTRY;
+
   g_return_if_fail (GN_IS_MANAGER (self));
   g_return_if_fail (G_IS_LIST_MODEL (note_store));
 
   self->delete_queue = items;
 
-  /* FIXME: The story is very different when notebooks come into scene */
-  for (GList *node = items; node != NULL; node = node->next)
-    {
-      GListStore *notes_store;
-      GnProvider *provider;
+  /*
+   * FIXME: The story is very different when notebooks come into scene
+   *
+   * Each range of adjacent items is removed at once, so that the
+   * views update once per range instead of once per item.
+   */
+  groups = gn_manager_group_by_provider (items);
+  g_hash_table_iter_init (&iter, groups);
 
-      provider = g_object_get_data (G_OBJECT (node->data), "provider");
-      notes_store = gn_provider_get_notes (provider);
+  while (g_hash_table_iter_next (&iter, &provider, &group))
+    {
+      GPtrArray *provider_items = group;
 
-      if (gn_utils_get_item_position (G_LIST_MODEL (notes_store),
-                                      node->data, &position))
-        {
-          g_list_store_remove (notes_store, position);
-          count++;
-        }
+      count += gn_item_store_remove_items (gn_provider_get_notes (provider),
+                                           (GnItem **)provider_items->pdata,
+                                           provider_items->len);
     }
 
   if (count > 0)
     g_signal_emit (self, signals[DELETE_ITEMS], 0, count);
+
+  gn_manager_queue_search_update (self);
+
+  GN_EXIT;
 }
 
 /**
@@ -663,21 +1498,26 @@ gn_manager_queue_for_delete (GnManager  *self,
 gboolean
 gn_manager_dequeue_delete (GnManager *self)
 {
+  g_autoptr(GHashTable) groups = NULL;
+  GHashTableIter iter;
+  gpointer provider, group;
+
   g_return_val_if_fail (GN_IS_MANAGER (self), FALSE);
 
   if (self->delete_queue == NULL)
     return FALSE;
 
-  for (GList *node = self->delete_queue; node != NULL; node = node->next)
-    {
-      GListStore *notes_store;
-      GnProvider *provider;
+  groups = gn_manager_group_by_provider (self->delete_queue);
+  g_hash_table_iter_init (&iter, groups);
 
-      provider = g_object_get_data (G_OBJECT (node->data), "provider");
-      notes_store = gn_provider_get_notes (provider);
+  while (g_hash_table_iter_next (&iter, &provider, &group))
+    {
+      GPtrArray *provider_items = group;
 
-      g_list_store_insert_sorted (notes_store, node->data,
-                                  gn_item_compare, NULL);
+      gn_item_store_insert_sorted_items (gn_provider_get_notes (provider),
+                                         (GnItem **)provider_items->pdata,
+                                         provider_items->len,
+                                         gn_item_compare, NULL);
     }
 
   g_clear_pointer (&self->delete_queue, g_list_free);
@@ -694,46 +1534,197 @@ gn_manager_dequeue_delete (GnManager *self)
 void
 gn_manager_trash_queue_items (GnManager *self)
 {
-  g_return_if_fail (GN_IS_MANAGER (self));
+  g_autoptr(GHashTable) groups = NULL;
+  GHashTableIter iter;
+  gpointer provider, group;
 
-  for (GList *node = self->delete_queue; node != NULL; node = node->next)
-    {
-      g_autoptr(GError) error = NULL;
-      GnProvider *provider;
+  GN_ENTRY;
 
-      provider = g_object_get_data (G_OBJECT (node->data), "provider");
-      gn_provider_trash_item (provider, node->data, NULL, &error);
+  g_return_if_fail (GN_IS_MANAGER (self));
 
-      if (error != NULL)
-        g_warning ("Error deleting item: %s", error->message);
-    }
+  /* The files are moved in a worker, one batch per provider */
+  groups = gn_manager_group_by_provider (self->delete_queue);
+  g_hash_table_iter_init (&iter, groups);
+
+  while (g_hash_table_iter_next (&iter, &provider, &group))
+    gn_provider_trash_items_async (provider, group, NULL,
+                                   gn_manager_trash_items_cb, NULL);
 
   g_clear_pointer (&self->delete_queue, g_list_free);
+
+  GN_EXIT;
 }
 
 /**
- * gn_manager_search:
+ * gn_manager_search_async:
  * @self: A #GnManager
  * @terms: A %NULL terminated array of strings
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: a #GAsyncReadyCallback, or %NULL
+ * @user_data: closure data for @callback
+ *
+ * Search for items that match @terms.  The search
+ * store is then updated with the matching items, the
+ * best ranked first.  The store can be retrieved with
+ * gn_manager_get_search_store().
  *
- * Asynchronously search for items that matches
- * @terms.  The seach store shall be then updated
- * in the main thread.  The store can be retrieved
- * with gn_manager_get_search_store().
+ * @terms are joined with spaces, and parsed as a
+ * #GnSearchQuery.  The search store is kept updated
+ * as items change, till the search is cleared with
+ * an empty query.
  *
- * Currently only text search is supported.  That
- * is, the first string from @terms is searched.
- * The rest is ignored.
+ * The search is run after a short delay, so that searches
+ * in quick succession (eg: as the user types) run only the
+ * last one.  The items are matched in a thread, and are added
+ * to the store in batches, the best ranked first.  A search
+ * supersedes the earlier one, which then completes with
+ * %G_IO_ERROR_CANCELLED, as does a search whose @cancellable
+ * is cancelled before every result is added.  An empty query
+ * clears the store immediately.
  */
 void
-gn_manager_search (GnManager    *self,
-                   const gchar **terms)
+gn_manager_search_async (GnManager           *self,
+                         const gchar        **terms,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
 {
+  g_autoptr(GTask) task = NULL;
+  g_autofree gchar *query = NULL;
+
+  GN_ENTRY;
+
   g_return_if_fail (GN_IS_MANAGER (self));
+  g_return_if_fail (terms != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gn_manager_search_async);
+
+  if (self->search_task != NULL)
+    gn_manager_complete_search (self, g_error_new (G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                                   "Search superseded"));
+  self->search_task = g_steal_pointer (&task);
+
+  g_clear_pointer (&self->search_text, g_free);
+  g_clear_pointer (&self->search_query, gn_search_query_free);
+
+  query = g_strjoinv (" ", (gchar **)terms);
+  g_strstrip (query);
+
+  if (query[0] != '\0')
+    {
+      self->search_query = gn_search_query_new (query);
+      self->search_text = g_steal_pointer (&query);
+    }
+
+  /* Show only the first few results of a new search */
+  gtk_slice_list_model_set_size (self->search_store, MAX_ITEMS_TO_LOAD);
+
+  if (self->search_text == NULL)
+    {
+      gn_manager_run_search (self);
+      GN_EXIT;
+    }
+
+  /* Stop the old search, as its results are no longer needed */
+  gn_manager_stop_search (self);
+
+  if (self->search_update_id != 0)
+    g_source_remove (self->search_update_id);
+  self->search_update_id = 0;
+
+  if (self->search_timeout_id != 0)
+    g_source_remove (self->search_timeout_id);
+  self->search_timeout_id = g_timeout_add (SEARCH_DELAY, gn_manager_search_timeout_cb, self);
+
+  GN_EXIT;
+}
+
+/**
+ * gn_manager_search_finish:
+ * @self: A #GnManager
+ * @result: a #GAsyncResult provided to callback
+ * @error: a location for #GError or %NULL
+ *
+ * Completes an asynchronous request started with
+ * gn_manager_search_async().
+ *
+ * Returns: %TRUE if every result of the search was
+ * added to the search store. %FALSE otherwise
+ */
+gboolean
+gn_manager_search_finish (GnManager     *self,
+                          GAsyncResult  *result,
+                          GError       **error)
+{
+  g_return_val_if_fail (GN_IS_MANAGER (self), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * gn_manager_find_search_match:
+ * @self: A #GnManager
+ * @text: A UTF-8 string
+ * @length: The length of @text in bytes, or -1
+ * @start_position: The byte offset in @text to search from
+ * @match_start: (out) (optional): return location for the start
+ * @match_end: (out) (optional): return location for the end
+ *
+ * Find the first match of the current search in @text,
+ * say the title or content of an item in the search store,
+ * so that it can be highlighted.  See gn_search_query_find().
+ *
+ * Returns: %TRUE if found, with the byte offsets of the
+ * match set.  %FALSE otherwise, or if there's no search.
+ */
+gboolean
+gn_manager_find_search_match (GnManager   *self,
+                              const gchar *text,
+                              gssize       length,
+                              gint         start_position,
+                              gint        *match_start,
+                              gint        *match_end)
+{
+  g_return_val_if_fail (GN_IS_MANAGER (self), FALSE);
+  g_return_val_if_fail (text != NULL, FALSE);
+
+  if (self->search_query == NULL)
+    return FALSE;
+
+  return gn_search_query_find (self->search_query, text, length, start_position,
+                               match_start, match_end);
+}
+
+/**
+ * gn_manager_find_search_matches:
+ * @self: A #GnManager
+ * @text: A UTF-8 string
+ * @length: The length of @text in bytes, or -1
+ *
+ * Find every match of the current search in @text, say
+ * the content of a note in the editor, so that they can
+ * be highlighted.  See gn_search_query_find_all().
+ *
+ * Returns: (transfer full) (nullable): A #GArray of
+ * #GnSearchMatch, or %NULL if there's no search.
+ * Free with g_array_unref()
+ */
+GArray *
+gn_manager_find_search_matches (GnManager   *self,
+                                const gchar *text,
+                                gssize       length)
+{
+  g_return_val_if_fail (GN_IS_MANAGER (self), NULL);
+  g_return_val_if_fail (text != NULL, NULL);
+
+  if (self->search_query == NULL)
+    return NULL;
 
-  g_free (self->search_needle);
-  self->search_needle = g_strdup (terms[0]);
-  gtk_filter_list_model_refilter (self->search_store);
+  return gn_search_query_find_all (self->search_query, text, length);
 }
 
 /**
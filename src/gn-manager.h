@@ -51,8 +51,23 @@ void        gn_manager_queue_for_delete       (GnManager  *self,
                                                GList      *items);
 gboolean    gn_manager_dequeue_delete         (GnManager  *self);
 void        gn_manager_trash_queue_items      (GnManager  *self);
-void        gn_manager_search                 (GnManager  *self,
-                                               const gchar **terms);
+void        gn_manager_search_async           (GnManager           *self,
+                                               const gchar        **terms,
+                                               GCancellable        *cancellable,
+                                               GAsyncReadyCallback  callback,
+                                               gpointer             user_data);
+gboolean    gn_manager_search_finish          (GnManager           *self,
+                                               GAsyncResult        *result,
+                                               GError             **error);
+gboolean    gn_manager_find_search_match      (GnManager           *self,
+                                               const gchar         *text,
+                                               gssize               length,
+                                               gint                 start_position,
+                                               gint                *match_start,
+                                               gint                *match_end);
+GArray     *gn_manager_find_search_matches    (GnManager           *self,
+                                               const gchar         *text,
+                                               gssize               length);
 GList      *gn_manager_get_providers          (GnManager  *self);
 
 G_END_DECLS
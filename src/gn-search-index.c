@@ -0,0 +1,694 @@
+/* gn-search-index.c
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "gn-search-index"
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gn-search-index.h"
+#include "gn-utils.h"
+#include "gn-trace.h"
+
+/**
+ * SECTION: gn-search-index
+ * @title: GnSearchIndex
+ * @short_description: A trigram index of items
+ * @include: "gn-search-index.h"
+ *
+ * A #GnSearchIndex maps every run of three bytes (a trigram)
+ * in the text of the items to the list of items having it.
+ * The items that may contain a string are then the ones
+ * present in the lists of all trigrams of the string, which
+ * is usually a small subset of the items.  The index doesn't
+ * know anything about the text other than the bytes, so the
+ * caller should casefold the text and the needle, and verify
+ * the items found, as the trigrams may be in any order.
+ *
+ * gn_search_index_search() also verifies the items, and keeps
+ * the last few results, so that a search for a needle that
+ * extends a recent one (as when the user types in the needle)
+ * checks only the results of the earlier one, and a search
+ * for a recent needle (as on backspace) is not done again.
+ *
+ * The index is not thread safe.  But the #GnSearchDocument of
+ * an item never changes, and can be kept with
+ * gn_search_document_ref() to be read in any thread, even
+ * after the item is changed or removed from the index.
+ */
+
+/* Number of recent search results kept */
+#define MAX_CACHED_RESULTS 16
+
+typedef struct
+{
+  /* Must be the first member, see gn_search_index_get_document() */
+  GnSearchDocument  fields;
+
+  gint      ref_count;
+  GDestroyNotify item_free_func;
+
+  guint     id;
+  guint32  *trigrams;   /* Sorted, without duplicates */
+  guint     n_trigrams;
+} Document;
+
+typedef struct
+{
+  gchar      *needle;
+  GHashTable *items;
+} SearchResult;
+
+struct _GnSearchIndex
+{
+  /* item -> Document */
+  GHashTable *documents;
+  /* id -> Document */
+  GHashTable *ids;
+  /* trigram -> GArray of ids, sorted */
+  GHashTable *postings;
+  /* of SearchResult, the oldest first */
+  GPtrArray  *results;
+
+  GDestroyNotify item_free_func;
+
+  /* Ids only ever increase, so that new ids are appended to the lists */
+  guint next_id;
+};
+
+#define TRIGRAM(s) ((guint32)(guchar)(s)[0] << 16 |    \
+                    (guint32)(guchar)(s)[1] << 8 |     \
+                    (guint32)(guchar)(s)[2])
+
+static gint
+compare_trigram (gconstpointer a,
+                 gconstpointer b)
+{
+  guint32 trigram_a = *(const guint32 *)a;
+  guint32 trigram_b = *(const guint32 *)b;
+
+  return (trigram_a > trigram_b) - (trigram_a < trigram_b);
+}
+
+/*
+ * Get the unique trigrams in @text, in sorted order.
+ * Returns %NULL if @text is shorter than a trigram.
+ */
+static guint32 *
+gn_search_index_get_trigrams (const gchar *text,
+                              guint       *n_trigrams)
+{
+  guint32 *trigrams;
+  gsize length;
+  guint n = 0;
+
+  g_assert (text != NULL);
+  g_assert (n_trigrams != NULL);
+
+  length = strlen (text);
+  *n_trigrams = 0;
+
+  if (length < GN_SEARCH_INDEX_GRAM_SIZE)
+    return NULL;
+
+  trigrams = g_new (guint32, length - GN_SEARCH_INDEX_GRAM_SIZE + 1);
+
+  for (gsize i = 0; i + GN_SEARCH_INDEX_GRAM_SIZE <= length; i++)
+    trigrams[i] = TRIGRAM (text + i);
+
+  length = length - GN_SEARCH_INDEX_GRAM_SIZE + 1;
+  qsort (trigrams, length, sizeof (guint32), compare_trigram);
+
+  for (gsize i = 0; i < length; i++)
+    if (n == 0 || trigrams[n - 1] != trigrams[i])
+      trigrams[n++] = trigrams[i];
+
+  *n_trigrams = n;
+
+  return trigrams;
+}
+
+/* Find the index of @id in the sorted @ids, or where it should be inserted */
+static guint
+find_id (GArray   *ids,
+         guint     id,
+         gboolean *found)
+{
+  guint low = 0, high = ids->len;
+
+  while (low < high)
+    {
+      guint mid = low + (high - low) / 2;
+      guint value = g_array_index (ids, guint, mid);
+
+      if (value == id)
+        {
+          *found = TRUE;
+          return mid;
+        }
+
+      if (value < id)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+  *found = FALSE;
+  return low;
+}
+
+static void
+search_result_free (gpointer data)
+{
+  SearchResult *result = data;
+
+  g_free (result->needle);
+  g_hash_table_unref (result->items);
+  g_slice_free (SearchResult, result);
+}
+
+/* Remove @document from the lists of its trigrams */
+static void
+document_unindex (GnSearchIndex *self,
+                  Document      *document)
+{
+  for (guint i = 0; i < document->n_trigrams; i++)
+    {
+      gpointer key = GUINT_TO_POINTER (document->trigrams[i]);
+      GArray *ids;
+      gboolean found;
+      guint index;
+
+      ids = g_hash_table_lookup (self->postings, key);
+      g_assert (ids != NULL);
+
+      index = find_id (ids, document->id, &found);
+      g_assert (found);
+      g_array_remove_index (ids, index);
+
+      if (ids->len == 0)
+        g_hash_table_remove (self->postings, key);
+    }
+
+  g_clear_pointer (&document->trigrams, g_free);
+  document->n_trigrams = 0;
+}
+
+/**
+ * gn_search_document_ref:
+ * @self: A #GnSearchDocument
+ *
+ * Increase the reference count of @self.  This can be
+ * done in any thread.
+ *
+ * Returns: (transfer full): @self
+ */
+GnSearchDocument *
+gn_search_document_ref (GnSearchDocument *self)
+{
+  Document *document = (Document *)self;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (document->ref_count > 0, NULL);
+
+  g_atomic_int_inc (&document->ref_count);
+
+  return self;
+}
+
+/**
+ * gn_search_document_unref:
+ * @self: A #GnSearchDocument
+ *
+ * Decrease the reference count of @self.  The item of
+ * @self is freed with the @item_free_func of the index
+ * when the count drops to zero, so the last reference
+ * should be dropped in the thread the index is used.
+ */
+void
+gn_search_document_unref (GnSearchDocument *self)
+{
+  Document *document = (Document *)self;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (document->ref_count > 0);
+
+  if (!g_atomic_int_dec_and_test (&document->ref_count))
+    return;
+
+  if (document->item_free_func != NULL)
+    document->item_free_func (document->fields.item);
+
+  g_free ((gchar *)document->fields.text);
+  g_free ((gchar *)document->fields.tags);
+  g_free (document->trigrams);
+  g_slice_free (Document, document);
+}
+
+/**
+ * gn_search_index_new:
+ * @item_free_func: (nullable): A function to free items
+ *
+ * Create a new empty search index.  @item_free_func
+ * is called on an item when it's removed from the index.
+ *
+ * Returns: (transfer full): A #GnSearchIndex.
+ * Free with gn_search_index_free()
+ */
+GnSearchIndex *
+gn_search_index_new (GDestroyNotify item_free_func)
+{
+  GnSearchIndex *self;
+
+  self = g_new0 (GnSearchIndex, 1);
+  self->documents = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->ids = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->postings = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                          NULL, (GDestroyNotify)g_array_unref);
+  self->results = g_ptr_array_new_with_free_func (search_result_free);
+  self->item_free_func = item_free_func;
+  self->next_id = 1;
+
+  return self;
+}
+
+void
+gn_search_index_free (GnSearchIndex *self)
+{
+  GHashTableIter iter;
+  gpointer document;
+
+  if (self == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, self->documents);
+  while (g_hash_table_iter_next (&iter, NULL, &document))
+    gn_search_document_unref (document);
+
+  g_hash_table_unref (self->documents);
+  g_hash_table_unref (self->ids);
+  g_hash_table_unref (self->postings);
+  g_ptr_array_unref (self->results);
+  g_free (self);
+}
+
+/**
+ * gn_search_index_add:
+ * @self: A #GnSearchIndex
+ * @item: The item to index
+ * @text: The text of @item
+ *
+ * Index @item with @text.  If @item is already in
+ * @self, the old text is replaced with @text.
+ */
+void
+gn_search_index_add (GnSearchIndex *self,
+                     gpointer       item,
+                     const gchar   *text)
+{
+  gn_search_index_add_full (self, item, text, NULL, 0);
+}
+
+/**
+ * gn_search_index_add_full:
+ * @self: A #GnSearchIndex
+ * @item: The item to index
+ * @text: The text of @item
+ * @tags: (nullable): The tags of @item
+ * @modification_time: The modification time of @item
+ *
+ * Index @item with @text, like gn_search_index_add(),
+ * and keep @tags and @modification_time with the text,
+ * which can be retrieved with gn_search_index_get_document().
+ *
+ * @text is expected to be the title, a newline, and the
+ * content.  @tags should have each tag name followed by
+ * a newline, and start with a newline.
+ */
+void
+gn_search_index_add_full (GnSearchIndex *self,
+                          gpointer       item,
+                          const gchar   *text,
+                          const gchar   *tags,
+                          gint64         modification_time)
+{
+  Document *document;
+  const gchar *title_end;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (item != NULL);
+  g_return_if_fail (text != NULL);
+
+  /* The text of @item may no longer match the results */
+  g_ptr_array_set_size (self->results, 0);
+  document = g_hash_table_lookup (self->documents, item);
+
+  if (document != NULL)
+    {
+      g_hash_table_remove (self->documents, item);
+      g_hash_table_remove (self->ids, GUINT_TO_POINTER (document->id));
+      document_unindex (self, document);
+      gn_search_document_unref ((GnSearchDocument *)document);
+    }
+
+  title_end = strchr (text, '\n');
+
+  document = g_slice_new (Document);
+  document->fields.text = g_strdup (text);
+  document->fields.title_length = title_end ? (gsize)(title_end - text) : strlen (text);
+  document->fields.tags = g_strdup (tags ? tags : "\n");
+  document->fields.modification_time = modification_time;
+  document->fields.item = item;
+  document->ref_count = 1;
+  document->item_free_func = self->item_free_func;
+  document->id = self->next_id++;
+  document->trigrams = gn_search_index_get_trigrams (text, &document->n_trigrams);
+
+  for (guint i = 0; i < document->n_trigrams; i++)
+    {
+      gpointer key = GUINT_TO_POINTER (document->trigrams[i]);
+      GArray *ids;
+
+      ids = g_hash_table_lookup (self->postings, key);
+
+      if (ids == NULL)
+        {
+          ids = g_array_sized_new (FALSE, FALSE, sizeof (guint), 4);
+          g_hash_table_insert (self->postings, key, ids);
+        }
+
+      /* The id is larger than every other, so the list stays sorted */
+      g_array_append_val (ids, document->id);
+    }
+
+  g_hash_table_insert (self->documents, item, document);
+  g_hash_table_insert (self->ids, GUINT_TO_POINTER (document->id), document);
+}
+
+/**
+ * gn_search_index_remove:
+ * @self: A #GnSearchIndex
+ * @item: The item to remove
+ *
+ * Remove @item from @self.
+ *
+ * Returns: %TRUE if @item was in @self.
+ * %FALSE otherwise.
+ */
+gboolean
+gn_search_index_remove (GnSearchIndex *self,
+                        gpointer       item)
+{
+  Document *document;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  document = g_hash_table_lookup (self->documents, item);
+
+  if (document == NULL)
+    return FALSE;
+
+  g_ptr_array_set_size (self->results, 0);
+  g_hash_table_remove (self->documents, item);
+  g_hash_table_remove (self->ids, GUINT_TO_POINTER (document->id));
+  document_unindex (self, document);
+  gn_search_document_unref ((GnSearchDocument *)document);
+
+  return TRUE;
+}
+
+gboolean
+gn_search_index_contains (GnSearchIndex *self,
+                          gpointer       item)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  return g_hash_table_contains (self->documents, item);
+}
+
+/**
+ * gn_search_index_get_document:
+ * @self: A #GnSearchIndex
+ * @item: An item in @self
+ *
+ * Get the indexed fields of @item.
+ *
+ * Returns: (transfer none) (nullable): The #GnSearchDocument
+ * of @item, or %NULL if @item is not in @self.
+ */
+const GnSearchDocument *
+gn_search_index_get_document (GnSearchIndex *self,
+                              gpointer       item)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  return g_hash_table_lookup (self->documents, item);
+}
+
+guint
+gn_search_index_get_n_items (GnSearchIndex *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return g_hash_table_size (self->documents);
+}
+
+static gint
+compare_posting_length (gconstpointer a,
+                        gconstpointer b)
+{
+  GArray *ids_a = *(GArray **)a;
+  GArray *ids_b = *(GArray **)b;
+
+  return (ids_a->len > ids_b->len) - (ids_a->len < ids_b->len);
+}
+
+/**
+ * gn_search_index_lookup:
+ * @self: A #GnSearchIndex
+ * @needle: The string to search
+ *
+ * Find the items that may contain @needle, which is
+ * every item having all the trigrams in @needle.  Some
+ * of the items may not contain @needle, so they should
+ * be verified by the caller.
+ *
+ * If @needle is shorter than a trigram, every item may
+ * contain it, and %NULL is returned.
+ *
+ * Returns: (transfer full) (nullable): A #GHashTable
+ * with the items as keys.  Free with g_hash_table_unref()
+ */
+GHashTable *
+gn_search_index_lookup (GnSearchIndex *self,
+                        const gchar   *needle)
+{
+  g_autofree guint32 *trigrams = NULL;
+  g_autoptr(GPtrArray) postings = NULL;
+  g_autoptr(GArray) candidates = NULL;
+  GHashTable *items;
+  guint n_trigrams;
+
+  GN_ENTRY;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (needle != NULL, NULL);
+
+  trigrams = gn_search_index_get_trigrams (needle, &n_trigrams);
+
+  if (trigrams == NULL)
+    GN_RETURN (NULL);
+
+  items = g_hash_table_new (g_direct_hash, g_direct_equal);
+  postings = g_ptr_array_sized_new (n_trigrams);
+
+  for (guint i = 0; i < n_trigrams; i++)
+    {
+      GArray *ids;
+
+      ids = g_hash_table_lookup (self->postings, GUINT_TO_POINTER (trigrams[i]));
+
+      /* No item has this trigram, so none can have @needle */
+      if (ids == NULL)
+        GN_RETURN (items);
+
+      g_ptr_array_add (postings, ids);
+    }
+
+  /* Start from the shortest list, so that there are less ids to check */
+  g_ptr_array_sort (postings, compare_posting_length);
+  candidates = g_array_sized_new (FALSE, FALSE, sizeof (guint),
+                                  ((GArray *)postings->pdata[0])->len);
+  g_array_append_vals (candidates, ((GArray *)postings->pdata[0])->data,
+                       ((GArray *)postings->pdata[0])->len);
+
+  for (guint i = 1; i < postings->len && candidates->len > 0; i++)
+    {
+      GArray *ids = postings->pdata[i];
+      guint n = 0;
+
+      for (guint j = 0; j < candidates->len; j++)
+        {
+          guint id = g_array_index (candidates, guint, j);
+          gboolean found;
+
+          find_id (ids, id, &found);
+
+          if (found)
+            g_array_index (candidates, guint, n++) = id;
+        }
+
+      g_array_set_size (candidates, n);
+    }
+
+  for (guint i = 0; i < candidates->len; i++)
+    {
+      Document *document;
+
+      document = g_hash_table_lookup (self->ids,
+                                      GUINT_TO_POINTER (g_array_index (candidates, guint, i)));
+      g_assert (document != NULL);
+      g_hash_table_add (items, document->fields.item);
+    }
+
+  GN_RETURN (items);
+}
+
+/*
+ * Find the smallest recent result for a needle which is a part of
+ * @needle.  As every item having @needle also has that needle,
+ * only the items in the result need be searched.
+ */
+static SearchResult *
+gn_search_index_find_result (GnSearchIndex *self,
+                             const gchar   *needle)
+{
+  SearchResult *best = NULL;
+
+  g_assert (self != NULL);
+  g_assert (needle != NULL);
+
+  for (guint i = 0; i < self->results->len; i++)
+    {
+      SearchResult *result = self->results->pdata[i];
+
+      if (g_str_equal (result->needle, needle))
+        return result;
+
+      /* Looking up in the index is likely faster than a short needle result */
+      if (strlen (result->needle) < GN_SEARCH_INDEX_GRAM_SIZE &&
+          strlen (needle) >= GN_SEARCH_INDEX_GRAM_SIZE)
+        continue;
+
+      if (strstr (needle, result->needle) != NULL &&
+          (best == NULL ||
+           g_hash_table_size (result->items) < g_hash_table_size (best->items)))
+        best = result;
+    }
+
+  return best;
+}
+
+/**
+ * gn_search_index_search:
+ * @self: A #GnSearchIndex
+ * @needle: The string to search
+ * @match_func: (nullable): A function to check if an item has @needle
+ * @user_data: user data for @match_func
+ *
+ * Find the items that contain @needle.  The items are
+ * first looked up in the index, or in a recent result
+ * if @needle contains an earlier needle, and then each
+ * item found is verified with @match_func.  If
+ * @match_func is %NULL, the text of the item is checked.
+ *
+ * The results are cached till an item is added or
+ * removed, so @match_func should be the same function
+ * every time.
+ *
+ * Returns: (transfer full): A #GHashTable with the
+ * items as keys.  Free with g_hash_table_unref()
+ */
+GHashTable *
+gn_search_index_search (GnSearchIndex     *self,
+                        const gchar       *needle,
+                        GnSearchMatchFunc  match_func,
+                        gpointer           user_data)
+{
+  g_autoptr(GHashTable) candidates = NULL;
+  SearchResult *result;
+  GHashTableIter iter;
+  gpointer item;
+  gsize needle_length;
+
+  GN_ENTRY;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (needle != NULL, NULL);
+
+  needle_length = strlen (needle);
+  result = gn_search_index_find_result (self, needle);
+
+  /* The same needle was searched recently */
+  if (result != NULL && g_str_equal (result->needle, needle))
+    GN_RETURN (g_hash_table_ref (result->items));
+
+  if (result != NULL)
+    candidates = g_hash_table_ref (result->items);
+  else
+    candidates = gn_search_index_lookup (self, needle);
+
+  /* Either the needle is too short to look up, or it's the first search */
+  if (candidates == NULL)
+    candidates = g_hash_table_ref (self->documents);
+
+  result = g_slice_new (SearchResult);
+  result->needle = g_strdup (needle);
+  result->items = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  g_hash_table_iter_init (&iter, candidates);
+  while (g_hash_table_iter_next (&iter, &item, NULL))
+    {
+      gboolean match;
+
+      if (match_func != NULL)
+        {
+          match = match_func (item, needle, user_data);
+        }
+      else
+        {
+          Document *document = g_hash_table_lookup (self->documents, item);
+
+          match = gn_utils_str_find (document->fields.text, strlen (document->fields.text),
+                                     needle, needle_length) != NULL;
+        }
+
+      if (match)
+        g_hash_table_add (result->items, item);
+    }
+
+  if (self->results->len == MAX_CACHED_RESULTS)
+    g_ptr_array_remove_index (self->results, 0);
+  g_ptr_array_add (self->results, result);
+
+  GN_RETURN (g_hash_table_ref (result->items));
+}
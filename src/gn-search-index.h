@@ -0,0 +1,74 @@
+/* gn-search-index.h
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Length in bytes of the substrings indexed */
+#define GN_SEARCH_INDEX_GRAM_SIZE 3
+
+typedef struct _GnSearchIndex GnSearchIndex;
+
+/* The fields of an item, as saved in #GnSearchIndex */
+typedef struct
+{
+  gpointer     item;
+  const gchar *text;          /* Title, a newline, and content */
+  gsize        title_length;  /* Length of the title in @text */
+  const gchar *tags;          /* "\n" and each tag followed by "\n" */
+  gint64       modification_time;
+} GnSearchDocument;
+
+typedef gboolean (*GnSearchMatchFunc) (gpointer     item,
+                                       const gchar *needle,
+                                       gpointer     user_data);
+
+GnSearchDocument *gn_search_document_ref   (GnSearchDocument *self);
+void              gn_search_document_unref (GnSearchDocument *self);
+
+GnSearchIndex *gn_search_index_new          (GDestroyNotify  item_free_func);
+void           gn_search_index_free         (GnSearchIndex  *self);
+
+void           gn_search_index_add          (GnSearchIndex  *self,
+                                             gpointer        item,
+                                             const gchar    *text);
+void           gn_search_index_add_full     (GnSearchIndex  *self,
+                                             gpointer        item,
+                                             const gchar    *text,
+                                             const gchar    *tags,
+                                             gint64          modification_time);
+gboolean       gn_search_index_remove       (GnSearchIndex  *self,
+                                             gpointer        item);
+gboolean       gn_search_index_contains     (GnSearchIndex  *self,
+                                             gpointer        item);
+const GnSearchDocument *gn_search_index_get_document (GnSearchIndex *self,
+                                                      gpointer       item);
+guint          gn_search_index_get_n_items  (GnSearchIndex  *self);
+GHashTable    *gn_search_index_lookup       (GnSearchIndex  *self,
+                                             const gchar    *needle);
+GHashTable    *gn_search_index_search       (GnSearchIndex     *self,
+                                             const gchar       *needle,
+                                             GnSearchMatchFunc  match_func,
+                                             gpointer           user_data);
+
+G_END_DECLS
@@ -0,0 +1,1282 @@
+/* gn-search-query.c
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "gn-search-query"
+
+#include "config.h"
+
+#include <string.h>
+
+#include "gn-search-query.h"
+#include "gn-utils.h"
+#include "gn-trace.h"
+
+/**
+ * SECTION: gn-search-query
+ * @title: GnSearchQuery
+ * @short_description: A compiled search query
+ * @include: "gn-search-query.h"
+ *
+ * A #GnSearchQuery is a search string parsed into a list
+ * of terms, all of which should match for an item to match:
+ *
+ * - A word, or a "quoted phrase", that should be in the
+ *   title or content.
+ * - `re:pattern`, a Perl compatible regular expression
+ *   that should match the title or the content, ignoring case.
+ *   Invalid patterns are searched as text.
+ * - `tag:name`, the item should have the tag `name`.
+ * - `after:YYYY-MM-DD` and `before:YYYY-MM-DD`, the item
+ *   should be modified on or after, or before the given day.
+ * - Any word, phrase or tag prefixed with `-`, which should
+ *   not match.
+ *
+ * Everything is casefolded when the query is created, so that
+ * matching an item is a few substring searches in the fields
+ * saved in #GnSearchIndex, without any allocation.
+ *
+ * The matched items are ranked by the number of terms in the
+ * title, the number of times each term is found, and how
+ * recently the item was modified.
+ *
+ * Words and phrases can also be matched with typos, if a
+ * maximum edit distance is set with
+ * gn_search_query_set_max_distance().  Items are then ranked
+ * by the edit distance first.
+ */
+
+/* Occurrences of a term counted in the content, at most */
+#define MAX_TERM_FREQUENCY 10
+#define TITLE_SCORE        10.0
+#define RECENCY_SCORE      5.0
+/* The recency score halves in this many seconds */
+#define RECENCY_HALF_LIFE  (30 * 24 * 60 * 60)
+
+/* Edits allowed for a term with typos, at most */
+#define MAX_DISTANCE       3
+/* A term should have this many bytes for each edit allowed, and one more */
+#define BYTES_PER_EDIT     3
+/* Larger than any other score a term can get, so that fewer edits rank first */
+#define DISTANCE_PENALTY   (TITLE_SCORE + MAX_TERM_FREQUENCY + RECENCY_SCORE)
+
+/* Documents matched in a thread, at least */
+#define MIN_CHUNK_SIZE         4096
+/* Documents matched between checks for cancellation */
+#define CANCEL_CHECK_INTERVAL  256
+
+typedef enum
+{
+  TERM_TEXT,
+  TERM_REGEX,
+  TERM_TAG,
+} TermType;
+
+typedef struct
+{
+  TermType  type;
+  gboolean  excluded;
+  /* Casefolded.  For tags, enclosed in "\n" as in GnSearchDocument */
+  gchar    *text;
+  /* For regex terms, the compiled pattern */
+  GRegex   *regex;
+  /* Edits allowed in a match, and the bit mask of each byte in text */
+  guint     max_distance;
+  guint64  *masks;
+  /* text split into max_distance + 1 parts */
+  gchar   **parts;
+} Term;
+
+struct _GnSearchQuery
+{
+  GArray *terms;    /* of Term */
+  /* Modification time range, [start, end) */
+  gint64  start_time;
+  gint64  end_time;
+};
+
+static void
+term_clear (gpointer data)
+{
+  Term *term = data;
+
+  g_free (term->text);
+  g_clear_pointer (&term->regex, g_regex_unref);
+  g_free (term->masks);
+  g_strfreev (term->parts);
+}
+
+/* Get the number from the @n_digits ASCII digits at @str */
+static gboolean
+parse_digits (const gchar *str,
+              guint        n_digits,
+              gint        *number)
+{
+  g_assert (str != NULL);
+  g_assert (number != NULL);
+
+  *number = 0;
+
+  for (guint i = 0; i < n_digits; i++)
+    {
+      if (!g_ascii_isdigit (str[i]))
+        return FALSE;
+
+      *number = *number * 10 + g_ascii_digit_value (str[i]);
+    }
+
+  return TRUE;
+}
+
+/* Get the unix time at the start of @date, a "YYYY-MM-DD" day */
+static gboolean
+parse_date (const gchar *date,
+            gint64      *unix_time)
+{
+  g_autoptr(GDateTime) date_time = NULL;
+  gint year, month, day;
+
+  g_assert (date != NULL);
+  g_assert (unix_time != NULL);
+
+  if (strlen (date) != strlen ("YYYY-MM-DD") ||
+      date[4] != '-' || date[7] != '-' ||
+      !parse_digits (date, 4, &year) ||
+      !parse_digits (date + 5, 2, &month) ||
+      !parse_digits (date + 8, 2, &day) ||
+      !g_date_valid_dmy (day, month, year))
+    return FALSE;
+
+  date_time = g_date_time_new_local (year, month, day, 0, 0, 0);
+
+  if (date_time == NULL)
+    return FALSE;
+
+  *unix_time = g_date_time_to_unix (date_time);
+
+  return TRUE;
+}
+
+static void
+gn_search_query_add_term (GnSearchQuery *self,
+                          const gchar   *word,
+                          gsize          length,
+                          gboolean       quoted,
+                          gboolean       excluded)
+{
+  g_autofree gchar *text = NULL;
+  Term term = { TERM_TEXT, excluded, NULL, NULL, 0, NULL, NULL };
+  gint64 unix_time;
+
+  g_assert (self != NULL);
+  g_assert (word != NULL);
+
+  text = g_strndup (word, length);
+
+  if (!quoted)
+    {
+      if (text[0] == '-' && text[1] != '\0')
+        {
+          term.excluded = TRUE;
+          memmove (text, text + 1, strlen (text));
+        }
+
+      if (!term.excluded && g_str_has_prefix (text, "after:") &&
+          parse_date (text + strlen ("after:"), &unix_time))
+        {
+          self->start_time = MAX (self->start_time, unix_time);
+          return;
+        }
+
+      if (!term.excluded && g_str_has_prefix (text, "before:") &&
+          parse_date (text + strlen ("before:"), &unix_time))
+        {
+          self->end_time = MIN (self->end_time, unix_time);
+          return;
+        }
+
+      if (g_str_has_prefix (text, "re:") && text[strlen ("re:")] != '\0')
+        {
+          /* GRegex can be matched in many threads at once */
+          term.regex = g_regex_new (text + strlen ("re:"),
+                                    G_REGEX_CASELESS | G_REGEX_OPTIMIZE,
+                                    0, NULL);
+
+          if (term.regex != NULL)
+            {
+              term.type = TERM_REGEX;
+              term.text = g_strdup (text + strlen ("re:"));
+              g_array_append_val (self->terms, term);
+              return;
+            }
+        }
+
+      if (g_str_has_prefix (text, "tag:") && text[strlen ("tag:")] != '\0')
+        {
+          g_autofree gchar *tag = NULL;
+
+          tag = g_utf8_casefold (text + strlen ("tag:"), -1);
+          term.type = TERM_TAG;
+          term.text = g_strconcat ("\n", tag, "\n", NULL);
+          g_array_append_val (self->terms, term);
+          return;
+        }
+    }
+
+  if (text[0] == '\0')
+    return;
+
+  term.text = g_utf8_casefold (text, -1);
+  g_array_append_val (self->terms, term);
+}
+
+/**
+ * gn_search_query_new:
+ * @query: The search string
+ *
+ * Parse @query into a #GnSearchQuery.  Any part of
+ * @query that isn't understood is searched as text.
+ *
+ * Returns: (transfer full): A #GnSearchQuery.
+ * Free with gn_search_query_free()
+ */
+GnSearchQuery *
+gn_search_query_new (const gchar *query)
+{
+  GnSearchQuery *self;
+  const gchar *p;
+
+  GN_ENTRY;
+
+  g_return_val_if_fail (query != NULL, NULL);
+
+  self = g_new0 (GnSearchQuery, 1);
+  self->terms = g_array_new (FALSE, FALSE, sizeof (Term));
+  g_array_set_clear_func (self->terms, term_clear);
+  self->start_time = G_MININT64;
+  self->end_time = G_MAXINT64;
+
+  p = query;
+
+  while (*p != '\0')
+    {
+      const gchar *start, *end;
+      gboolean excluded = FALSE;
+
+      while (g_ascii_isspace (*p))
+        p++;
+
+      if (*p == '\0')
+        break;
+
+      if ((p[0] == '-' && p[1] == '"') || p[0] == '"')
+        {
+          excluded = p[0] == '-';
+          start = p + (excluded ? 2 : 1);
+          end = strchr (start, '"');
+
+          /* An unterminated phrase runs till the end */
+          if (end == NULL)
+            end = start + strlen (start);
+
+          gn_search_query_add_term (self, start, end - start, TRUE, excluded);
+
+          p = *end == '"' ? end + 1 : end;
+          continue;
+        }
+
+      start = p;
+      while (*p != '\0' && !g_ascii_isspace (*p))
+        p++;
+
+      gn_search_query_add_term (self, start, p - start, FALSE, FALSE);
+    }
+
+  GN_RETURN (self);
+}
+
+void
+gn_search_query_free (GnSearchQuery *self)
+{
+  if (self == NULL)
+    return;
+
+  g_array_unref (self->terms);
+  g_free (self);
+}
+
+/**
+ * gn_search_query_set_max_distance:
+ * @self: A #GnSearchQuery
+ * @max_distance: The edits allowed in a term
+ *
+ * Let the words and phrases of @self match with typos,
+ * that is, with at most @max_distance bytes inserted,
+ * deleted or replaced.  Fewer edits are allowed in short
+ * terms, so that they don't match nearly everything, and
+ * no more than 3 in any term.  Excluded terms should
+ * always match exactly.
+ *
+ * Set 0 to match exactly, which is the default.
+ */
+void
+gn_search_query_set_max_distance (GnSearchQuery *self,
+                                  guint          max_distance)
+{
+  g_return_if_fail (self != NULL);
+
+  max_distance = MIN (max_distance, MAX_DISTANCE);
+
+  for (guint i = 0; i < self->terms->len; i++)
+    {
+      Term *term = &g_array_index (self->terms, Term, i);
+      gsize length;
+
+      if (term->type != TERM_TEXT || term->excluded)
+        continue;
+
+      length = strlen (term->text);
+      g_clear_pointer (&term->masks, g_free);
+      g_clear_pointer (&term->parts, g_strfreev);
+      term->max_distance = 0;
+
+      /* The state of the matcher should fit in 64 bits */
+      if (length > 64)
+        continue;
+
+      term->max_distance = MIN (max_distance, (length - 1) / BYTES_PER_EDIT);
+
+      if (term->max_distance == 0)
+        continue;
+
+      term->masks = g_new0 (guint64, 256);
+
+      for (gsize j = 0; j < length; j++)
+        term->masks[(guchar)term->text[j]] |= (guint64)1 << j;
+
+      term->parts = g_new0 (gchar *, term->max_distance + 2);
+
+      for (guint j = 0; j <= term->max_distance; j++)
+        {
+          gsize start = j * length / (term->max_distance + 1);
+          gsize end = (j + 1) * length / (term->max_distance + 1);
+
+          term->parts[j] = g_strndup (term->text + start, end - start);
+        }
+    }
+}
+
+/*
+ * If @term is in @text with at most term->max_distance edits,
+ * one of the max_distance + 1 parts of @term is left without
+ * any edit.  So the text can be skipped if it has none of them.
+ */
+static gboolean
+fuzzy_may_match (const Term  *term,
+                 const gchar *text,
+                 gsize        length)
+{
+  for (guint i = 0; term->parts[i] != NULL; i++)
+    if (gn_utils_str_find (text, length, term->parts[i], strlen (term->parts[i])) != NULL)
+      return TRUE;
+
+  return FALSE;
+}
+
+/*
+ * A text casefolded as the text in #GnSearchIndex, with the
+ * offset in the original text of the character each byte is
+ * folded from, so that the matches found in it can be mapped
+ * back to the original text.
+ */
+typedef struct
+{
+  GString *text;
+  GArray  *offsets;     /* of gint, for each byte of text, and the end */
+} FoldedText;
+
+static void
+folded_text_init (FoldedText  *folded,
+                  const gchar *text,
+                  gsize        length)
+{
+  const gchar *end = text + length;
+  gint offset;
+
+  folded->text = g_string_sized_new (length);
+  folded->offsets = g_array_sized_new (FALSE, FALSE, sizeof (gint), length + 1);
+
+  /* Casefolding is done for each character, as g_utf8_casefold() does */
+  for (const gchar *p = text; p < end;)
+    {
+      const gchar *next = MIN (g_utf8_next_char (p), end);
+      gsize folded_length = folded->text->len;
+
+      if ((guchar)*p < 0x80)
+        {
+          g_string_append_c (folded->text, g_ascii_tolower (*p));
+        }
+      else
+        {
+          g_autofree gchar *casefold = NULL;
+
+          casefold = g_utf8_casefold (p, next - p);
+          g_string_append (folded->text, casefold);
+        }
+
+      offset = p - text;
+      for (gsize i = folded_length; i < folded->text->len; i++)
+        g_array_append_val (folded->offsets, offset);
+
+      p = next;
+    }
+
+  offset = length;
+  g_array_append_val (folded->offsets, offset);
+}
+
+static void
+folded_text_clear (FoldedText *folded)
+{
+  g_string_free (folded->text, TRUE);
+  g_array_unref (folded->offsets);
+}
+
+/* Get the offset in the folded text of @offset in the original text */
+static gsize
+folded_text_get_position (const FoldedText *folded,
+                          gint              offset)
+{
+  gsize position = 0;
+
+  while (position < folded->text->len &&
+         g_array_index (folded->offsets, gint, position) < offset)
+    position++;
+
+  return position;
+}
+
+/*
+ * Map the match at [@start, @end) of the folded text to the
+ * original text.  A match that starts or ends inside what a
+ * character is folded to, say "s" in "ss" of "ß", includes the
+ * whole character.
+ */
+static void
+folded_text_map_match (const FoldedText *folded,
+                       gsize             start,
+                       gsize             end,
+                       gint             *match_start,
+                       gint             *match_end)
+{
+  const gint *offsets = (const gint *)folded->offsets->data;
+
+  *match_start = offsets[start];
+
+  if (end > start)
+    while (end < folded->text->len && offsets[end] == offsets[end - 1])
+      end++;
+
+  *match_end = offsets[end];
+}
+
+/*
+ * Find the first match of @regex from @position in the bytes of
+ * @text from @field_start to @field_end, as if nothing else was
+ * around them.
+ */
+static gboolean
+regex_find (GRegex      *regex,
+            const gchar *text,
+            gsize        field_start,
+            gsize        field_end,
+            gsize        position,
+            gsize       *match_start,
+            gsize       *match_end)
+{
+  g_autoptr(GMatchInfo) match_info = NULL;
+  gint start, end;
+
+  if (!g_regex_match_full (regex, text + field_start, field_end - field_start,
+                           position - field_start, 0, &match_info, NULL))
+    return FALSE;
+
+  g_match_info_fetch_pos (match_info, 0, &start, &end);
+  *match_start = field_start + start;
+  *match_end = field_start + end;
+
+  return TRUE;
+}
+
+/*
+ * Find the first match of the terms of @self in the folded text from
+ * @position, as the terms are matched in gn_search_query_match().
+ * The first line is the title, which a match never crosses.
+ */
+static gboolean
+gn_search_query_find_folded (GnSearchQuery    *self,
+                             const FoldedText *folded,
+                             gsize             position,
+                             gsize            *match_start,
+                             gsize            *match_end)
+{
+  const gchar *text = folded->text->str;
+  const gchar *title_end;
+  gsize length = folded->text->len;
+  gsize title_length, content_start;
+  gsize best_start = 0, best_end = 0;
+  gboolean found = FALSE;
+
+  title_end = memchr (text, '\n', length);
+  title_length = title_end ? (gsize)(title_end - text) : length;
+  content_start = title_end ? title_length + 1 : length;
+
+  for (guint i = 0; i < self->terms->len; i++)
+    {
+      Term *term = &g_array_index (self->terms, Term, i);
+      gsize start, end;
+
+      if (term->excluded || term->type == TERM_TAG)
+        continue;
+
+      if (term->type == TERM_REGEX)
+        {
+          gboolean matched = FALSE;
+
+          /* The title and the content are matched separately */
+          if (position < title_length)
+            matched = regex_find (term->regex, text, 0, title_length,
+                                  position, &start, &end);
+
+          if (!matched && title_end != NULL)
+            matched = regex_find (term->regex, text, content_start, length,
+                                  MAX (position, content_start), &start, &end);
+
+          if (!matched)
+            continue;
+        }
+      else
+        {
+          gsize needle_length = strlen (term->text);
+          const gchar *match;
+
+          match = gn_utils_str_find (text + position, length - position,
+                                     term->text, needle_length);
+          if (match == NULL)
+            continue;
+
+          start = match - text;
+          end = start + needle_length;
+        }
+
+      if (!found || start < best_start ||
+          (start == best_start && end > best_end))
+        {
+          best_start = start;
+          best_end = end;
+          found = TRUE;
+        }
+    }
+
+  *match_start = best_start;
+  *match_end = best_end;
+
+  return found;
+}
+
+/**
+ * gn_search_query_find:
+ * @self: A #GnSearchQuery
+ * @text: A UTF-8 string, not casefolded
+ * @length: The length of @text in bytes, or -1
+ * @start_position: The byte offset in @text to search from
+ * @match_start: (out) (optional): return location for the start
+ * @match_end: (out) (optional): return location for the end
+ *
+ * Find the first match of a word, phrase or regular
+ * expression of @self in @text, ignoring case, to be
+ * highlighted.  If more than one term match at the same
+ * offset, the longest match is found.  Terms that only
+ * match with typos are not found.
+ *
+ * @text is casefolded and matched as in gn_search_query_match(),
+ * so that anything that matches can be highlighted, even if
+ * casefolding changes its length, like “ß” matching “ss”.
+ *
+ * This can be called in any thread.
+ *
+ * Returns: %TRUE if found, with the byte offsets of
+ * the match set.  %FALSE otherwise
+ */
+gboolean
+gn_search_query_find (GnSearchQuery *self,
+                      const gchar   *text,
+                      gssize         length,
+                      gint           start_position,
+                      gint          *match_start,
+                      gint          *match_end)
+{
+  FoldedText folded;
+  gsize start, end;
+  gint start_offset, end_offset;
+  gboolean found;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (text != NULL, FALSE);
+  g_return_val_if_fail (start_position >= 0, FALSE);
+
+  if (length < 0)
+    length = strlen (text);
+
+  folded_text_init (&folded, text, length);
+  found = gn_search_query_find_folded (self, &folded,
+                                       folded_text_get_position (&folded, start_position),
+                                       &start, &end);
+
+  if (found)
+    {
+      folded_text_map_match (&folded, start, end, &start_offset, &end_offset);
+
+      if (match_start != NULL)
+        *match_start = start_offset;
+      if (match_end != NULL)
+        *match_end = end_offset;
+    }
+
+  folded_text_clear (&folded);
+
+  return found;
+}
+
+/**
+ * gn_search_query_find_all:
+ * @self: A #GnSearchQuery
+ * @text: A UTF-8 string, not casefolded
+ * @length: The length of @text in bytes, or -1
+ *
+ * Find every match of @self in @text, as gn_search_query_find()
+ * does, casefolding @text only once.  Overlapping matches are
+ * merged, and empty matches are skipped.
+ *
+ * This can be called in any thread.
+ *
+ * Returns: (transfer full): A #GArray of #GnSearchMatch, in
+ * the order found.  Free with g_array_unref()
+ */
+GArray *
+gn_search_query_find_all (GnSearchQuery *self,
+                          const gchar   *text,
+                          gssize         length)
+{
+  FoldedText folded;
+  GArray *matches;
+  gsize position = 0;
+  gsize start, end;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (text != NULL, NULL);
+
+  if (length < 0)
+    length = strlen (text);
+
+  matches = g_array_new (FALSE, FALSE, sizeof (GnSearchMatch));
+  folded_text_init (&folded, text, length);
+
+  while (position < folded.text->len &&
+         gn_search_query_find_folded (self, &folded, position, &start, &end))
+    {
+      GnSearchMatch match;
+
+      folded_text_map_match (&folded, start, end, &match.start, &match.end);
+
+      if (matches->len > 0 &&
+          g_array_index (matches, GnSearchMatch, matches->len - 1).end >= match.start)
+        {
+          GnSearchMatch *last = &g_array_index (matches, GnSearchMatch, matches->len - 1);
+
+          last->end = MAX (last->end, match.end);
+        }
+      else if (match.end > match.start)
+        {
+          g_array_append_val (matches, match);
+        }
+
+      /* Continue after the match, or the character of an empty match */
+      if (end > start)
+        position = end;
+      else
+        position = g_utf8_next_char (folded.text->str + start) - folded.text->str;
+    }
+
+  folded_text_clear (&folded);
+
+  return matches;
+}
+
+/*
+ * Get the least number of edits to make @term a substring of
+ * the first @length bytes of @text (or till the NUL byte), with
+ * the bit parallel algorithm of Wu and Manber.  Returns
+ * term->max_distance + 1 if more edits are required.
+ *
+ * Bit j of state[d] is set if the first j + 1 bytes of @term
+ * match the text ending at the current byte with d edits.
+ */
+static guint
+fuzzy_distance (const Term  *term,
+                const gchar *text,
+                gsize        length)
+{
+  guint64 state[MAX_DISTANCE + 1];
+  guint64 found;
+  guint distance;
+
+  g_assert (term->masks != NULL);
+  g_assert (term->max_distance <= MAX_DISTANCE);
+
+  found = (guint64)1 << (strlen (term->text) - 1);
+  distance = term->max_distance + 1;
+
+  /* d bytes of @term can be deleted before the text starts */
+  for (guint d = 0; d <= term->max_distance; d++)
+    state[d] = ((guint64)1 << d) - 1;
+
+  for (gsize i = 0; i < length && text[i] != '\0' && distance > 0; i++)
+    {
+      guint64 mask = term->masks[(guchar)text[i]];
+      guint64 previous = state[0];
+
+      state[0] = ((state[0] << 1) | 1) & mask;
+
+      /* Only fewer edits than the best found so far matter */
+      for (guint d = 1; d < distance; d++)
+        {
+          guint64 old = state[d];
+
+          state[d] = (((old << 1) | 1) & mask) |  /* Match */
+            ((previous | state[d - 1]) << 1) | 1 |  /* Replace, delete */
+            previous;                               /* Insert */
+          previous = old;
+        }
+
+      for (guint d = 0; d < distance; d++)
+        if (state[d] & found)
+          {
+            distance = d;
+            break;
+          }
+    }
+
+  return distance;
+}
+
+/*
+ * Count the occurrences of @needle in the @length bytes of
+ * @haystack, at most @max times.  @in_title is set if any
+ * is in the first @title_length bytes of @haystack.
+ */
+static guint
+count_matches (const gchar *haystack,
+               gsize        length,
+               const gchar *needle,
+               gsize        title_length,
+               guint        max,
+               gboolean    *in_title)
+{
+  const gchar *match = haystack;
+  const gchar *end = haystack + length;
+  gsize needle_length;
+  guint count = 0;
+
+  needle_length = strlen (needle);
+  *in_title = FALSE;
+
+  while (count < max &&
+         (match = gn_utils_str_find (match, end - match, needle, needle_length)) != NULL)
+    {
+      if ((gsize)(match - haystack) < title_length)
+        *in_title = TRUE;
+
+      count++;
+      match += MAX (needle_length, 1);
+    }
+
+  return count;
+}
+
+/* Count the matches of @regex in the @length bytes of @text, at most @max times */
+static guint
+count_regex_field_matches (GRegex      *regex,
+                           const gchar *text,
+                           gssize       length,
+                           guint        max)
+{
+  g_autoptr(GMatchInfo) match_info = NULL;
+  guint count = 0;
+
+  g_regex_match_full (regex, text, length, 0, 0, &match_info, NULL);
+
+  while (count < max && g_match_info_matches (match_info))
+    {
+      count++;
+      g_match_info_next (match_info, NULL);
+    }
+
+  return count;
+}
+
+/*
+ * Count the matches of @regex in @haystack, at most @max times.
+ * The first @title_length bytes of @haystack are the title, and
+ * the rest after a new line the content, matched separately so
+ * that no match crosses them.  @in_title is set if any is in
+ * the title.
+ */
+static guint
+count_regex_matches (GRegex      *regex,
+                     const gchar *haystack,
+                     gsize        title_length,
+                     guint        max,
+                     gboolean    *in_title)
+{
+  guint count;
+
+  count = count_regex_field_matches (regex, haystack, title_length, max);
+  *in_title = count > 0;
+
+  if (count < max && haystack[title_length] == '\n')
+    count += count_regex_field_matches (regex, haystack + title_length + 1,
+                                        -1, max - count);
+
+  return count;
+}
+
+/**
+ * gn_search_query_match:
+ * @self: A #GnSearchQuery
+ * @document: A #GnSearchDocument
+ * @now: The current unix time, for ranking
+ * @score: (out) (optional): return location for the score
+ *
+ * Check if @document matches @self, and rank it.
+ *
+ * Returns: %TRUE if @document matches. %FALSE otherwise
+ */
+gboolean
+gn_search_query_match (GnSearchQuery          *self,
+                       const GnSearchDocument *document,
+                       gint64                  now,
+                       gdouble                *score)
+{
+  gdouble value = 0;
+  gsize text_length;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (document != NULL, FALSE);
+
+  if (document->modification_time < self->start_time ||
+      document->modification_time >= self->end_time)
+    return FALSE;
+
+  text_length = strlen (document->text);
+
+  for (guint i = 0; i < self->terms->len; i++)
+    {
+      Term *term = &g_array_index (self->terms, Term, i);
+      gboolean in_title;
+      guint count;
+
+      if (term->type == TERM_TAG)
+        {
+          if ((strstr (document->tags, term->text) != NULL) == term->excluded)
+            return FALSE;
+
+          continue;
+        }
+
+      if (term->type == TERM_REGEX)
+        count = count_regex_matches (term->regex, document->text, document->title_length,
+                                     term->excluded ? 1 : MAX_TERM_FREQUENCY, &in_title);
+      else
+        count = count_matches (document->text, text_length, term->text,
+                               document->title_length,
+                               term->excluded ? 1 : MAX_TERM_FREQUENCY, &in_title);
+
+      if (count == 0 && term->max_distance > 0)
+        {
+          guint distance;
+
+          if (!fuzzy_may_match (term, document->text, text_length))
+            return FALSE;
+
+          distance = fuzzy_distance (term, document->text, G_MAXSIZE);
+
+          if (distance > term->max_distance)
+            return FALSE;
+
+          /* The title is checked only if the term is found */
+          in_title = fuzzy_distance (term, document->text,
+                                     document->title_length) <= distance;
+          value += in_title ? TITLE_SCORE + 1 : 1;
+          value -= distance * DISTANCE_PENALTY;
+          continue;
+        }
+
+      if ((count > 0) == term->excluded)
+        return FALSE;
+
+      if (in_title)
+        value += TITLE_SCORE;
+      value += count;
+    }
+
+  if (score != NULL)
+    {
+      gint64 age = MAX (now - document->modification_time, 0);
+
+      value += RECENCY_SCORE / (1.0 + (gdouble)age / RECENCY_HALF_LIFE);
+      *score = value;
+    }
+
+  return TRUE;
+}
+
+typedef struct
+{
+  gpointer item;
+  gdouble  score;
+  gint64   modification_time;
+} RankedItem;
+
+/* The state shared by the chunks of a gn_search_query_evaluate() call */
+typedef struct
+{
+  GMutex mutex;
+  GCond  cond;
+  guint  n_pending;
+} Job;
+
+typedef struct
+{
+  Job           *job;
+  GnSearchQuery *query;
+  GPtrArray     *documents;
+  guint          start;
+  guint          end;
+  gint64         now;
+  GCancellable  *cancellable;
+  GArray        *ranked;    /* of RankedItem, sorted */
+} Chunk;
+
+static gint
+compare_ranked_item (gconstpointer a,
+                     gconstpointer b)
+{
+  const RankedItem *item_a = a;
+  const RankedItem *item_b = b;
+
+  if (item_a->score != item_b->score)
+    return item_a->score < item_b->score ? 1 : -1;
+
+  /* Newer first, as in the notes view */
+  return (item_a->modification_time < item_b->modification_time) -
+    (item_a->modification_time > item_b->modification_time);
+}
+
+static void
+gn_search_query_evaluate_chunk (Chunk *chunk)
+{
+  g_assert (chunk != NULL);
+
+  for (guint i = chunk->start; i < chunk->end; i++)
+    {
+      const GnSearchDocument *document = chunk->documents->pdata[i];
+      RankedItem ranked_item;
+
+      if ((i - chunk->start) % CANCEL_CHECK_INTERVAL == 0 &&
+          g_cancellable_is_cancelled (chunk->cancellable))
+        return;
+
+      if (!gn_search_query_match (chunk->query, document, chunk->now, &ranked_item.score))
+        continue;
+
+      ranked_item.item = document->item;
+      ranked_item.modification_time = document->modification_time;
+      g_array_append_val (chunk->ranked, ranked_item);
+    }
+
+  g_array_sort (chunk->ranked, compare_ranked_item);
+}
+
+static void
+gn_search_query_chunk_cb (gpointer data,
+                          gpointer user_data)
+{
+  Chunk *chunk = data;
+  Job *job = chunk->job;
+
+  gn_search_query_evaluate_chunk (chunk);
+
+  g_mutex_lock (&job->mutex);
+  job->n_pending--;
+  g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->mutex);
+}
+
+static GThreadPool *
+gn_search_query_get_thread_pool (void)
+{
+  static GThreadPool *thread_pool;
+  static gsize initialized;
+
+  if (g_once_init_enter (&initialized))
+    {
+      thread_pool = g_thread_pool_new (gn_search_query_chunk_cb, NULL,
+                                       g_get_num_processors (), FALSE, NULL);
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return thread_pool;
+}
+
+/*
+ * Merge the sorted results of @chunks into @items.  There are
+ * only a few chunks, so the best of the heads is found linearly.
+ */
+static void
+merge_chunks (Chunk     *chunks,
+              guint      n_chunks,
+              GPtrArray *items)
+{
+  g_autofree guint *heads = NULL;
+
+  heads = g_new0 (guint, n_chunks);
+
+  while (TRUE)
+    {
+      RankedItem *best = NULL;
+      guint best_chunk = 0;
+
+      for (guint i = 0; i < n_chunks; i++)
+        {
+          RankedItem *head;
+
+          if (heads[i] == chunks[i].ranked->len)
+            continue;
+
+          head = &g_array_index (chunks[i].ranked, RankedItem, heads[i]);
+
+          if (best == NULL || compare_ranked_item (head, best) < 0)
+            {
+              best = head;
+              best_chunk = i;
+            }
+        }
+
+      if (best == NULL)
+        break;
+
+      g_ptr_array_add (items, best->item);
+      heads[best_chunk]++;
+    }
+}
+
+/**
+ * gn_search_query_collect:
+ * @self: A #GnSearchQuery
+ * @index: A #GnSearchIndex
+ *
+ * Get the documents in @index that may match @self, to be
+ * matched with gn_search_query_evaluate().  The documents
+ * having the text terms of @self are found with
+ * gn_search_index_search(), starting with the term having
+ * the least items.
+ *
+ * This should be called in the thread @index is used.
+ *
+ * Returns: (transfer full): A #GPtrArray of #GnSearchDocument.
+ * Free with g_ptr_array_unref() in the thread @index is used.
+ */
+GPtrArray *
+gn_search_query_collect (GnSearchQuery *self,
+                         GnSearchIndex *index)
+{
+  g_autoptr(GHashTable) candidates = NULL;
+  GHashTableIter iter;
+  GPtrArray *documents;
+  gpointer item;
+
+  GN_ENTRY;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (index != NULL, NULL);
+
+  for (guint i = 0; i < self->terms->len; i++)
+    {
+      Term *term = &g_array_index (self->terms, Term, i);
+      g_autoptr(GHashTable) term_items = NULL;
+
+      /* Terms with typos can't be looked up in the index */
+      if (term->type != TERM_TEXT || term->excluded || term->max_distance > 0)
+        continue;
+
+      term_items = gn_search_index_search (index, term->text, NULL, NULL);
+
+      if (candidates == NULL ||
+          g_hash_table_size (term_items) < g_hash_table_size (candidates))
+        {
+          g_clear_pointer (&candidates, g_hash_table_unref);
+          candidates = g_steal_pointer (&term_items);
+        }
+    }
+
+  /* No text to search, so every item is a candidate */
+  if (candidates == NULL)
+    candidates = gn_search_index_search (index, "", NULL, NULL);
+
+  documents = g_ptr_array_new_full (g_hash_table_size (candidates),
+                                    (GDestroyNotify)gn_search_document_unref);
+
+  g_hash_table_iter_init (&iter, candidates);
+  while (g_hash_table_iter_next (&iter, &item, NULL))
+    {
+      const GnSearchDocument *document;
+
+      document = gn_search_index_get_document (index, item);
+      g_assert (document != NULL);
+      g_ptr_array_add (documents, gn_search_document_ref ((GnSearchDocument *)document));
+    }
+
+  GN_RETURN (documents);
+}
+
+/**
+ * gn_search_query_evaluate:
+ * @self: A #GnSearchQuery
+ * @documents: A #GPtrArray of #GnSearchDocument
+ * @now: The current unix time, for ranking
+ * @cancellable: (nullable): A #GCancellable
+ * @error: return location for a #GError
+ *
+ * Match each of @documents with gn_search_query_match(),
+ * and rank them.  Large arrays are split into chunks which
+ * are matched in parallel in a thread pool, and the results
+ * are then merged.
+ *
+ * This can be called in any thread, and blocks till every
+ * document is matched, or @cancellable is cancelled.
+ *
+ * Returns: (transfer container) (nullable): A #GPtrArray of
+ * the items of the matching documents, the best ranked first,
+ * or %NULL with @error set if cancelled.  The items are owned
+ * by @documents.  Free with g_ptr_array_unref()
+ */
+GPtrArray *
+gn_search_query_evaluate (GnSearchQuery  *self,
+                          GPtrArray      *documents,
+                          gint64          now,
+                          GCancellable   *cancellable,
+                          GError        **error)
+{
+  g_autofree Chunk *chunks = NULL;
+  GPtrArray *items;
+  Job job;
+  guint n_chunks, chunk_size;
+
+  GN_ENTRY;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (documents != NULL, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  n_chunks = CLAMP (documents->len / MIN_CHUNK_SIZE, 1, g_get_num_processors ());
+  chunk_size = (documents->len + n_chunks - 1) / n_chunks;
+  chunks = g_new0 (Chunk, n_chunks);
+
+  g_mutex_init (&job.mutex);
+  g_cond_init (&job.cond);
+  job.n_pending = n_chunks - 1;
+
+  for (guint i = 0; i < n_chunks; i++)
+    {
+      chunks[i].job = &job;
+      chunks[i].query = self;
+      chunks[i].documents = documents;
+      chunks[i].start = MIN (i * chunk_size, documents->len);
+      chunks[i].end = MIN (chunks[i].start + chunk_size, documents->len);
+      chunks[i].now = now;
+      chunks[i].cancellable = cancellable;
+      chunks[i].ranked = g_array_new (FALSE, FALSE, sizeof (RankedItem));
+    }
+
+  /* The first chunk is done in this thread, while others are done */
+  for (guint i = 1; i < n_chunks; i++)
+    g_thread_pool_push (gn_search_query_get_thread_pool (), &chunks[i], NULL);
+
+  gn_search_query_evaluate_chunk (&chunks[0]);
+
+  g_mutex_lock (&job.mutex);
+  while (job.n_pending > 0)
+    g_cond_wait (&job.cond, &job.mutex);
+  g_mutex_unlock (&job.mutex);
+
+  g_mutex_clear (&job.mutex);
+  g_cond_clear (&job.cond);
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    items = NULL;
+  else
+    {
+      items = g_ptr_array_sized_new (chunks[0].ranked->len * n_chunks);
+      merge_chunks (chunks, n_chunks, items);
+    }
+
+  for (guint i = 0; i < n_chunks; i++)
+    g_array_unref (chunks[i].ranked);
+
+  GN_RETURN (items);
+}
+
+/**
+ * gn_search_query_run:
+ * @self: A #GnSearchQuery
+ * @index: A #GnSearchIndex
+ * @now: The current unix time, for ranking
+ *
+ * Find the items in @index that match @self, with
+ * gn_search_query_collect() and gn_search_query_evaluate().
+ *
+ * Returns: (transfer container): A #GPtrArray of items,
+ * the best ranked first.  Free with g_ptr_array_unref()
+ */
+GPtrArray *
+gn_search_query_run (GnSearchQuery *self,
+                     GnSearchIndex *index,
+                     gint64         now)
+{
+  g_autoptr(GPtrArray) documents = NULL;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (index != NULL, NULL);
+
+  documents = gn_search_query_collect (self, index);
+
+  /* The items are still owned by @index, after @documents are freed */
+  return gn_search_query_evaluate (self, documents, now, NULL, NULL);
+}
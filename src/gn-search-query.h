@@ -0,0 +1,69 @@
+/* gn-search-query.h
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "gn-search-index.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GnSearchQuery GnSearchQuery;
+
+/* A match of #GnSearchQuery in a text, as byte offsets [start, end) */
+typedef struct
+{
+  gint start;
+  gint end;
+} GnSearchMatch;
+
+GnSearchQuery *gn_search_query_new        (const gchar            *query);
+void           gn_search_query_free       (GnSearchQuery          *self);
+void           gn_search_query_set_max_distance (GnSearchQuery    *self,
+                                                 guint             max_distance);
+
+gboolean       gn_search_query_match      (GnSearchQuery          *self,
+                                           const GnSearchDocument *document,
+                                           gint64                  now,
+                                           gdouble                *score);
+gboolean       gn_search_query_find       (GnSearchQuery          *self,
+                                           const gchar            *text,
+                                           gssize                  length,
+                                           gint                    start_position,
+                                           gint                   *match_start,
+                                           gint                   *match_end);
+GArray        *gn_search_query_find_all   (GnSearchQuery          *self,
+                                           const gchar            *text,
+                                           gssize                  length);
+GPtrArray     *gn_search_query_collect    (GnSearchQuery          *self,
+                                           GnSearchIndex          *index);
+GPtrArray     *gn_search_query_evaluate   (GnSearchQuery          *self,
+                                           GPtrArray              *documents,
+                                           gint64                  now,
+                                           GCancellable           *cancellable,
+                                           GError                **error);
+GPtrArray     *gn_search_query_run        (GnSearchQuery          *self,
+                                           GnSearchIndex          *index,
+                                           gint64                  now);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GnSearchQuery, gn_search_query_free)
+
+G_END_DECLS
@@ -334,6 +334,38 @@ gn_settings_set_window_maximized (GnSettings *self,
   g_settings_set_boolean (G_SETTINGS (self), "window-maximized", !!maximized);
 }
 
+/**
+ * gn_settings_get_sort_mode:
+ * @self: A #GnSettings
+ *
+ * Get the order in which notes are listed.
+ *
+ * Returns: A #GnSortMode
+ */
+GnSortMode
+gn_settings_get_sort_mode (GnSettings *self)
+{
+  g_return_val_if_fail (GN_IS_SETTINGS (self), GN_SORT_MODE_TITLE);
+
+  return g_settings_get_enum (G_SETTINGS (self), "sort-mode");
+}
+
+/**
+ * gn_settings_get_search_max_distance:
+ * @self: A #GnSettings
+ *
+ * Get the number of typos allowed in each search term.
+ *
+ * Returns: The maximum edit distance, 0 to match exactly
+ */
+guint
+gn_settings_get_search_max_distance (GnSettings *self)
+{
+  g_return_val_if_fail (GN_IS_SETTINGS (self), 0);
+
+  return g_settings_get_uint (G_SETTINGS (self), "search-max-distance");
+}
+
 /**
  * gn_settings_get_window_geometry:
  * @self: A #GnSettings
@@ -22,6 +22,8 @@
 
 #include <gtk/gtk.h>
 
+#include "gn-enums.h"
+
 G_BEGIN_DECLS
 
 #define GN_TYPE_SETTINGS (gn_settings_get_type ())
@@ -50,5 +52,7 @@ gboolean     gn_settings_set_provider_name   (GnSettings    *self,
 const gchar *gn_settings_get_font_name       (GnSettings    *self);
 gboolean     gn_settings_set_font_name       (GnSettings    *self,
                                               const gchar   *name);
+GnSortMode   gn_settings_get_sort_mode       (GnSettings    *self);
+guint        gn_settings_get_search_max_distance (GnSettings *self);
 
 G_END_DECLS
@@ -25,6 +25,16 @@
 
 #include <glib/gi18n.h>
 #include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+# include <immintrin.h>
+# define GN_HAVE_SSE2 1
+/* AVX2 code is built with a target attribute, and used only if the CPU has it */
+# if defined(__GNUC__) && !defined(__INTEL_COMPILER)
+#  define GN_HAVE_AVX2 1
+# endif
+#endif
 
 #include "gn-utils.h"
 #include "gn-trace.h"
@@ -465,7 +475,8 @@ gn_utils_get_other_view_type (const gchar *view)
  * @position: (out): A location to store position
  *
  * Get the position of @item in @model.
- * This is an O(n) operation.
+ * This is an O(n) operation.  Use gn_item_store_get_position()
+ * for a #GnItemStore.
  *
  * Returns: %TRUE if @item was found in @model.
  */
@@ -496,6 +507,228 @@ gn_utils_get_item_position (GListModel *model,
   return FALSE;
 }
 
+static gboolean
+gn_utils_parse_digits (const gchar *str,
+                       guint        n_digits,
+                       guint       *value)
+{
+  guint result = 0;
+
+  for (guint i = 0; i < n_digits; i++)
+    {
+      if (!g_ascii_isdigit (str[i]))
+        return FALSE;
+
+      result = result * 10 + (str[i] - '0');
+    }
+
+  *value = result;
+
+  return TRUE;
+}
+
+static gboolean
+gn_utils_is_leap_year (guint year)
+{
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+/*
+ * Days since 1970-01-01 in the proleptic Gregorian calendar.
+ * See http://howardhinnant.github.io/date_algorithms.html
+ */
+static gint64
+gn_utils_days_from_civil (gint64 year,
+                          guint  month,
+                          guint  day)
+{
+  gint64 era;
+  guint year_of_era, day_of_year, day_of_era;
+
+  year -= month <= 2;
+  era = (year >= 0 ? year : year - 399) / 400;
+  year_of_era = year - era * 400;
+  day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+  return era * 146097 + day_of_era - 719468;
+}
+
+/* The reverse of gn_utils_days_from_civil() */
+static void
+gn_utils_civil_from_days (gint64  days,
+                          gint64 *year,
+                          guint  *month,
+                          guint  *day)
+{
+  gint64 era;
+  guint year_of_era, day_of_year, day_of_era, mp;
+
+  days += 719468;
+  era = (days >= 0 ? days : days - 146096) / 146097;
+  day_of_era = days - era * 146097;
+  year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524
+                 - day_of_era / 146096) / 365;
+  day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  mp = (5 * day_of_year + 2) / 153;
+
+  *day = day_of_year - (153 * mp + 2) / 5 + 1;
+  *month = mp < 10 ? mp + 3 : mp - 9;
+  *year = year_of_era + era * 400 + (*month <= 2);
+}
+
+/**
+ * gn_utils_iso_to_unix_time:
+ * @iso_time: An ISO 8601 formatted time string
+ * @length: The length of @iso_time, or -1
+ * @unix_time: (out): return location for seconds since Epoch
+ *
+ * Parse @iso_time to get the time in seconds since Epoch.
+ * Time in the format "YYYY-MM-DDThh:mm:ssZ" (the format we
+ * write) is parsed without any allocation.  Any other ISO 8601
+ * format is parsed with g_date_time_new_from_iso8601().
+ *
+ * @iso_time need not be NUL terminated if @length is given.
+ *
+ * Returns: %TRUE if @iso_time was parsed successfully.
+ * %FALSE otherwise.
+ */
+gboolean
+gn_utils_iso_to_unix_time (const gchar *iso_time,
+                           gssize       length,
+                           gint64      *unix_time)
+{
+  static const guint8 days_in_month[] = {
+    31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+  };
+  g_autoptr(GDateTime) date_time = NULL;
+  g_autofree gchar *str = NULL;
+  guint year, month, day, hour, minute, second;
+
+  g_return_val_if_fail (iso_time != NULL, FALSE);
+  g_return_val_if_fail (unix_time != NULL, FALSE);
+
+  if (length < 0)
+    length = strlen (iso_time);
+
+  /* YYYY-MM-DDThh:mm:ssZ */
+  if (length == 20 &&
+      iso_time[4] == '-' && iso_time[7] == '-' && iso_time[10] == 'T' &&
+      iso_time[13] == ':' && iso_time[16] == ':' && iso_time[19] == 'Z' &&
+      gn_utils_parse_digits (iso_time, 4, &year) &&
+      gn_utils_parse_digits (iso_time + 5, 2, &month) &&
+      gn_utils_parse_digits (iso_time + 8, 2, &day) &&
+      gn_utils_parse_digits (iso_time + 11, 2, &hour) &&
+      gn_utils_parse_digits (iso_time + 14, 2, &minute) &&
+      gn_utils_parse_digits (iso_time + 17, 2, &second))
+    {
+      guint max_day;
+
+      if (year == 0 || month < 1 || month > 12 ||
+          hour > 23 || minute > 59 || second > 59)
+        return FALSE;
+
+      max_day = days_in_month[month - 1];
+      if (month == 2 && gn_utils_is_leap_year (year))
+        max_day++;
+
+      if (day < 1 || day > max_day)
+        return FALSE;
+
+      *unix_time = gn_utils_days_from_civil (year, month, day) * 86400
+        + hour * 3600 + minute * 60 + second;
+
+      return TRUE;
+    }
+
+  /* Some other format, let GLib handle it */
+  str = g_strndup (iso_time, length);
+  date_time = g_date_time_new_from_iso8601 (str, NULL);
+
+  if (date_time == NULL)
+    return FALSE;
+
+  *unix_time = g_date_time_to_unix (date_time);
+
+  return TRUE;
+}
+
+/**
+ * gn_utils_unix_time_to_iso_buffer:
+ * @unix_time: seconds since Epoch
+ * @buffer: A buffer of at least %GN_ISO_TIME_BUFFER_SIZE bytes
+ *
+ * Write ISO8601 string representing the given @unix_time
+ * to @buffer, in the format "YYYY-MM-DDThh:mm:ssZ".
+ * @unix_time is assumed to be in UTC.
+ *
+ * If @unix_time can’t be represented, @buffer is set to
+ * an empty string.
+ *
+ * Returns: The length of the string written to @buffer
+ */
+gsize
+gn_utils_unix_time_to_iso_buffer (gint64  unix_time,
+                                  gchar  *buffer)
+{
+  g_autoptr(GDateTime) date_time = NULL;
+  g_autofree gchar *str = NULL;
+  gint64 days, seconds, year;
+  guint month, day;
+
+  g_return_val_if_fail (buffer != NULL, 0);
+
+  days = unix_time / 86400;
+  seconds = unix_time % 86400;
+
+  if (seconds < 0)
+    {
+      days--;
+      seconds += 86400;
+    }
+
+  gn_utils_civil_from_days (days, &year, &month, &day);
+
+  if (year >= 1000 && year <= 9999)
+    {
+      guint hour = seconds / 3600;
+      guint minute = seconds / 60 % 60;
+      guint second = seconds % 60;
+
+      buffer[0] = '0' + year / 1000;
+      buffer[1] = '0' + year / 100 % 10;
+      buffer[2] = '0' + year / 10 % 10;
+      buffer[3] = '0' + year % 10;
+      buffer[4] = '-';
+      buffer[5] = '0' + month / 10;
+      buffer[6] = '0' + month % 10;
+      buffer[7] = '-';
+      buffer[8] = '0' + day / 10;
+      buffer[9] = '0' + day % 10;
+      buffer[10] = 'T';
+      buffer[11] = '0' + hour / 10;
+      buffer[12] = '0' + hour % 10;
+      buffer[13] = ':';
+      buffer[14] = '0' + minute / 10;
+      buffer[15] = '0' + minute % 10;
+      buffer[16] = ':';
+      buffer[17] = '0' + second / 10;
+      buffer[18] = '0' + second % 10;
+      buffer[19] = 'Z';
+      buffer[20] = '\0';
+
+      return 20;
+    }
+
+  /* Rare, let GLib handle it */
+  date_time = g_date_time_new_from_unix_utc (unix_time);
+
+  if (date_time != NULL)
+    str = g_date_time_format (date_time, "%FT%TZ");
+
+  return g_strlcpy (buffer, str ? str : "", GN_ISO_TIME_BUFFER_SIZE);
+}
+
 /**
  * gn_utils_unix_time_to_iso:
  * @unix_time: seconds since Epoch
@@ -503,16 +736,19 @@ gn_utils_get_item_position (GListModel *model,
  * Get ISO8601 string representing the given @unix_time.
  * @unix_time is assumed to be in UTC.
  *
+ * See gn_utils_unix_time_to_iso_buffer() to avoid allocation.
+ *
  * Returns: A new string.  Free with g_free().
  */
 gchar *
 gn_utils_unix_time_to_iso (gint64 unix_time)
 {
-  g_autoptr (GDateTime) date_time = NULL;
+  gchar buffer[GN_ISO_TIME_BUFFER_SIZE];
+  gsize length;
 
-  date_time = g_date_time_new_from_unix_utc (unix_time);
+  length = gn_utils_unix_time_to_iso_buffer (unix_time, buffer);
 
-  return g_date_time_format (date_time, "%FT%TZ");
+  return g_strndup (buffer, length);
 }
 
 /**
@@ -572,3 +808,305 @@ gn_utils_get_human_time (gint64 unix_time)
   /* Year */
   return g_date_time_format (local_time, "%Y");
 }
+
+/* Returns %TRUE if each of the @length bytes in @str is ASCII */
+static gboolean
+gn_utils_is_ascii (const gchar *str,
+                   gsize        length)
+{
+  gsize i = 0;
+
+#ifdef GN_HAVE_SSE2
+  for (; i + 16 <= length; i += 16)
+    if (_mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i *)(str + i))) != 0)
+      return FALSE;
+#endif
+
+  for (; i < length; i++)
+    if ((guchar)str[i] >= 0x80)
+      return FALSE;
+
+  return TRUE;
+}
+
+/* @needle should be in lower case, if @ignore_case */
+static inline gboolean
+gn_utils_str_equal_len (const gchar *str,
+                        const gchar *needle,
+                        gsize        length,
+                        gboolean     ignore_case)
+{
+  if (!ignore_case)
+    return memcmp (str, needle, length) == 0;
+
+  for (gsize i = 0; i < length; i++)
+    if (g_ascii_tolower (str[i]) != needle[i])
+      return FALSE;
+
+  return TRUE;
+}
+
+/*
+ * Find @needle in @haystack starting from @start, ignoring ASCII
+ * case if @ignore_case.  Returns the first match, or %NULL.
+ */
+static const gchar *
+gn_utils_find_from (const gchar *haystack,
+                    gsize        length,
+                    const gchar *needle,
+                    gsize        needle_length,
+                    gboolean     ignore_case,
+                    gsize        start)
+{
+  for (gsize i = start; i + needle_length <= length; i++)
+    if ((ignore_case ? g_ascii_tolower (haystack[i]) : haystack[i]) == needle[0] &&
+        gn_utils_str_equal_len (haystack + i, needle, needle_length, ignore_case))
+      return haystack + i;
+
+  return NULL;
+}
+
+static const gchar *
+gn_utils_find (const gchar *haystack,
+               gsize        length,
+               const gchar *needle,
+               gsize        needle_length,
+               gboolean     ignore_case)
+{
+  return gn_utils_find_from (haystack, length, needle, needle_length, ignore_case, 0);
+}
+
+/*
+ * The SIMD versions compare a block of bytes with the first
+ * and last bytes of @needle at once, and only the positions
+ * where both match are compared with the whole @needle.
+ */
+#ifdef GN_HAVE_SSE2
+static inline __m128i
+gn_utils_sse2_ascii_lower (__m128i block)
+{
+  __m128i upper;
+
+  upper = _mm_and_si128 (_mm_cmpgt_epi8 (block, _mm_set1_epi8 ('A' - 1)),
+                         _mm_cmplt_epi8 (block, _mm_set1_epi8 ('Z' + 1)));
+
+  return _mm_or_si128 (block, _mm_and_si128 (upper, _mm_set1_epi8 (0x20)));
+}
+
+static const gchar *
+gn_utils_find_sse2 (const gchar *haystack,
+                    gsize        length,
+                    const gchar *needle,
+                    gsize        needle_length,
+                    gboolean     ignore_case)
+{
+  const __m128i first = _mm_set1_epi8 (needle[0]);
+  const __m128i last = _mm_set1_epi8 (needle[needle_length - 1]);
+  gsize i = 0;
+
+  for (; i + needle_length - 1 + 16 <= length; i += 16)
+    {
+      __m128i block_first, block_last;
+      guint mask;
+
+      block_first = _mm_loadu_si128 ((const __m128i *)(haystack + i));
+      block_last = _mm_loadu_si128 ((const __m128i *)(haystack + i + needle_length - 1));
+
+      if (ignore_case)
+        {
+          block_first = gn_utils_sse2_ascii_lower (block_first);
+          block_last = gn_utils_sse2_ascii_lower (block_last);
+        }
+
+      mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (block_first, first),
+                                               _mm_cmpeq_epi8 (block_last, last)));
+
+      while (mask != 0)
+        {
+          gint bit = g_bit_nth_lsf (mask, -1);
+
+          if (gn_utils_str_equal_len (haystack + i + bit, needle, needle_length, ignore_case))
+            return haystack + i + bit;
+
+          mask &= mask - 1;
+        }
+    }
+
+  return gn_utils_find_from (haystack, length, needle, needle_length, ignore_case, i);
+}
+#endif
+
+#ifdef GN_HAVE_AVX2
+__attribute__ ((target ("avx2")))
+static inline __m256i
+gn_utils_avx2_ascii_lower (__m256i block)
+{
+  __m256i upper;
+
+  upper = _mm256_and_si256 (_mm256_cmpgt_epi8 (block, _mm256_set1_epi8 ('A' - 1)),
+                            _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('Z' + 1), block));
+
+  return _mm256_or_si256 (block, _mm256_and_si256 (upper, _mm256_set1_epi8 (0x20)));
+}
+
+__attribute__ ((target ("avx2")))
+static const gchar *
+gn_utils_find_avx2 (const gchar *haystack,
+                    gsize        length,
+                    const gchar *needle,
+                    gsize        needle_length,
+                    gboolean     ignore_case)
+{
+  const __m256i first = _mm256_set1_epi8 (needle[0]);
+  const __m256i last = _mm256_set1_epi8 (needle[needle_length - 1]);
+  gsize i = 0;
+
+  for (; i + needle_length - 1 + 32 <= length; i += 32)
+    {
+      __m256i block_first, block_last;
+      guint mask;
+
+      block_first = _mm256_loadu_si256 ((const __m256i *)(haystack + i));
+      block_last = _mm256_loadu_si256 ((const __m256i *)(haystack + i + needle_length - 1));
+
+      if (ignore_case)
+        {
+          block_first = gn_utils_avx2_ascii_lower (block_first);
+          block_last = gn_utils_avx2_ascii_lower (block_last);
+        }
+
+      mask = (guint)_mm256_movemask_epi8 (_mm256_and_si256 (_mm256_cmpeq_epi8 (block_first, first),
+                                                            _mm256_cmpeq_epi8 (block_last, last)));
+
+      while (mask != 0)
+        {
+          gint bit = g_bit_nth_lsf (mask, -1);
+
+          if (gn_utils_str_equal_len (haystack + i + bit, needle, needle_length, ignore_case))
+            return haystack + i + bit;
+
+          mask &= mask - 1;
+        }
+    }
+
+  return gn_utils_find_from (haystack, length, needle, needle_length, ignore_case, i);
+}
+#endif
+
+typedef const gchar *(*GnFindFunc) (const gchar *haystack,
+                                    gsize        length,
+                                    const gchar *needle,
+                                    gsize        needle_length,
+                                    gboolean     ignore_case);
+
+/* Get the fastest search function the CPU supports */
+static GnFindFunc
+gn_utils_get_find_func (void)
+{
+  static GnFindFunc find_func;
+  static gsize initialized;
+
+  if (g_once_init_enter (&initialized))
+    {
+      find_func = gn_utils_find;
+
+#ifdef GN_HAVE_SSE2
+      find_func = gn_utils_find_sse2;
+#endif
+
+#ifdef GN_HAVE_AVX2
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("avx2"))
+        find_func = gn_utils_find_avx2;
+#endif
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return find_func;
+}
+
+/**
+ * gn_utils_str_casefold_contains:
+ * @haystack: A UTF-8 string
+ * @length: The length of @haystack in bytes, or -1
+ * @needle: A casefolded UTF-8 string, see g_utf8_casefold()
+ *
+ * Check if @needle is a substring of the casefolded
+ * @haystack.  If @haystack is ASCII, it is searched
+ * ignoring case without any allocation, using SIMD
+ * instructions if the CPU supports.  Otherwise @haystack
+ * is casefolded with g_utf8_casefold() and searched.
+ *
+ * @haystack need not be NUL terminated if @length is given.
+ *
+ * Returns: %TRUE if @needle is found.  %FALSE otherwise.
+ */
+gboolean
+gn_utils_str_casefold_contains (const gchar *haystack,
+                                gssize       length,
+                                const gchar *needle)
+{
+  g_autofree gchar *casefold = NULL;
+  gsize needle_length;
+
+  g_return_val_if_fail (haystack != NULL, FALSE);
+  g_return_val_if_fail (needle != NULL, FALSE);
+
+  if (length < 0)
+    length = strlen (haystack);
+
+  needle_length = strlen (needle);
+
+  if (needle_length == 0)
+    return TRUE;
+
+  if (gn_utils_is_ascii (haystack, length))
+    {
+      /* ASCII strings are casefolded to ASCII, which can't have @needle */
+      if (needle_length > (gsize)length ||
+          !gn_utils_is_ascii (needle, needle_length))
+        return FALSE;
+
+      return gn_utils_get_find_func () (haystack, length, needle, needle_length, TRUE) != NULL;
+    }
+
+  casefold = g_utf8_casefold (haystack, length);
+
+  return gn_utils_str_find (casefold, strlen (casefold), needle, needle_length) != NULL;
+}
+
+/**
+ * gn_utils_str_find:
+ * @haystack: A string, casefolded if @needle is
+ * @length: The length of @haystack in bytes
+ * @needle: The string to find
+ * @needle_length: The length of @needle in bytes
+ *
+ * Find the first occurrence of @needle in @haystack, comparing
+ * the bytes as such.  This is meant for searching in text that
+ * is already casefolded, like that in #GnSearchIndex, and uses
+ * SIMD instructions if the CPU supports.
+ *
+ * @haystack need not be NUL terminated.
+ *
+ * Returns: (nullable): A pointer to the match in @haystack,
+ * or %NULL if not found.
+ */
+const gchar *
+gn_utils_str_find (const gchar *haystack,
+                   gsize        length,
+                   const gchar *needle,
+                   gsize        needle_length)
+{
+  g_return_val_if_fail (haystack != NULL, NULL);
+  g_return_val_if_fail (needle != NULL, NULL);
+
+  if (needle_length == 0)
+    return haystack;
+
+  if (needle_length > length)
+    return NULL;
+
+  return gn_utils_get_find_func () (haystack, length, needle, needle_length, FALSE);
+}
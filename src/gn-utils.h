@@ -27,6 +27,9 @@ G_BEGIN_DECLS
 
 #define GN_ASCII_UNIT_SEPARATOR '\x1F'
 
+/* Enough to hold "YYYY-MM-DDThh:mm:ssZ" with the trailing NUL */
+#define GN_ISO_TIME_BUFFER_SIZE 32
+
 #define GN_IS_MAIN_THREAD() (g_thread_self () == gn_utils_get_main_thread ())
 
 GThread    *gn_utils_get_main_thread    (void);
@@ -37,7 +40,19 @@ const gchar *gn_utils_get_other_view_type    (const gchar *view);
 gboolean     gn_utils_get_item_position      (GListModel *model,
                                               gpointer    item,
                                               guint      *position);
+gboolean     gn_utils_iso_to_unix_time       (const gchar *iso_time,
+                                              gssize       length,
+                                              gint64      *unix_time);
+gsize        gn_utils_unix_time_to_iso_buffer (gint64      unix_time,
+                                               gchar      *buffer);
 gchar       *gn_utils_unix_time_to_iso       (gint64      unix_time);
 gchar       *gn_utils_get_human_time         (gint64      unix_time);
+gboolean     gn_utils_str_casefold_contains  (const gchar *haystack,
+                                              gssize       length,
+                                              const gchar *needle);
+const gchar *gn_utils_str_find               (const gchar *haystack,
+                                              gsize        length,
+                                              const gchar *needle,
+                                              gsize        needle_length);
 
 G_END_DECLS
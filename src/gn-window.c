@@ -70,6 +70,8 @@ struct _GnWindow
 
   gboolean   is_main_window;
   guint      undo_timeout_id;
+
+  GCancellable *search_cancellable;
 };
 
 G_DEFINE_TYPE (GnWindow, gn_window, GTK_TYPE_APPLICATION_WINDOW)
@@ -212,19 +214,41 @@ gn_window_key_press_cb (GtkEventController *controller,
                                       gtk_get_current_event ());
 }
 
+static void
+gn_window_search_cb (GObject      *object,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+  g_autoptr(GError) error = NULL;
+
+  g_assert (GN_IS_MANAGER (object));
+
+  if (!gn_manager_search_finish (GN_MANAGER (object), result, &error) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    g_warning ("Error searching: %s", error->message);
+}
+
 static void
 gn_window_search_changed (GnWindow       *self,
                           GtkSearchEntry *search_entry)
 {
+  const gchar *terms[2] = { NULL, NULL };
   const gchar *needle;
   GnManager *manager;
 
   g_assert (GN_IS_WINDOW (self));
   g_assert (GTK_IS_SEARCH_ENTRY (search_entry));
 
+  /* The search for the old text is no longer needed */
+  g_cancellable_cancel (self->search_cancellable);
+  g_clear_object (&self->search_cancellable);
+  self->search_cancellable = g_cancellable_new ();
+
   manager = gn_manager_get_default ();
   needle = gtk_entry_get_text (GTK_ENTRY (search_entry));
-  gn_manager_search (manager, &needle);
+  terms[0] = needle;
+  gn_manager_search_async (manager, terms, self->search_cancellable,
+                           gn_window_search_cb, NULL);
 
   if (needle[0] != '\0')
     gtk_stack_set_visible_child (GTK_STACK (self->main_view),
@@ -608,6 +632,17 @@ gn_window_unmap (GtkWidget *widget)
   GTK_WIDGET_CLASS (gn_window_parent_class)->unmap (widget);
 }
 
+static void
+gn_window_dispose (GObject *object)
+{
+  GnWindow *self = (GnWindow *)object;
+
+  g_cancellable_cancel (self->search_cancellable);
+  g_clear_object (&self->search_cancellable);
+
+  G_OBJECT_CLASS (gn_window_parent_class)->dispose (object);
+}
+
 static void
 gn_window_class_init (GnWindowClass *klass)
 {
@@ -615,6 +650,7 @@ gn_window_class_init (GnWindowClass *klass)
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
   object_class->constructed = gn_window_constructed;
+  object_class->dispose = gn_window_dispose;
 
   widget_class->unmap = gn_window_unmap;
 
@@ -665,11 +701,18 @@ gn_window_add_actions (GnWindow *self)
     { "delete-items", gn_window_delete_items },
     { "show-tag-editor", gn_window_show_tag_editor },
   };
+  g_autoptr(GAction) sort_action = NULL;
+  GnSettings *settings;
 
   g_assert (GN_IS_WINDOW (self));
 
   g_action_map_add_action_entries (G_ACTION_MAP (self), win_entries,
                                    G_N_ELEMENTS (win_entries), self);
+
+  /* The manager resorts the notes when the setting changes */
+  settings = gn_manager_get_settings (gn_manager_get_default ());
+  sort_action = g_settings_create_action (G_SETTINGS (settings), "sort-mode");
+  g_action_map_add_action (G_ACTION_MAP (self), sort_action);
 }
 
 
@@ -0,0 +1,603 @@
+/* gn-item-store.c
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "gn-item-store"
+
+#include "config.h"
+
+#include "gn-item-store.h"
+#include "gn-trace.h"
+
+/**
+ * SECTION: gn-item-store
+ * @title: GnItemStore
+ * @short_description: A list of items, indexed by item
+ * @include: "gn-item-store.h"
+ *
+ * #GnItemStore is a #GListModel of #GnItem, like a #GListStore,
+ * that also keeps the place of each item in the list.  So the
+ * position of an item can be found in O(log n) time instead of
+ * walking the whole list, and a set of items can be removed
+ * without searching for each of them.
+ *
+ * An item can be added only once to a store.
+ */
+
+struct _GnItemStore
+{
+  GObject    parent_instance;
+
+  /* The items, each holding a reference */
+  GSequence *items;
+  /* GnItem to the GSequenceIter of the item in @items */
+  GHashTable *iters;
+
+  /* The last item looked up, to walk the list one by one fast */
+  GSequenceIter *last_iter;
+  guint          last_position;
+  gboolean       last_position_valid;
+};
+
+static void gn_item_store_list_model_iface_init (GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (GnItemStore, gn_item_store, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL,
+                                                gn_item_store_list_model_iface_init))
+
+
+static void
+gn_item_store_items_changed (GnItemStore *self,
+                             guint        position,
+                             guint        removed,
+                             guint        added)
+{
+  g_assert (GN_IS_ITEM_STORE (self));
+
+  self->last_position_valid = FALSE;
+  self->last_iter = NULL;
+
+  if (removed > 0 || added > 0)
+    g_list_model_items_changed (G_LIST_MODEL (self), position, removed, added);
+}
+
+static GSequenceIter *
+gn_item_store_insert_before (GnItemStore   *self,
+                             GSequenceIter *iter,
+                             GnItem        *item)
+{
+  GSequenceIter *new_iter;
+
+  g_assert (GN_IS_ITEM_STORE (self));
+  g_assert (GN_IS_ITEM (item));
+  g_assert (!g_hash_table_contains (self->iters, item));
+
+  new_iter = g_sequence_insert_before (iter, g_object_ref (item));
+  g_hash_table_insert (self->iters, item, new_iter);
+
+  return new_iter;
+}
+
+static void
+gn_item_store_remove_iter (GnItemStore   *self,
+                           GSequenceIter *iter)
+{
+  g_assert (GN_IS_ITEM_STORE (self));
+  g_assert (!g_sequence_iter_is_end (iter));
+
+  g_hash_table_remove (self->iters, g_sequence_get (iter));
+  g_sequence_remove (iter);
+}
+
+static gint
+gn_item_store_compare_position (gconstpointer a,
+                                gconstpointer b)
+{
+  guint position_a = *(const guint *)a;
+  guint position_b = *(const guint *)b;
+
+  /* Sort in reverse, so that removing from the end keeps the others valid */
+  if (position_a == position_b)
+    return 0;
+
+  return position_a > position_b ? -1 : 1;
+}
+
+static GType
+gn_item_store_get_item_type (GListModel *model)
+{
+  return GN_TYPE_ITEM;
+}
+
+static guint
+gn_item_store_get_n_items (GListModel *model)
+{
+  GnItemStore *self = (GnItemStore *)model;
+
+  return g_sequence_get_length (self->items);
+}
+
+static gpointer
+gn_item_store_get_item (GListModel *model,
+                        guint       position)
+{
+  GnItemStore *self = (GnItemStore *)model;
+  GSequenceIter *iter = NULL;
+
+  if (self->last_position_valid)
+    {
+      if (position == self->last_position)
+        iter = self->last_iter;
+      else if (position == self->last_position + 1)
+        iter = g_sequence_iter_next (self->last_iter);
+      else if (position + 1 == self->last_position)
+        iter = g_sequence_iter_prev (self->last_iter);
+    }
+
+  if (iter == NULL)
+    iter = g_sequence_get_iter_at_pos (self->items, position);
+
+  if (g_sequence_iter_is_end (iter))
+    return NULL;
+
+  self->last_iter = iter;
+  self->last_position = position;
+  self->last_position_valid = TRUE;
+
+  return g_object_ref (g_sequence_get (iter));
+}
+
+static void
+gn_item_store_list_model_iface_init (GListModelInterface *iface)
+{
+  iface->get_item_type = gn_item_store_get_item_type;
+  iface->get_n_items = gn_item_store_get_n_items;
+  iface->get_item = gn_item_store_get_item;
+}
+
+static void
+gn_item_store_finalize (GObject *object)
+{
+  GnItemStore *self = (GnItemStore *)object;
+
+  GN_ENTRY;
+
+  g_hash_table_unref (self->iters);
+  g_sequence_free (self->items);
+
+  G_OBJECT_CLASS (gn_item_store_parent_class)->finalize (object);
+
+  GN_EXIT;
+}
+
+static void
+gn_item_store_class_init (GnItemStoreClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gn_item_store_finalize;
+}
+
+static void
+gn_item_store_init (GnItemStore *self)
+{
+  self->items = g_sequence_new (g_object_unref);
+  self->iters = g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+/**
+ * gn_item_store_new:
+ *
+ * Create a new empty store of #GnItem.
+ *
+ * Returns: (transfer full): a new #GnItemStore
+ */
+GnItemStore *
+gn_item_store_new (void)
+{
+  return g_object_new (GN_TYPE_ITEM_STORE, NULL);
+}
+
+/**
+ * gn_item_store_append:
+ * @self: A #GnItemStore
+ * @item: A #GnItem not in @self
+ *
+ * Append @item to the end of @self.
+ */
+void
+gn_item_store_append (GnItemStore *self,
+                      GnItem      *item)
+{
+  guint n_items;
+
+  g_return_if_fail (GN_IS_ITEM_STORE (self));
+  g_return_if_fail (GN_IS_ITEM (item));
+  g_return_if_fail (!g_hash_table_contains (self->iters, item));
+
+  n_items = g_sequence_get_length (self->items);
+  gn_item_store_insert_before (self, g_sequence_get_end_iter (self->items), item);
+  gn_item_store_items_changed (self, n_items, 0, 1);
+}
+
+/**
+ * gn_item_store_insert_sorted:
+ * @self: A #GnItemStore
+ * @item: A #GnItem not in @self
+ * @compare_func: A #GCompareDataFunc to compare items
+ * @user_data: user data for @compare_func
+ *
+ * Insert @item to @self at the position given by @compare_func.
+ * @self should already be sorted by @compare_func.
+ *
+ * Returns: The position at which @item was inserted
+ */
+guint
+gn_item_store_insert_sorted (GnItemStore      *self,
+                             GnItem           *item,
+                             GCompareDataFunc  compare_func,
+                             gpointer          user_data)
+{
+  GSequenceIter *iter;
+  guint position;
+
+  g_return_val_if_fail (GN_IS_ITEM_STORE (self), 0);
+  g_return_val_if_fail (GN_IS_ITEM (item), 0);
+  g_return_val_if_fail (compare_func != NULL, 0);
+  g_return_val_if_fail (!g_hash_table_contains (self->iters, item), 0);
+
+  iter = g_sequence_insert_sorted (self->items, g_object_ref (item),
+                                   compare_func, user_data);
+  g_hash_table_insert (self->iters, item, iter);
+  position = g_sequence_iter_get_position (iter);
+  gn_item_store_items_changed (self, position, 0, 1);
+
+  return position;
+}
+
+typedef struct
+{
+  GCompareDataFunc compare_func;
+  gpointer         user_data;
+} SortData;
+
+static gint
+gn_item_store_compare_items (gconstpointer a,
+                             gconstpointer b,
+                             gpointer      user_data)
+{
+  SortData *sort_data = user_data;
+
+  /* @a and @b are pointers to the items in the array */
+  return sort_data->compare_func (*(GnItem **)a, *(GnItem **)b,
+                                  sort_data->user_data);
+}
+
+/**
+ * gn_item_store_insert_sorted_items:
+ * @self: A #GnItemStore
+ * @items: (array length=n_items): An array of #GnItem not in @self
+ * @n_items: The length of @items
+ * @compare_func: A #GCompareDataFunc to compare items
+ * @user_data: user data for @compare_func
+ *
+ * Insert each of @items to @self at the position given by
+ * @compare_func, like gn_item_store_insert_sorted().  Items
+ * that end up next to each other in @self are added with a
+ * single #GListModel::items-changed emission, so restoring
+ * a range of removed items emits the signal only once.
+ *
+ * @items is sorted in place.
+ */
+void
+gn_item_store_insert_sorted_items (GnItemStore      *self,
+                                   GnItem          **items,
+                                   guint             n_items,
+                                   GCompareDataFunc  compare_func,
+                                   gpointer          user_data)
+{
+  SortData sort_data = { compare_func, user_data };
+
+  GN_ENTRY;
+
+  g_return_if_fail (GN_IS_ITEM_STORE (self));
+  g_return_if_fail (items != NULL || n_items == 0);
+  g_return_if_fail (compare_func != NULL);
+
+  g_qsort_with_data (items, n_items, sizeof (GnItem *),
+                     gn_item_store_compare_items, &sort_data);
+
+  for (guint i = 0; i < n_items;)
+    {
+      GSequenceIter *iter;
+      guint position, start = i;
+
+      /* The items sorted before the item after @iter go together */
+      iter = g_sequence_search (self->items, items[i], compare_func, user_data);
+      position = g_sequence_iter_get_position (iter);
+
+      do
+        {
+          gn_item_store_insert_before (self, iter, items[i]);
+          i++;
+        }
+      while (i < n_items &&
+             (g_sequence_iter_is_end (iter) ||
+              compare_func (items[i], g_sequence_get (iter), user_data) < 0));
+
+      gn_item_store_items_changed (self, position, 0, i - start);
+    }
+
+  GN_EXIT;
+}
+
+/**
+ * gn_item_store_remove:
+ * @self: A #GnItemStore
+ * @position: the position of the item to remove
+ *
+ * Remove the item at @position from @self.
+ */
+void
+gn_item_store_remove (GnItemStore *self,
+                      guint        position)
+{
+  GSequenceIter *iter;
+
+  g_return_if_fail (GN_IS_ITEM_STORE (self));
+
+  iter = g_sequence_get_iter_at_pos (self->items, position);
+  g_return_if_fail (!g_sequence_iter_is_end (iter));
+
+  gn_item_store_remove_iter (self, iter);
+  gn_item_store_items_changed (self, position, 1, 0);
+}
+
+/**
+ * gn_item_store_remove_item:
+ * @self: A #GnItemStore
+ * @item: A #GnItem
+ *
+ * Remove @item from @self, if present.
+ *
+ * Returns: %TRUE if @item was found and removed.
+ */
+gboolean
+gn_item_store_remove_item (GnItemStore *self,
+                           GnItem      *item)
+{
+  GSequenceIter *iter;
+  guint position;
+
+  g_return_val_if_fail (GN_IS_ITEM_STORE (self), FALSE);
+  g_return_val_if_fail (GN_IS_ITEM (item), FALSE);
+
+  iter = g_hash_table_lookup (self->iters, item);
+
+  if (iter == NULL)
+    return FALSE;
+
+  position = g_sequence_iter_get_position (iter);
+  gn_item_store_remove_iter (self, iter);
+  gn_item_store_items_changed (self, position, 1, 0);
+
+  return TRUE;
+}
+
+/**
+ * gn_item_store_remove_items:
+ * @self: A #GnItemStore
+ * @items: (array length=n_items): An array of #GnItem
+ * @n_items: The length of @items
+ *
+ * Remove every item in @items that is in @self.  Items
+ * next to each other in @self are removed together, with
+ * a single #GListModel::items-changed emission.
+ *
+ * Returns: The number of items removed
+ */
+guint
+gn_item_store_remove_items (GnItemStore  *self,
+                            GnItem      **items,
+                            guint         n_items)
+{
+  g_autoptr(GArray) positions = NULL;
+  guint n_removed = 0;
+
+  GN_ENTRY;
+
+  g_return_val_if_fail (GN_IS_ITEM_STORE (self), 0);
+  g_return_val_if_fail (items != NULL || n_items == 0, 0);
+
+  positions = g_array_sized_new (FALSE, FALSE, sizeof (guint), n_items);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      GSequenceIter *iter;
+      guint position;
+
+      iter = g_hash_table_lookup (self->iters, items[i]);
+
+      if (iter == NULL)
+        continue;
+
+      position = g_sequence_iter_get_position (iter);
+      g_array_append_val (positions, position);
+    }
+
+  g_array_sort (positions, gn_item_store_compare_position);
+
+  /* Remove each range of adjacent positions, from the end */
+  for (guint i = 0; i < positions->len;)
+    {
+      GSequenceIter *begin, *end;
+      guint last, first;
+
+      last = first = g_array_index (positions, guint, i);
+
+      for (i++; i < positions->len; i++)
+        {
+          guint position = g_array_index (positions, guint, i);
+
+          /* The same item may be given more than once */
+          if (position == first)
+            continue;
+
+          if (position + 1 != first)
+            break;
+
+          first = position;
+        }
+
+      begin = g_sequence_get_iter_at_pos (self->items, first);
+      end = g_sequence_get_iter_at_pos (self->items, last + 1);
+
+      for (GSequenceIter *iter = begin; iter != end; iter = g_sequence_iter_next (iter))
+        g_hash_table_remove (self->iters, g_sequence_get (iter));
+
+      g_sequence_remove_range (begin, end);
+      gn_item_store_items_changed (self, first, last - first + 1, 0);
+      n_removed += last - first + 1;
+    }
+
+  GN_RETURN (n_removed);
+}
+
+/**
+ * gn_item_store_splice:
+ * @self: A #GnItemStore
+ * @position: the position at which to make the change
+ * @n_removals: the number of items to remove
+ * @additions: (array length=n_additions): the #GnItems to add
+ * @n_additions: the number of items to add
+ *
+ * Remove @n_removals items and add @additions at @position,
+ * emitting #GListModel::items-changed only once, like
+ * g_list_store_splice().  None of @additions should be in
+ * @self after the removal.
+ */
+void
+gn_item_store_splice (GnItemStore *self,
+                      guint        position,
+                      guint        n_removals,
+                      gpointer    *additions,
+                      guint        n_additions)
+{
+  GSequenceIter *iter;
+
+  GN_ENTRY;
+
+  g_return_if_fail (GN_IS_ITEM_STORE (self));
+  g_return_if_fail (position + n_removals >= position); /* overflow */
+  g_return_if_fail (position + n_removals <= (guint)g_sequence_get_length (self->items));
+  g_return_if_fail (additions != NULL || n_additions == 0);
+
+  iter = g_sequence_get_iter_at_pos (self->items, position);
+
+  for (guint i = 0; i < n_removals; i++)
+    {
+      GSequenceIter *next = g_sequence_iter_next (iter);
+
+      gn_item_store_remove_iter (self, iter);
+      iter = next;
+    }
+
+  for (guint i = 0; i < n_additions; i++)
+    gn_item_store_insert_before (self, iter, additions[i]);
+
+  gn_item_store_items_changed (self, position, n_removals, n_additions);
+
+  GN_EXIT;
+}
+
+/**
+ * gn_item_store_contains:
+ * @self: A #GnItemStore
+ * @item: A #GnItem
+ *
+ * Check if @item is in @self.  This is an O(1) operation.
+ *
+ * Returns: %TRUE if @item is in @self.
+ */
+gboolean
+gn_item_store_contains (GnItemStore *self,
+                        GnItem      *item)
+{
+  g_return_val_if_fail (GN_IS_ITEM_STORE (self), FALSE);
+
+  return g_hash_table_contains (self->iters, item);
+}
+
+/**
+ * gn_item_store_get_position:
+ * @self: A #GnItemStore
+ * @item: A #GnItem
+ * @position: (out) (optional): A location to store position
+ *
+ * Get the position of @item in @self.  This is an
+ * O(log n) operation.
+ *
+ * Returns: %TRUE if @item was found in @self.
+ */
+gboolean
+gn_item_store_get_position (GnItemStore *self,
+                            GnItem      *item,
+                            guint       *position)
+{
+  GSequenceIter *iter;
+
+  g_return_val_if_fail (GN_IS_ITEM_STORE (self), FALSE);
+
+  iter = g_hash_table_lookup (self->iters, item);
+
+  if (iter == NULL)
+    return FALSE;
+
+  if (position != NULL)
+    *position = g_sequence_iter_get_position (iter);
+
+  return TRUE;
+}
+
+/**
+ * gn_item_store_item_changed:
+ * @self: A #GnItemStore
+ * @item: A #GnItem
+ *
+ * Emit #GListModel::items-changed for @item, if @item
+ * is in @self, so that views of @self can update it.
+ *
+ * Returns: %TRUE if @item was found in @self.
+ */
+gboolean
+gn_item_store_item_changed (GnItemStore *self,
+                            GnItem      *item)
+{
+  guint position;
+
+  g_return_val_if_fail (GN_IS_ITEM_STORE (self), FALSE);
+  g_return_val_if_fail (GN_IS_ITEM (item), FALSE);
+
+  if (!gn_item_store_get_position (self, item, &position))
+    return FALSE;
+
+  gn_item_store_items_changed (self, position, 1, 1);
+
+  return TRUE;
+}
@@ -0,0 +1,67 @@
+/* gn-item-store.h
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "gn-item.h"
+
+G_BEGIN_DECLS
+
+#define GN_TYPE_ITEM_STORE (gn_item_store_get_type ())
+
+G_DECLARE_FINAL_TYPE (GnItemStore, gn_item_store, GN, ITEM_STORE, GObject)
+
+GnItemStore *gn_item_store_new            (void);
+
+void         gn_item_store_append         (GnItemStore      *self,
+                                           GnItem           *item);
+guint        gn_item_store_insert_sorted  (GnItemStore      *self,
+                                           GnItem           *item,
+                                           GCompareDataFunc  compare_func,
+                                           gpointer          user_data);
+void         gn_item_store_insert_sorted_items (GnItemStore      *self,
+                                                GnItem          **items,
+                                                guint             n_items,
+                                                GCompareDataFunc  compare_func,
+                                                gpointer          user_data);
+void         gn_item_store_remove         (GnItemStore      *self,
+                                           guint             position);
+gboolean     gn_item_store_remove_item    (GnItemStore      *self,
+                                           GnItem           *item);
+guint        gn_item_store_remove_items   (GnItemStore      *self,
+                                           GnItem          **items,
+                                           guint             n_items);
+void         gn_item_store_splice         (GnItemStore      *self,
+                                           guint             position,
+                                           guint             n_removals,
+                                           gpointer         *additions,
+                                           guint             n_additions);
+
+gboolean     gn_item_store_contains       (GnItemStore      *self,
+                                           GnItem           *item);
+gboolean     gn_item_store_get_position   (GnItemStore      *self,
+                                           GnItem           *item,
+                                           guint            *position);
+gboolean     gn_item_store_item_changed   (GnItemStore      *self,
+                                           GnItem           *item);
+
+G_END_DECLS
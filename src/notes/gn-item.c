@@ -22,6 +22,7 @@
 
 #include "config.h"
 
+#include "gn-utils.h"
 #include "gn-item.h"
 #include "gn-trace.h"
 
@@ -38,8 +39,12 @@ typedef struct
 {
   gchar *uid;
   gchar *title;
+  /* Collation key of the casefolded title, created on demand */
+  gchar *collate_key;
 
   GdkRGBA *rgba;
+  /* Hue, saturation and lightness of rgba packed to sort, 0 if unset */
+  guint32 color_key;
 
   /* The last modified time of the item */
   gint64 modification_time;
@@ -160,6 +165,7 @@ gn_item_finalize (GObject *object)
 
   g_clear_pointer (&priv->uid, g_free);
   g_clear_pointer (&priv->title, g_free);
+  g_clear_pointer (&priv->collate_key, g_free);
   g_clear_pointer (&priv->rgba, gdk_rgba_free);
 
   G_OBJECT_CLASS (gn_item_parent_class)->finalize (object);
@@ -210,15 +216,9 @@ static gboolean
 gn_item_real_match (GnItem      *self,
                     const gchar *needle)
 {
-  g_autofree gchar *title = NULL;
-
   g_assert (GN_IS_ITEM (self));
 
-  title = g_utf8_casefold (gn_item_get_title (self), -1);
-  if (strstr (title, needle) != NULL)
-    return TRUE;
-
-  return FALSE;
+  return gn_utils_str_casefold_contains (gn_item_get_title (self), -1, needle);
 }
 
 static GnFeature
@@ -435,6 +435,7 @@ gn_item_set_title (GnItem      *self,
 
   g_free (priv->title);
   priv->title = g_strdup (title);
+  g_clear_pointer (&priv->collate_key, g_free);
 
   gn_item_set_modified (self);
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_TITLE]);
@@ -442,6 +443,42 @@ gn_item_set_title (GnItem      *self,
   GN_EXIT;
 }
 
+/*
+ * Pack the hue (0 to 359), saturation and lightness (0 to 255)
+ * of @rgba into an integer, so that similar colors are sorted
+ * together.  1 is added so that 0 is left for no color.
+ */
+static guint32
+gn_item_get_color_key (const GdkRGBA *rgba)
+{
+  gdouble max, min, delta, hue;
+  guint32 saturation, lightness;
+
+  g_assert (rgba != NULL);
+
+  max = MAX (rgba->red, MAX (rgba->green, rgba->blue));
+  min = MIN (rgba->red, MIN (rgba->green, rgba->blue));
+  delta = max - min;
+
+  if (delta <= 0)
+    hue = 0;
+  else if (max == rgba->red)
+    hue = (rgba->green - rgba->blue) / delta;
+  else if (max == rgba->green)
+    hue = (rgba->blue - rgba->red) / delta + 2;
+  else
+    hue = (rgba->red - rgba->green) / delta + 4;
+
+  hue *= 60;
+  if (hue < 0)
+    hue += 360;
+
+  saturation = CLAMP (delta, 0, 1) * 255;
+  lightness = CLAMP ((max + min) / 2, 0, 1) * 255;
+
+  return 1 + ((CLAMP ((guint32)hue, 0, 359) << 16) | (saturation << 8) | lightness);
+}
+
 /**
  * gn_item_get_rgba:
  * @self: a #GnItem
@@ -490,6 +527,7 @@ gn_item_set_rgba (GnItem        *self,
 
   gdk_rgba_free (priv->rgba);
   priv->rgba = gdk_rgba_copy (rgba);
+  priv->color_key = gn_item_get_color_key (rgba);
 
   gn_item_set_modified (self);
   g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_RGBA]);
@@ -623,12 +661,31 @@ gn_item_is_new (GnItem *self)
   return priv->uid == NULL;
 }
 
+static const gchar *
+gn_item_get_collate_key (GnItem *self)
+{
+  GnItemPrivate *priv = gn_item_get_instance_private (self);
+
+  if (priv->collate_key == NULL)
+    {
+      g_autofree gchar *title = NULL;
+
+      title = g_utf8_casefold (gn_item_get_title (self), -1);
+      priv->collate_key = g_utf8_collate_key (title, -1);
+    }
+
+  return priv->collate_key;
+}
+
 /**
  * gn_item_compare:
  * @a: A #GnItem
  * @b: A #GnItem
  *
- * Compare two #GnItem
+ * Compare two #GnItem by their titles, ignoring case, in
+ * the order of the current locale.  The collation key of
+ * the title is kept till the title changes, so that
+ * sorting doesn't allocate for each comparison.
  *
  * Returns: an integer less than, equal to, or greater
  * than 0, if title of @a is <, == or > than title of @b.
@@ -638,18 +695,93 @@ gn_item_compare (gconstpointer a,
                  gconstpointer b,
                  gpointer      user_data)
 {
-  GnItemPrivate *item_a = gn_item_get_instance_private ((GnItem *)a);
-  GnItemPrivate *item_b = gn_item_get_instance_private ((GnItem *)b);
-  g_autofree gchar *title_a = NULL;
-  g_autofree gchar *title_b = NULL;
-
-  if (item_a == item_b)
+  if (a == b)
     return 0;
 
-  title_a = g_utf8_casefold (item_a->title, -1);
-  title_b = g_utf8_casefold (item_b->title, -1);
+  return strcmp (gn_item_get_collate_key ((GnItem *)a),
+                 gn_item_get_collate_key ((GnItem *)b));
+}
+
+/**
+ * gn_item_compare_modification_time:
+ * @a: A #GnItem
+ * @b: A #GnItem
+ *
+ * Compare two #GnItem by their modification time, the
+ * most recently modified first.  Items modified at the
+ * same time are compared with gn_item_compare().
+ *
+ * Returns: an integer less than, equal to, or greater
+ * than 0, if @a is to be sorted before, with or after @b.
+ */
+gint
+gn_item_compare_modification_time (gconstpointer a,
+                                   gconstpointer b,
+                                   gpointer      user_data)
+{
+  GnItemPrivate *priv_a = gn_item_get_instance_private ((GnItem *)a);
+  GnItemPrivate *priv_b = gn_item_get_instance_private ((GnItem *)b);
+
+  if (priv_a->modification_time != priv_b->modification_time)
+    return priv_a->modification_time > priv_b->modification_time ? -1 : 1;
+
+  return gn_item_compare (a, b, user_data);
+}
+
+/**
+ * gn_item_compare_creation_time:
+ * @a: A #GnItem
+ * @b: A #GnItem
+ *
+ * Compare two #GnItem by their creation time, the most
+ * recently created first.  Items created at the same
+ * time are compared with gn_item_compare().
+ *
+ * Returns: an integer less than, equal to, or greater
+ * than 0, if @a is to be sorted before, with or after @b.
+ */
+gint
+gn_item_compare_creation_time (gconstpointer a,
+                               gconstpointer b,
+                               gpointer      user_data)
+{
+  GnItemPrivate *priv_a = gn_item_get_instance_private ((GnItem *)a);
+  GnItemPrivate *priv_b = gn_item_get_instance_private ((GnItem *)b);
+
+  if (priv_a->creation_time != priv_b->creation_time)
+    return priv_a->creation_time > priv_b->creation_time ? -1 : 1;
+
+  return gn_item_compare (a, b, user_data);
+}
+
+/**
+ * gn_item_compare_color:
+ * @a: A #GnItem
+ * @b: A #GnItem
+ *
+ * Compare two #GnItem by their color, so that items of
+ * similar colors are together.  Items without a color
+ * are sorted last, and items of the same color are
+ * compared with gn_item_compare().
+ *
+ * Returns: an integer less than, equal to, or greater
+ * than 0, if @a is to be sorted before, with or after @b.
+ */
+gint
+gn_item_compare_color (gconstpointer a,
+                       gconstpointer b,
+                       gpointer      user_data)
+{
+  GnItemPrivate *priv_a = gn_item_get_instance_private ((GnItem *)a);
+  GnItemPrivate *priv_b = gn_item_get_instance_private ((GnItem *)b);
+
+  if (priv_a->color_key != priv_b->color_key)
+    {
+      /* Subtract 1 so that no color (0) wraps around to be the last */
+      return priv_a->color_key - 1 < priv_b->color_key - 1 ? -1 : 1;
+    }
 
-  return g_strcmp0 (title_a, title_b);
+  return gn_item_compare (a, b, user_data);
 }
 
 gboolean
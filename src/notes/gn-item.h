@@ -67,6 +67,15 @@ gboolean     gn_item_is_new                (GnItem        *self);
 gint         gn_item_compare               (gconstpointer a,
                                             gconstpointer b,
                                             gpointer      user_data);;
+gint         gn_item_compare_modification_time (gconstpointer a,
+                                                gconstpointer b,
+                                                gpointer      user_data);
+gint         gn_item_compare_creation_time (gconstpointer a,
+                                            gconstpointer b,
+                                            gpointer      user_data);
+gint         gn_item_compare_color         (gconstpointer a,
+                                            gconstpointer b,
+                                            gpointer      user_data);
 gboolean     gn_item_match                 (GnItem       *self,
                                             const gchar  *needle);
 GnFeature    gn_item_get_features          (GnItem       *self);
@@ -46,8 +46,20 @@ struct _GnNoteBuffer
   GtkTextTag *tag_strike;
 
   gint freeze_count;
+
+  /*
+   * Lines at the start and at the end of the buffer that are not
+   * changed since the last call to gn_note_buffer_reset_changes().
+   * The lines in between may have changed.
+   */
+  guint n_unchanged_head;
+  guint n_unchanged_tail;
+  guint changes_serial;
 };
 
+/* Serials of gn_note_buffer_reset_changes(), unique among all buffers */
+static guint last_changes_serial;
+
 G_DEFINE_TYPE (GnNoteBuffer, gn_note_buffer, GTK_TYPE_TEXT_BUFFER)
 
 static void
@@ -101,6 +113,34 @@ gn_note_buffer_toggle_tag (GnNoteBuffer *buffer,
   gtk_text_buffer_set_modified (GTK_TEXT_BUFFER (buffer), TRUE);
 }
 
+static gboolean
+gn_note_buffer_is_format_tag (GnNoteBuffer *self,
+                              GtkTextTag   *tag)
+{
+  return tag == self->tag_bold || tag == self->tag_italic ||
+    tag == self->tag_underline || tag == self->tag_strike;
+}
+
+/*
+ * Mark the lines from @first_line till @last_line as changed.
+ * The line numbers are those after the change is done.
+ */
+static void
+gn_note_buffer_mark_lines_changed (GnNoteBuffer *self,
+                                   gint          first_line,
+                                   gint          last_line)
+{
+  gint n_lines;
+
+  g_assert (GN_IS_NOTE_BUFFER (self));
+  g_assert (first_line <= last_line);
+
+  n_lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (self));
+  self->n_unchanged_head = MIN (self->n_unchanged_head, (guint)first_line);
+  self->n_unchanged_tail = MIN (self->n_unchanged_tail,
+                                (guint)(n_lines - 1 - last_line));
+}
+
 static void
 gn_note_buffer_insert_text (GtkTextBuffer *buffer,
                               GtkTextIter   *pos,
@@ -111,6 +151,7 @@ gn_note_buffer_insert_text (GtkTextBuffer *buffer,
   GtkTextIter end, start;
   gint start_offset = G_MAXINT;
   gboolean is_title = FALSE, is_buffer_end = FALSE;
+  gint first_line;
 
   /*
    * TODO: Pasting title to content area may keep the boldness property,
@@ -119,6 +160,8 @@ gn_note_buffer_insert_text (GtkTextBuffer *buffer,
 
   GN_ENTRY;
 
+  first_line = gtk_text_iter_get_line (pos);
+
   if (self->freeze_count == 0)
     {
       is_title = gtk_text_iter_get_line (pos) == 0;
@@ -137,6 +180,10 @@ gn_note_buffer_insert_text (GtkTextBuffer *buffer,
                                                                       text,
                                                                       text_len);
 
+  /* @pos now points to the end of the inserted text */
+  gn_note_buffer_mark_lines_changed (self, first_line,
+                                     gtk_text_iter_get_line (pos));
+
   if (self->freeze_count != 0)
     GN_EXIT;
 
@@ -166,6 +213,11 @@ gn_note_buffer_delete_range (GtkTextBuffer *buffer,
 
   GTK_TEXT_BUFFER_CLASS (gn_note_buffer_parent_class)->delete_range (buffer, start, end);
 
+  /* Both @start and @end now point to where the text was removed */
+  gn_note_buffer_mark_lines_changed ((GnNoteBuffer *)buffer,
+                                     gtk_text_iter_get_line (start),
+                                     gtk_text_iter_get_line (start));
+
   if (gtk_text_iter_get_line (start) == 0)
     {
       gtk_text_buffer_get_start_iter (buffer, &start_iter);
@@ -186,12 +238,13 @@ gn_note_buffer_real_apply_tag (GtkTextBuffer     *buffer,
   GTK_TEXT_BUFFER_CLASS (gn_note_buffer_parent_class)->apply_tag (buffer, tag,
                                                                   start, end);
 
+  if (gn_note_buffer_is_format_tag (self, tag))
+    gn_note_buffer_mark_lines_changed (self, gtk_text_iter_get_line (start),
+                                       gtk_text_iter_get_line (end));
+
   /* We don't need anything other this tag handled by text-view undo */
   if (self->freeze_count > 0 ||
-      (tag != self->tag_bold &&
-       tag != self->tag_italic &&
-       tag != self->tag_underline &&
-       tag != self->tag_strike))
+      !gn_note_buffer_is_format_tag (self, tag))
     g_signal_stop_emission_by_name (buffer, "apply-tag");
 }
 
@@ -206,12 +259,13 @@ gn_note_buffer_real_remove_tag (GtkTextBuffer     *buffer,
   GTK_TEXT_BUFFER_CLASS (gn_note_buffer_parent_class)->remove_tag (buffer, tag,
                                                                    start, end);
 
+  if (gn_note_buffer_is_format_tag (self, tag))
+    gn_note_buffer_mark_lines_changed (self, gtk_text_iter_get_line (start),
+                                       gtk_text_iter_get_line (end));
+
   /* We don't need anything other this tag handled by text-view undo */
   if (self->freeze_count > 0 ||
-      (tag != self->tag_bold &&
-       tag != self->tag_italic &&
-       tag != self->tag_underline &&
-       tag != self->tag_strike))
+      !gn_note_buffer_is_format_tag (self, tag))
     g_signal_stop_emission_by_name (buffer, "remove-tag");
 
 }
@@ -385,3 +439,87 @@ gn_note_buffer_thaw (GnNoteBuffer *self)
 
   self->freeze_count--;
 }
+
+/**
+ * gn_note_buffer_reset_changes:
+ * @self: A #GnNoteBuffer
+ *
+ * Forget the lines changed so far, and start tracking
+ * changes from now.  This should be called when the content
+ * of @self is saved, so that the next save can handle only
+ * the lines changed in between.
+ *
+ * Returns: A serial to be passed to gn_note_buffer_get_changed_lines().
+ * The serial is never 0, and is unique among all buffers.
+ */
+guint
+gn_note_buffer_reset_changes (GnNoteBuffer *self)
+{
+  g_return_val_if_fail (GN_IS_NOTE_BUFFER (self), 0);
+
+  self->n_unchanged_head = G_MAXUINT;
+  self->n_unchanged_tail = G_MAXUINT;
+
+  if (++last_changes_serial == 0)
+    last_changes_serial++;
+  self->changes_serial = last_changes_serial;
+
+  return self->changes_serial;
+}
+
+/**
+ * gn_note_buffer_get_changes_serial:
+ * @self: A #GnNoteBuffer
+ *
+ * Get the serial returned by the last call to
+ * gn_note_buffer_reset_changes().
+ *
+ * Returns: The serial, or 0 if changes were never reset
+ */
+guint
+gn_note_buffer_get_changes_serial (GnNoteBuffer *self)
+{
+  g_return_val_if_fail (GN_IS_NOTE_BUFFER (self), 0);
+
+  return self->changes_serial;
+}
+
+/**
+ * gn_note_buffer_get_changed_lines:
+ * @self: A #GnNoteBuffer
+ * @serial: The serial from gn_note_buffer_reset_changes()
+ * @n_unchanged_head: (out): return location for the number of lines
+ *   not changed at the start of @self
+ * @n_unchanged_tail: (out): return location for the number of lines
+ *   not changed at the end of @self
+ *
+ * Get the lines changed since gn_note_buffer_reset_changes()
+ * returned @serial.  The lines that may have changed are those after
+ * the first @n_unchanged_head lines, and before the last
+ * @n_unchanged_tail lines.
+ *
+ * Returns: %FALSE if changes since @serial are no more tracked,
+ * and so the whole buffer should be considered changed.  %TRUE
+ * otherwise.
+ */
+gboolean
+gn_note_buffer_get_changed_lines (GnNoteBuffer *self,
+                                  guint         serial,
+                                  guint        *n_unchanged_head,
+                                  guint        *n_unchanged_tail)
+{
+  guint n_lines;
+
+  g_return_val_if_fail (GN_IS_NOTE_BUFFER (self), FALSE);
+  g_return_val_if_fail (n_unchanged_head != NULL, FALSE);
+  g_return_val_if_fail (n_unchanged_tail != NULL, FALSE);
+
+  if (serial == 0 || serial != self->changes_serial)
+    return FALSE;
+
+  n_lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (self));
+  *n_unchanged_head = MIN (self->n_unchanged_head, n_lines);
+  *n_unchanged_tail = MIN (self->n_unchanged_tail, n_lines - *n_unchanged_head);
+
+  return TRUE;
+}
@@ -36,5 +36,11 @@ const gchar  *gn_note_buffer_get_name_for_tag (GnNoteBuffer *self,
                                                GtkTextTag   *tag);
 void          gn_note_buffer_freeze           (GnNoteBuffer *self);
 void          gn_note_buffer_thaw             (GnNoteBuffer *self);
+guint         gn_note_buffer_reset_changes    (GnNoteBuffer *self);
+guint         gn_note_buffer_get_changes_serial (GnNoteBuffer *self);
+gboolean      gn_note_buffer_get_changed_lines (GnNoteBuffer *self,
+                                                guint         serial,
+                                                guint        *n_unchanged_head,
+                                                guint        *n_unchanged_tail);
 
 G_END_DECLS
@@ -0,0 +1,361 @@
+/* gn-note-snapshot.c
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "gn-note-snapshot"
+
+#include "config.h"
+
+#include <string.h>
+
+#include "gn-note-buffer.h"
+#include "gn-note-snapshot.h"
+#include "gn-trace.h"
+
+/**
+ * SECTION: gn-note-snapshot
+ * @title: GnNoteSnapshot
+ * @short_description: An immutable copy of a note buffer
+ * @include: "gn-note-snapshot.h"
+ *
+ * A #GnNoteSnapshot is the content of a #GtkTextBuffer at some
+ * point: the title, the text after the title, and the formatting
+ * tags applied on the text as a list of runs.  A snapshot is
+ * cheap to create, and never changes once created.  So it can be
+ * serialized in a thread while the buffer is being edited.
+ */
+
+/* Names of tags in #GnNoteBuffer, in the order of #GnTextTag */
+static const gchar *tag_names[GN_N_TEXT_TAGS] = { "b", "i", "s", "u" };
+
+struct _GnNoteSnapshot
+{
+  gint       ref_count;
+
+  gchar     *title;
+  gchar     *text;      /* Content after the title line */
+  gsize      length;
+  GArray    *runs;      /* of GnTextRun */
+  guint      n_lines;
+
+  /* Lines changed since the snapshot with serial @base_serial */
+  guint      base_serial;
+  guint      serial;
+  guint      n_unchanged_head;
+  guint      n_unchanged_tail;
+};
+
+static guint
+gn_note_snapshot_get_tags (const GtkTextIter *iter,
+                           GtkTextTag       **tags)
+{
+  guint mask = 0;
+
+  for (guint i = 0; i < GN_N_TEXT_TAGS; i++)
+    if (tags[i] != NULL && gtk_text_iter_has_tag (iter, tags[i]))
+      mask |= 1 << i;
+
+  return mask;
+}
+
+/*
+ * Find the runs of @text, which is the text of @buffer from
+ * @start till the end.  Each run covers the text till its end
+ * (from the end of the previous run) on which the same set of
+ * tags are applied.
+ */
+static void
+gn_note_snapshot_update_runs (GnNoteSnapshot    *self,
+                              GtkTextBuffer     *buffer,
+                              const GtkTextIter *start)
+{
+  GtkTextTagTable *tag_table;
+  GtkTextTag *tags[GN_N_TEXT_TAGS];
+  GtkTextIter iter;
+  const gchar *pos;
+  GnTextRun run;
+  gint offset;
+
+  g_assert (self != NULL);
+  g_assert (GTK_IS_TEXT_BUFFER (buffer));
+  g_assert (start != NULL);
+
+  tag_table = gtk_text_buffer_get_tag_table (buffer);
+  for (guint i = 0; i < GN_N_TEXT_TAGS; i++)
+    tags[i] = gtk_text_tag_table_lookup (tag_table, tag_names[i]);
+
+  iter = *start;
+  offset = gtk_text_iter_get_offset (&iter);
+  pos = self->text;
+  run.tags = gn_note_snapshot_get_tags (&iter, tags);
+
+  while (gtk_text_iter_forward_to_tag_toggle (&iter, NULL))
+    {
+      guint mask;
+      gint new_offset;
+
+      mask = gn_note_snapshot_get_tags (&iter, tags);
+
+      /* Toggle of some other tag, or a tag we don't save */
+      if (mask == run.tags)
+        continue;
+
+      new_offset = gtk_text_iter_get_offset (&iter);
+      pos = g_utf8_offset_to_pointer (pos, new_offset - offset);
+      offset = new_offset;
+
+      run.end = pos - self->text;
+      g_array_append_val (self->runs, run);
+      run.tags = mask;
+    }
+
+  run.end = self->length;
+
+  if (self->runs->len == 0 ||
+      g_array_index (self->runs, GnTextRun, self->runs->len - 1).end < run.end)
+    g_array_append_val (self->runs, run);
+}
+
+/**
+ * gn_note_snapshot_new:
+ * @buffer: A #GtkTextBuffer
+ *
+ * Create a snapshot of the current content of @buffer.
+ *
+ * If @buffer is a #GnNoteBuffer, the lines changed since the
+ * last snapshot of @buffer are tracked, see
+ * gn_note_snapshot_get_changed_lines().
+ *
+ * Returns: (transfer full): A new #GnNoteSnapshot.
+ * Free with gn_note_snapshot_unref()
+ */
+GnNoteSnapshot *
+gn_note_snapshot_new (GtkTextBuffer *buffer)
+{
+  GnNoteSnapshot *self;
+  GtkTextIter start, end;
+
+  GN_ENTRY;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), NULL);
+
+  self = g_new0 (GnNoteSnapshot, 1);
+  self->ref_count = 1;
+  self->runs = g_array_new (FALSE, FALSE, sizeof (GnTextRun));
+
+  gtk_text_buffer_get_start_iter (buffer, &start);
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &end, 0, G_MAXINT);
+  self->title = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+
+  /* Every line except the title */
+  self->n_lines = gtk_text_buffer_get_line_count (buffer) - 1;
+
+  if (self->n_lines > 0)
+    {
+      gtk_text_buffer_get_iter_at_line (buffer, &start, 1);
+      gtk_text_buffer_get_end_iter (buffer, &end);
+      self->text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+      self->length = strlen (self->text);
+      gn_note_snapshot_update_runs (self, buffer, &start);
+    }
+  else
+    {
+      self->text = g_strdup ("");
+      gn_note_snapshot_update_runs (self, buffer, &end);
+    }
+
+  if (GN_IS_NOTE_BUFFER (buffer))
+    {
+      GnNoteBuffer *note_buffer = GN_NOTE_BUFFER (buffer);
+      guint n_head, n_tail;
+
+      self->base_serial = gn_note_buffer_get_changes_serial (note_buffer);
+
+      if (gn_note_buffer_get_changed_lines (note_buffer, self->base_serial,
+                                            &n_head, &n_tail))
+        {
+          /* Don't count the title line */
+          self->n_unchanged_head = MAX (n_head, 1) - 1;
+          self->n_unchanged_tail = MIN (n_tail, self->n_lines);
+        }
+      else
+        {
+          self->base_serial = 0;
+        }
+
+      self->serial = gn_note_buffer_reset_changes (note_buffer);
+    }
+
+  GN_RETURN (self);
+}
+
+GnNoteSnapshot *
+gn_note_snapshot_ref (GnNoteSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (self->ref_count > 0, NULL);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+gn_note_snapshot_unref (GnNoteSnapshot *self)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->ref_count > 0);
+
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
+  g_free (self->title);
+  g_free (self->text);
+  g_array_unref (self->runs);
+  g_free (self);
+}
+
+/**
+ * gn_note_snapshot_get_title:
+ * @self: A #GnNoteSnapshot
+ *
+ * Get the title, which is the first line of the buffer.
+ *
+ * Returns: (transfer none): The title of the note
+ */
+const gchar *
+gn_note_snapshot_get_title (GnNoteSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  return self->title;
+}
+
+/**
+ * gn_note_snapshot_get_text:
+ * @self: A #GnNoteSnapshot
+ * @length: (out) (optional): return location for the length in bytes
+ *
+ * Get the text after the title line.
+ *
+ * Returns: (transfer none): The content of the note
+ */
+const gchar *
+gn_note_snapshot_get_text (GnNoteSnapshot *self,
+                           gsize          *length)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  if (length != NULL)
+    *length = self->length;
+
+  return self->text;
+}
+
+/**
+ * gn_note_snapshot_get_runs:
+ * @self: A #GnNoteSnapshot
+ * @n_runs: (out): return location for the number of runs
+ *
+ * Get the runs of the text returned by gn_note_snapshot_get_text().
+ * The runs are sorted, and cover the whole text.  There is always
+ * at least one run, which may be empty.
+ *
+ * Returns: (transfer none): An array of #GnTextRun
+ */
+const GnTextRun *
+gn_note_snapshot_get_runs (GnNoteSnapshot *self,
+                           guint          *n_runs)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (n_runs != NULL, NULL);
+
+  *n_runs = self->runs->len;
+
+  return (const GnTextRun *)self->runs->data;
+}
+
+/**
+ * gn_note_snapshot_get_n_lines:
+ * @self: A #GnNoteSnapshot
+ *
+ * Get the number of lines in the text after the title.
+ *
+ * Returns: The number of lines
+ */
+guint
+gn_note_snapshot_get_n_lines (GnNoteSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->n_lines;
+}
+
+/**
+ * gn_note_snapshot_get_serial:
+ * @self: A #GnNoteSnapshot
+ *
+ * Get the serial of @self, to be used with
+ * gn_note_snapshot_get_changed_lines() on a later snapshot
+ * of the same buffer.
+ *
+ * Returns: The serial, or 0 if changes are not tracked
+ */
+guint
+gn_note_snapshot_get_serial (GnNoteSnapshot *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->serial;
+}
+
+/**
+ * gn_note_snapshot_get_changed_lines:
+ * @self: A #GnNoteSnapshot
+ * @serial: The serial of an older snapshot
+ * @n_unchanged_head: (out): return location for the number of lines
+ *   not changed at the start of the text
+ * @n_unchanged_tail: (out): return location for the number of lines
+ *   not changed at the end of the text
+ *
+ * Get the lines of the text (not counting the title line) that
+ * have changed since the snapshot with @serial was created.
+ *
+ * Returns: %TRUE if the snapshot with @serial was the last one
+ * created from the buffer.  %FALSE otherwise, and the whole text
+ * should be considered changed.
+ */
+gboolean
+gn_note_snapshot_get_changed_lines (GnNoteSnapshot *self,
+                                    guint           serial,
+                                    guint          *n_unchanged_head,
+                                    guint          *n_unchanged_tail)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (n_unchanged_head != NULL, FALSE);
+  g_return_val_if_fail (n_unchanged_tail != NULL, FALSE);
+
+  if (serial == 0 || serial != self->base_serial)
+    return FALSE;
+
+  *n_unchanged_head = self->n_unchanged_head;
+  *n_unchanged_tail = self->n_unchanged_tail;
+
+  return TRUE;
+}
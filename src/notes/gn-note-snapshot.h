@@ -0,0 +1,67 @@
+/* gn-note-snapshot.h
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+ * The formatting tags saved with a note, in the order
+ * of their priority in #GnNoteBuffer.
+ */
+typedef enum
+{
+  GN_TEXT_TAG_BOLD      = 1 << 0,
+  GN_TEXT_TAG_ITALIC    = 1 << 1,
+  GN_TEXT_TAG_STRIKE    = 1 << 2,
+  GN_TEXT_TAG_UNDERLINE = 1 << 3,
+} GnTextTag;
+
+#define GN_N_TEXT_TAGS 4
+
+typedef struct
+{
+  guint end;    /* Offset in bytes, where the run ends */
+  guint tags;   /* #GnTextTag flags */
+} GnTextRun;
+
+typedef struct _GnNoteSnapshot GnNoteSnapshot;
+
+GnNoteSnapshot  *gn_note_snapshot_new          (GtkTextBuffer  *buffer);
+GnNoteSnapshot  *gn_note_snapshot_ref          (GnNoteSnapshot *self);
+void             gn_note_snapshot_unref        (GnNoteSnapshot *self);
+
+const gchar     *gn_note_snapshot_get_title    (GnNoteSnapshot *self);
+const gchar     *gn_note_snapshot_get_text     (GnNoteSnapshot *self,
+                                                gsize          *length);
+const GnTextRun *gn_note_snapshot_get_runs     (GnNoteSnapshot *self,
+                                                guint          *n_runs);
+guint            gn_note_snapshot_get_n_lines  (GnNoteSnapshot *self);
+guint            gn_note_snapshot_get_serial   (GnNoteSnapshot *self);
+gboolean         gn_note_snapshot_get_changed_lines (GnNoteSnapshot *self,
+                                                     guint           serial,
+                                                     guint          *n_unchanged_head,
+                                                     guint          *n_unchanged_tail);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GnNoteSnapshot, gn_note_snapshot_unref)
+
+G_END_DECLS
@@ -105,12 +105,85 @@ gn_note_real_set_content_to_buffer (GnNote       *self,
   gtk_text_buffer_set_modified (GTK_TEXT_BUFFER (buffer), FALSE);
 }
 
+static void
+gn_note_real_set_content_from_buffer (GnNote        *self,
+                                      GtkTextBuffer *buffer)
+{
+  g_autoptr(GnNoteSnapshot) snapshot = NULL;
+  gpointer serialized;
+
+  g_assert (GN_IS_NOTE (self));
+
+  snapshot = gn_note_snapshot_new (buffer);
+  serialized = GN_NOTE_GET_CLASS (self)->serialize_snapshot (self, snapshot);
+  GN_NOTE_GET_CLASS (self)->apply_snapshot (self, snapshot, serialized);
+}
+
 static const gchar *
 gn_note_real_get_extension (GnNote *self)
 {
   return ".txt";
 }
 
+static gpointer
+gn_note_real_serialize_snapshot (GnNote         *self,
+                                 GnNoteSnapshot *snapshot)
+{
+  return g_strdup (gn_note_snapshot_get_text (snapshot, NULL));
+}
+
+static void
+gn_note_real_apply_snapshot (GnNote         *self,
+                             GnNoteSnapshot *snapshot,
+                             gpointer        serialized)
+{
+  g_autofree gchar *content = serialized;
+
+  g_assert (GN_IS_NOTE (self));
+
+  gn_item_set_title (GN_ITEM (self), gn_note_snapshot_get_title (snapshot));
+  gn_note_set_text_content (self, content);
+}
+
+static void
+gn_note_serialize_snapshot_thread (GTask        *task,
+                                   gpointer      source_object,
+                                   gpointer      task_data,
+                                   GCancellable *cancellable)
+{
+  GnNote *self = source_object;
+  GnNoteSnapshot *snapshot = task_data;
+  gpointer serialized;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (GN_IS_NOTE (self));
+  g_assert (snapshot != NULL);
+
+  serialized = GN_NOTE_GET_CLASS (self)->serialize_snapshot (self, snapshot);
+  g_task_return_pointer (task, serialized, NULL);
+}
+
+static void
+gn_note_serialize_snapshot_cb (GObject      *object,
+                               GAsyncResult *result,
+                               gpointer      user_data)
+{
+  GnNote *self = (GnNote *)object;
+  g_autoptr(GTask) task = user_data;
+  GnNoteSnapshot *snapshot;
+  gpointer serialized;
+
+  g_assert (GN_IS_NOTE (self));
+  g_assert (G_IS_TASK (result));
+  g_assert (G_IS_TASK (task));
+
+  snapshot = g_task_get_task_data (task);
+  serialized = g_task_propagate_pointer (G_TASK (result), NULL);
+  GN_NOTE_GET_CLASS (self)->apply_snapshot (self, snapshot, serialized);
+
+  g_task_return_boolean (task, TRUE);
+}
+
 static void
 gn_note_class_init (GnNoteClass *klass)
 {
@@ -120,7 +193,10 @@ gn_note_class_init (GnNoteClass *klass)
 
   klass->get_tags = gn_note_real_get_tags;
   klass->set_content_to_buffer = gn_note_real_set_content_to_buffer;
+  klass->set_content_from_buffer = gn_note_real_set_content_from_buffer;
   klass->get_extension = gn_note_real_get_extension;
+  klass->serialize_snapshot = gn_note_real_serialize_snapshot;
+  klass->apply_snapshot = gn_note_real_apply_snapshot;
 
   /**
    * GnNote:content:
@@ -339,3 +415,72 @@ gn_note_get_extension (GnNote *self)
 
   GN_RETURN (extension);
 }
+
+/**
+ * gn_note_set_content_from_snapshot_async:
+ * @self: a #GnNote
+ * @snapshot: a #GnNoteSnapshot
+ * @cancellable: (nullable): a #GCancellable
+ * @callback: a #GAsyncReadyCallback, or %NULL
+ * @user_data: closure data for @callback
+ *
+ * Set the content of the note from @snapshot.  The content is
+ * serialized in a thread, and is set to @self in the main thread
+ * before @callback is run.
+ *
+ * Once started, the content is always set, even if @cancellable
+ * is cancelled in between.  Only one operation should be run at a
+ * time for @self, so that the content is set in order.
+ */
+void
+gn_note_set_content_from_snapshot_async (GnNote              *self,
+                                         GnNoteSnapshot      *snapshot,
+                                         GCancellable        *cancellable,
+                                         GAsyncReadyCallback  callback,
+                                         gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GTask) serialize_task = NULL;
+
+  GN_ENTRY;
+
+  g_return_if_fail (GN_IS_NOTE (self));
+  g_return_if_fail (snapshot != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gn_note_set_content_from_snapshot_async);
+  g_task_set_task_data (task, gn_note_snapshot_ref (snapshot),
+                        (GDestroyNotify)gn_note_snapshot_unref);
+
+  serialize_task = g_task_new (self, NULL, gn_note_serialize_snapshot_cb,
+                               g_steal_pointer (&task));
+  g_task_set_task_data (serialize_task, gn_note_snapshot_ref (snapshot),
+                        (GDestroyNotify)gn_note_snapshot_unref);
+  g_task_run_in_thread (serialize_task, gn_note_serialize_snapshot_thread);
+
+  GN_EXIT;
+}
+
+/**
+ * gn_note_set_content_from_snapshot_finish:
+ * @self: a #GnNote
+ * @result: a #GAsyncResult provided to callback
+ * @error: a location for #GError or %NULL
+ *
+ * Completes an asynchronous request started with
+ * gn_note_set_content_from_snapshot_async().
+ *
+ * Returns: %TRUE if the content was set. %FALSE otherwise
+ */
+gboolean
+gn_note_set_content_from_snapshot_finish (GnNote        *self,
+                                          GAsyncResult  *result,
+                                          GError       **error)
+{
+  g_return_val_if_fail (GN_IS_NOTE (self), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+  g_return_val_if_fail (!error || !*error, FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
@@ -24,6 +24,7 @@
 
 #include "gn-item.h"
 #include "gn-note-buffer.h"
+#include "gn-note-snapshot.h"
 
 G_BEGIN_DECLS
 
@@ -49,6 +50,12 @@ struct _GnNoteClass
   void   (*set_content_to_buffer)   (GnNote        *self,
                                      GnNoteBuffer  *buffer);
   const gchar   *(*get_extension)   (GnNote        *self);
+
+  gpointer (*serialize_snapshot)    (GnNote         *self,
+                                     GnNoteSnapshot *snapshot);
+  void     (*apply_snapshot)        (GnNote         *self,
+                                     GnNoteSnapshot *snapshot,
+                                     gpointer        serialized);
 };
 
 gchar *gn_note_get_text_content        (GnNote        *self);
@@ -65,4 +72,13 @@ void   gn_note_set_content_to_buffer   (GnNote        *self,
                                         GnNoteBuffer  *buffer);
 const gchar   *gn_note_get_extension   (GnNote        *self);
 
+void     gn_note_set_content_from_snapshot_async  (GnNote              *self,
+                                                   GnNoteSnapshot      *snapshot,
+                                                   GCancellable        *cancellable,
+                                                   GAsyncReadyCallback  callback,
+                                                   gpointer             user_data);
+gboolean gn_note_set_content_from_snapshot_finish (GnNote              *self,
+                                                   GAsyncResult        *result,
+                                                   GError             **error);
+
 G_END_DECLS
@@ -24,6 +24,7 @@
 
 #include <gtk/gtk.h>
 
+#include "gn-utils.h"
 #include "gn-plain-note.h"
 #include "gn-trace.h"
 
@@ -144,20 +145,14 @@ gn_plain_note_match (GnItem      *item,
                      const gchar *needle)
 {
   GnPlainNote *self = GN_PLAIN_NOTE (item);
-  g_autofree gchar *content = NULL;
   gboolean match;
 
   match = GN_ITEM_CLASS (gn_plain_note_parent_class)->match (item, needle);
 
-  if (match)
-    return TRUE;
-
-  content = g_utf8_casefold (self->content, -1);
-
-  if (strstr (content, needle) != NULL)
-    return TRUE;
+  if (match || self->content == NULL)
+    return match;
 
-  return FALSE;
+  return gn_utils_str_casefold_contains (self->content, -1, needle);
 }
 
 static void
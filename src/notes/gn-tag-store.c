@@ -37,6 +37,8 @@
 struct _GnTagStore
 {
   GListStore *store;
+  /* Notes may be parsed from several threads at once */
+  GMutex      mutex;
 };
 
 /* Tag */
@@ -93,6 +95,7 @@ gn_tag_store_new (void)
 
   self = g_slice_new (GnTagStore);
   self->store = g_list_store_new (GN_TYPE_TAG);
+  g_mutex_init (&self->mutex);
 
   return self;
 }
@@ -109,6 +112,7 @@ gn_tag_store_free (GnTagStore *self)
   g_return_if_fail (self != NULL);
 
   g_object_unref (self->store);
+  g_mutex_clear (&self->mutex);
   g_slice_free (GnTagStore, self);
 }
 
@@ -135,6 +139,7 @@ gn_tag_store_get_model (GnTagStore *self)
  * @rgba: (nullable): A #GdkRGBA
  *
  * Insert A tag with name @name and color @rgba.
+ * This can be called from any thread.
  *
  * Returns: (transfer none): The @GnTag with name @name.
  */
@@ -143,6 +148,7 @@ gn_tag_store_insert (GnTagStore  *self,
                      const gchar *name,
                      GdkRGBA     *rgba)
 {
+  g_autoptr(GMutexLocker) locker = NULL;
   GnTag *tag;
   g_autofree gchar *casefold = NULL;
   const gchar *str_intern;
@@ -154,6 +160,7 @@ gn_tag_store_insert (GnTagStore  *self,
 
   casefold = g_utf8_casefold (name, -1);
   str_intern = g_intern_string (casefold);
+  locker = g_mutex_locker_new (&self->mutex);
 
   if (gn_tag_store_find (self, str_intern, &position))
     return g_list_model_get_item (G_LIST_MODEL (self->store), position);
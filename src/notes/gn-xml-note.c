@@ -56,6 +56,25 @@
  * So far the only missing feature in Tomboy XML: numbered lists
  */
 
+/*
+ * Notes created with gn_xml_note_new_from_file() are lazy: only the
+ * metadata is loaded at first, and the content is loaded from the file
+ * when it’s first required.  The loaded contents of unmodified lazy
+ * notes are kept in an LRU list, and the least recently used contents
+ * are dropped when the total size of them exceeds the limit below.
+ * The content is loaded again from the file, if required.
+ *
+ * As the content of a note may be dropped from any thread that loads
+ * the content of another note, the content fields are guarded by the
+ * content lock of the note.  Contents in use are never dropped.
+ */
+#define MAX_LOADED_CONTENT_SIZE (16 * 1024 * 1024)
+/* Size of chunks to read from the file when looking for note header */
+#define HEADER_CHUNK_SIZE 4096
+
+/* Notes with more tags than this are parsed with the XML reader */
+#define MAX_HEADER_TAGS 64
+
 #define COMMON_XML_HEAD "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
 #define BIJIBEN_XML_NS "http://projects.gnome.org/bijiben"
 #define TOMBOY_XML_NS  "http://beatniksoftware.com/tomboy"
@@ -71,24 +90,79 @@ typedef enum
   N_NOTE_FORMATS
 } NoteFormat;
 
+/* A string in a buffer, not NUL terminated */
+typedef struct
+{
+  const gchar *str;
+  gsize        length;
+} StrView;
+
+/* The metadata found in the note, before the note content */
+typedef struct
+{
+  StrView title;
+  StrView create_date;
+  StrView change_date;
+  StrView meta_change_date;
+  StrView color;
+  StrView tags[MAX_HEADER_TAGS];
+  guint   n_tags;
+} NoteHeader;
+
 struct _GnXmlNote
 {
   GnNote parent_instance;
 
-  GString *raw_data;    /* The raw data used to parse, NULL if raw_xml set */
+  /* Guards raw_xml, content_xml, text_content, markup and file */
+  GMutex   content_lock;
   GString *raw_xml;     /* full XML data to be saved to file */
   gchar   *content_xml; /* pointer to the beginning of content */
   GString *text_content;
   GString *markup;
+  GFile   *file;        /* to load the content from, if lazy */
   gchar   *title;
   GList   *tags;        /* List of GnTag */
 
   NoteFormat note_format;
   guint      parse_complete : 1;
+  guint      is_lazy : 1;   /* Content should be loaded from file */
+  guint      is_legacy : 1; /* Converted from an older format */
+
+  GList     *lru_link;      /* Link in loaded_contents, if content loaded */
+  gsize      lru_size;
+
+  /*
+   * XML of each paragraph (line) of the content, as last saved from
+   * a buffer, and the serial to get the buffer changes since then.
+   */
+  GArray    *paragraphs;     /* of Paragraph, guarded by the paragraphs lock */
+  guint      paragraphs_serial;
 };
 
+/*
+ * The XML of a line of the content, including the new line at the end.
+ * Tags that span lines are kept open, so the XML is the same as that
+ * of the whole content serialized at once.  @end_tags has the tags
+ * left open at the end, as packed by gn_xml_note_pack_open_tags().
+ */
+typedef struct
+{
+  GBytes *xml;
+  guint   end_tags;
+} Paragraph;
+
 G_DEFINE_TYPE (GnXmlNote, gn_xml_note, GN_TYPE_NOTE)
 
+static void gn_xml_note_update_raw_xml (GnXmlNote *self);
+
+/* Guards the paragraphs, which are read when serializing in a thread */
+G_LOCK_DEFINE_STATIC (paragraphs);
+
+/* Lazy notes with loaded content, the most recently used at head */
+G_LOCK_DEFINE_STATIC (loaded_contents);
+static GQueue loaded_contents = G_QUEUE_INIT;
+static gsize loaded_contents_size;
+
 /*
  * gn_xml_note_get_format:
  * @data: A string
@@ -167,11 +241,209 @@ gn_xml_note_get_format (const gchar *data,
   return NOTE_FORMAT_UNKNOWN;
 }
 
+/*
+ * Scan the metadata from @data in NOTE_FORMAT_BIJIBEN_2 format, till
+ * the beginning of note content.  The strings in @header points to
+ * the values in @data, nothing is copied.
+ *
+ * This is not an XML parser.  It handles only the simple XML that we
+ * write ourself.  Anything unexpected (comments, CDATA, entities,
+ * nested elements in values, etc.) causes a failure, and such notes
+ * should be parsed with the XML reader.
+ *
+ * Returns: %TRUE if the header was scanned successfully.
+ */
+static gboolean
+gn_xml_note_scan_header (const gchar *data,
+                         gsize        length,
+                         NoteHeader  *header)
+{
+  const gchar *p, *end;
+
+  g_assert (data != NULL);
+  g_assert (header != NULL);
+
+  memset (header, 0, sizeof (NoteHeader));
+  p = data;
+  end = data + length;
+
+  while ((p = memchr (p, '<', end - p)))
+    {
+      const gchar *name, *name_end, *tag_end, *value_end;
+      StrView *field = NULL;
+      gsize name_length;
+
+      name = p + 1;
+      tag_end = memchr (name, '>', end - name);
+
+      if (tag_end == NULL || *name == '!')
+        return FALSE;
+
+      p = tag_end + 1;
+
+      /* Skip XML declaration and close tags of containers */
+      if (*name == '?' || *name == '/')
+        continue;
+
+      for (name_end = name; name_end < tag_end; name_end++)
+        if (g_ascii_isspace (*name_end) || *name_end == '/')
+          break;
+
+      name_length = name_end - name;
+
+#define NAME_IS(str) (name_length == strlen (str) && memcmp (name, str, name_length) == 0)
+      if (NAME_IS ("note-content"))
+        return TRUE;
+      else if (NAME_IS ("title"))
+        field = &header->title;
+      else if (NAME_IS ("create-date"))
+        field = &header->create_date;
+      else if (NAME_IS ("last-change-date"))
+        field = &header->change_date;
+      else if (NAME_IS ("last-metadata-change-date"))
+        field = &header->meta_change_date;
+      else if (NAME_IS ("color"))
+        field = &header->color;
+      else if (NAME_IS ("tag"))
+        {
+          if (header->n_tags == MAX_HEADER_TAGS)
+            return FALSE;
+
+          field = &header->tags[header->n_tags++];
+        }
+#undef NAME_IS
+
+      /* Containers like <note> and <tags>, or unknown elements */
+      if (field == NULL)
+        continue;
+
+      field->str = p;
+
+      /* Empty element like <title/> */
+      if (tag_end[-1] == '/')
+        continue;
+
+      value_end = memchr (p, '<', end - p);
+
+      if (value_end == NULL ||
+          memchr (p, '&', value_end - p) != NULL)
+        return FALSE;
+
+      /* The value should be followed by the close tag */
+      if ((gsize)(end - value_end) < name_length + 3 ||
+          value_end[1] != '/' ||
+          memcmp (value_end + 2, name, name_length) != 0 ||
+          value_end[name_length + 2] != '>')
+        return FALSE;
+
+      field->length = value_end - p;
+      p = value_end + name_length + 3;
+    }
+
+  return FALSE;
+}
+
+/* Copy @view to @buffer if it fits, returns %NULL otherwise */
+static const gchar *
+str_view_to_buffer (StrView *view,
+                    gchar   *buffer,
+                    gsize    size)
+{
+  g_assert (view != NULL);
+  g_assert (buffer != NULL);
+
+  if (view->str == NULL || view->length >= size)
+    return NULL;
+
+  memcpy (buffer, view->str, view->length);
+  buffer[view->length] = '\0';
+
+  return buffer;
+}
+
+static void
+gn_xml_note_set_time (GnXmlNote   *self,
+                      const gchar *property,
+                      StrView     *view)
+{
+  gint64 unix_time;
+
+  g_assert (GN_IS_XML_NOTE (self));
+
+  if (view->str == NULL || view->length == 0)
+    return;
+
+  if (!gn_utils_iso_to_unix_time (view->str, view->length, &unix_time))
+    {
+      g_warning ("Failed to parse %s: %.*s", property,
+                 (gint)view->length, view->str);
+      return;
+    }
+
+  g_object_set (G_OBJECT (self), property, unix_time, NULL);
+}
+
+static void
+gn_xml_note_apply_header (GnXmlNote  *self,
+                          NoteHeader *header,
+                          GnTagStore *tag_store)
+{
+  const gchar *str;
+  gchar buffer[256];
+
+  g_assert (GN_IS_XML_NOTE (self));
+  g_assert (header != NULL);
+
+  if (header->title.str != NULL)
+    {
+      g_autofree gchar *title = NULL;
+
+      title = g_strndup (header->title.str, header->title.length);
+      gn_item_set_title (GN_ITEM (self), title);
+    }
+
+  gn_xml_note_set_time (self, "creation-time", &header->create_date);
+  gn_xml_note_set_time (self, "modification-time", &header->change_date);
+  gn_xml_note_set_time (self, "meta-modification-time", &header->meta_change_date);
+
+  str = str_view_to_buffer (&header->color, buffer, sizeof (buffer));
+
+  if (str != NULL && *str != '\0')
+    {
+      GdkRGBA rgba;
+
+      if (gdk_rgba_parse (&rgba, str))
+        gn_item_set_rgba (GN_ITEM (self), &rgba);
+      else
+        g_warning ("Failed to parse color: %s", str);
+    }
+
+  for (guint i = 0; tag_store != NULL && i < header->n_tags; i++)
+    {
+      g_autofree gchar *name = NULL;
+      GnTag *tag;
+
+      if (header->tags[i].length == 0)
+        continue;
+
+      str = str_view_to_buffer (&header->tags[i], buffer, sizeof (buffer));
+
+      if (str == NULL)
+        str = name = g_strndup (header->tags[i].str, header->tags[i].length);
+
+      tag = gn_tag_store_insert (tag_store, g_intern_string (str), NULL);
+      self->tags = g_list_prepend (self->tags, tag);
+    }
+}
+
 static void
-gn_xml_note_parse (GnXmlNote  *self,
-                   GnTagStore *tag_store)
+gn_xml_note_parse (GnXmlNote   *self,
+                   const gchar *data,
+                   gsize        length,
+                   GnTagStore  *tag_store)
 {
   xmlTextReader *xml_reader;
+  NoteHeader header;
 
   g_assert (GN_IS_XML_NOTE (self));
 
@@ -180,12 +452,20 @@ gn_xml_note_parse (GnXmlNote  *self,
 
   /* Only new bijiben format should be parsed */
   g_return_if_fail (self->note_format == NOTE_FORMAT_BIJIBEN_2);
-  g_return_if_fail (self->raw_xml != NULL);
+  g_return_if_fail (data != NULL);
 
   self->parse_complete = 1;
 
-  xml_reader = xml_reader_new (self->raw_xml->str,
-                               self->raw_xml->len);
+  if (gn_xml_note_scan_header (data, length, &header))
+    {
+      gn_xml_note_apply_header (self, &header, tag_store);
+      self->tags = g_list_sort (self->tags, (GCompareFunc)gn_tag_compare);
+
+      return;
+    }
+
+  g_debug ("Failed to scan note header, using XML reader");
+  xml_reader = xml_reader_new (data, length);
 
   while (xml_reader_read (xml_reader) == 1)
     if (xml_reader_get_node_type (xml_reader) == XML_ELEMENT_NODE)
@@ -203,43 +483,37 @@ gn_xml_note_parse (GnXmlNote  *self,
           }
         else if (g_str_equal (tag, "create-date"))
           {
-            g_autoptr(GDateTime) date_time = NULL;
             gint64 creation_time;
 
             content = xml_reader_dup_string (xml_reader);
-            if (content == NULL)
+            if (content == NULL ||
+                !gn_utils_iso_to_unix_time (content, -1, &creation_time))
               continue;
 
-            date_time = g_date_time_new_from_iso8601 (content, NULL);
-            creation_time = g_date_time_to_unix (date_time);
             g_object_set (G_OBJECT (self), "creation-time",
                           creation_time, NULL);
           }
         else if (g_str_equal (tag, "last-change-date"))
           {
-            g_autoptr(GDateTime) date_time = NULL;
             gint64 modification_time;
 
             content = xml_reader_dup_string (xml_reader);
-            if (content == NULL)
+            if (content == NULL ||
+                !gn_utils_iso_to_unix_time (content, -1, &modification_time))
               continue;
 
-            date_time = g_date_time_new_from_iso8601 (content, NULL);
-            modification_time = g_date_time_to_unix (date_time);
             g_object_set (G_OBJECT (self), "modification-time",
                           modification_time, NULL);
           }
         else if (g_str_equal (tag, "last-metadata-change-date"))
           {
-            g_autoptr(GDateTime) date_time = NULL;
             gint64 modification_time;
 
             content = xml_reader_dup_string (xml_reader);
-            if (content == NULL)
+            if (content == NULL ||
+                !gn_utils_iso_to_unix_time (content, -1, &modification_time))
               continue;
 
-            date_time = g_date_time_new_from_iso8601 (content, NULL);
-            modification_time = g_date_time_to_unix (date_time);
             g_object_set (G_OBJECT (self), "meta-modification-time",
                           modification_time, NULL);
           }
@@ -281,78 +555,233 @@ gn_xml_note_parse (GnXmlNote  *self,
   xml_reader_free (xml_reader);
 }
 
+/* Should be called with content lock held */
 static void
-gn_xml_note_update_buffer (GnXmlNote     *self,
-                           GtkTextBuffer *buffer,
-                           gchar         *start,
-                           gchar         *end)
+gn_xml_note_clear_content (GnXmlNote *self)
 {
-  GtkTextIter iter;
+  g_assert (GN_IS_XML_NOTE (self));
 
-  g_assert (GTK_IS_TEXT_BUFFER (buffer));
-  g_assert (start != NULL);
-  g_assert (end != NULL);
+  if (self->raw_xml)
+    g_string_free (self->raw_xml, TRUE);
+  self->raw_xml = NULL;
+  self->content_xml = NULL;
 
-  if (start == end)
-    return;
+  if (self->text_content)
+    g_string_free (self->text_content, TRUE);
+  self->text_content = NULL;
+  if (self->markup)
+    g_string_free (self->markup, TRUE);
+  self->markup = NULL;
+}
+
+/* Should be called with loaded_contents lock held */
+static void
+gn_xml_note_remove_from_lru (GnXmlNote *self)
+{
+  g_assert (GN_IS_XML_NOTE (self));
 
-  gtk_text_buffer_get_end_iter (buffer, &iter);
+  if (self->lru_link == NULL)
+    return;
 
-  gtk_text_buffer_insert (buffer, &iter, start, end - start);
+  g_queue_delete_link (&loaded_contents, self->lru_link);
+  loaded_contents_size -= self->lru_size;
+  self->lru_link = NULL;
+  self->lru_size = 0;
 }
 
+/*
+ * Mark the content of @self as the most recently used one, and drop the
+ * content of least recently used notes if the limit is exceeded.
+ *
+ * Should be called with content lock of @self held.
+ */
 static void
-gn_xml_note_apply_tag_at_mark (GtkTextBuffer *buffer,
-                               const gchar   *mark_name,
-                               const gchar   *tag_name)
+gn_xml_note_touch_content (GnXmlNote *self)
 {
-  GtkTextMark *mark;
-  GtkTextIter start, end;
+  GList *link;
+
+  g_assert (GN_IS_XML_NOTE (self));
+
+  if (!self->is_lazy)
+    return;
+
+  G_LOCK (loaded_contents);
+
+  if (self->lru_link)
+    {
+      g_queue_unlink (&loaded_contents, self->lru_link);
+      g_queue_push_head_link (&loaded_contents, self->lru_link);
+    }
+  else
+    {
+      g_queue_push_head (&loaded_contents, self);
+      self->lru_link = loaded_contents.head;
+      self->lru_size = self->raw_xml->len;
+      loaded_contents_size += self->lru_size;
+    }
 
-  mark = gtk_text_buffer_get_mark (buffer, mark_name);
-  g_return_if_fail (mark != NULL);
+  /*
+   * The content of @self is never dropped here.  Contents locked by
+   * some other thread are in use, and so those are skipped.  Only
+   * try locking, as the content lock is taken before the list lock.
+   */
+  link = loaded_contents.tail;
+
+  while (loaded_contents_size > MAX_LOADED_CONTENT_SIZE &&
+         link != self->lru_link)
+    {
+      GnXmlNote *note = link->data;
+
+      link = link->prev;
+
+      if (!g_mutex_trylock (&note->content_lock))
+        continue;
+
+      gn_xml_note_remove_from_lru (note);
+      gn_xml_note_clear_content (note);
+      g_mutex_unlock (&note->content_lock);
+    }
 
-  gtk_text_buffer_get_end_iter (buffer, &end);
-  gtk_text_buffer_get_iter_at_mark (buffer, &start, mark);
-  gtk_text_buffer_apply_tag_by_name (buffer, tag_name, &start, &end);
-  gtk_text_buffer_delete_mark (buffer, mark);
+  G_UNLOCK (loaded_contents);
 }
 
-static void
-gn_xml_note_set_content_to_buffer (GnNote       *note,
-                                   GnNoteBuffer *buffer)
+static gboolean
+gn_xml_note_load_content (GnXmlNote  *self,
+                          GError    **error)
 {
-  GtkTextBuffer *text_buffer;
-  gchar *start, *end;
-  const gchar *title;
-  GtkTextIter start_iter, end_iter;
-  gchar c;
+  g_autofree gchar *contents = NULL;
+  const gchar *content_xml;
+  gsize length;
 
-  GnXmlNote *self = GN_XML_NOTE (note);
+  g_assert (GN_IS_XML_NOTE (self));
+  g_assert (self->is_lazy);
+
+  /* The file may be changed in the main thread, but not while locked */
+  if (self->file == NULL)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                           "Note has no file");
+      return FALSE;
+    }
+
+  if (!g_file_load_contents (self->file, NULL, &contents, &length, NULL, error))
+    return FALSE;
+
+  content_xml = strstr (contents, "<note-content>");
+
+  if (content_xml == NULL)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                           "Invalid note content");
+      return FALSE;
+    }
+
+  self->raw_xml = g_string_new_len (contents, length);
+  self->content_xml = self->raw_xml->str + (content_xml - contents);
+  self->content_xml = self->content_xml + strlen ("<note-content>");
+
+  return TRUE;
+}
+
+/*
+ * Make sure that the content of @self is in memory.  This should be
+ * called with content lock held before accessing @raw_xml, or
+ * @content_xml.
+ *
+ * If the content can’t be loaded, the note is left unloaded so that
+ * an empty content is never saved over the file, and %FALSE is
+ * returned.
+ */
+static gboolean
+gn_xml_note_ensure_content (GnXmlNote *self)
+{
+  g_autoptr(GError) error = NULL;
 
   g_assert (GN_IS_XML_NOTE (self));
 
-  text_buffer = GTK_TEXT_BUFFER (buffer);
+  if (!self->is_lazy)
+    return TRUE;
 
-  title = gn_item_get_title (GN_ITEM (self));
-  gtk_text_buffer_set_text (text_buffer, title, -1);
+  if (self->raw_xml == NULL &&
+      !gn_xml_note_load_content (self, &error))
+    {
+      g_warning ("Failed to load note content: %s", error->message);
+      return FALSE;
+    }
 
-  if (g_str_has_prefix (self->content_xml, "</note-content>"))
-    return;
+  gn_xml_note_touch_content (self);
+
+  return TRUE;
+}
+
+/*
+ * The tags that can be found in a note content, in the order of their
+ * priority in #GnNoteBuffer.
+ */
+static const gchar *content_tags[] = { "b", "i", "s", "u" };
+
+typedef struct
+{
+  guint tag;      /* Index in content_tags */
+  gint  start;    /* Offsets in characters */
+  gint  end;
+} TextSpan;
 
-  start = end = self->content_xml;
-  gtk_text_buffer_get_end_iter (text_buffer, &end_iter);
-  gtk_text_buffer_insert (text_buffer, &end_iter, "\n", 1);
+static gint
+gn_xml_note_get_content_tag (const gchar *str)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (content_tags); i++)
+    if (*str == *content_tags[i])
+      return i;
+
+  return -1;
+}
+
+/*
+ * Decode the note content XML @content till </note-content> into
+ * plain @text (appended) and a list of @spans to which the tags are
+ * to be applied.  The offsets in @spans are in characters, counted
+ * from the start of @text, so that they can be directly used with
+ * the buffer once @text is inserted.
+ */
+static void
+gn_xml_note_decode_content (const gchar *content,
+                            GString     *text,
+                            GArray      *spans)
+{
+  const gchar *start, *end;
+  gint open_tags[G_N_ELEMENTS (content_tags)];
+  gint offset;
+  gchar c;
+
+  g_assert (content != NULL);
+  g_assert (text != NULL);
+  g_assert (spans != NULL);
+
+  for (guint i = 0; i < G_N_ELEMENTS (open_tags); i++)
+    open_tags[i] = -1;
+
+  offset = g_utf8_strlen (text->str, text->len);
+  start = end = content;
 
   while ((c = *end))
     {
+      if (c != '<' && c != '&')
+        {
+          end++;
+          continue;
+        }
+
+      if (start != end)
+        {
+          g_string_append_len (text, start, end - start);
+          offset += g_utf8_strlen (start, end - start);
+        }
+
       if (c == '<')
         {
-          const gchar *tag = NULL;
           gboolean is_close_tag = FALSE;
-
-          gn_xml_note_update_buffer (self, text_buffer, start, end);
-          gtk_text_buffer_get_end_iter (text_buffer, &end_iter);
+          gint tag;
 
           /* Skip '<' */
           end++;
@@ -363,63 +792,131 @@ gn_xml_note_set_content_to_buffer (GnNote       *note,
               end++;
             }
 
-          if (g_str_has_prefix (end, "b"))
-            tag = g_intern_static_string ("b");
-          else if (g_str_has_prefix (end, "i"))
-            tag = g_intern_static_string ("i");
-          else if (g_str_has_prefix (end, "s"))
-            tag = g_intern_static_string ("s");
-          else if (g_str_has_prefix (end, "u"))
-            tag = g_intern_static_string ("u");
-          else if (g_str_has_prefix (end, "note-content>"))
-            break;
-
-          if (tag)
+          if (g_str_has_prefix (end, "note-content>"))
             {
-              if (is_close_tag)
-                gn_xml_note_apply_tag_at_mark (text_buffer, tag, tag);
-              else if (!gtk_text_buffer_get_mark (text_buffer, tag))
-                gtk_text_buffer_create_mark (text_buffer, tag, &end_iter, TRUE);
+              start = end = NULL;
+              break;
             }
-          else
+
+          tag = gn_xml_note_get_content_tag (end);
+
+          if (tag == -1)
             g_warn_if_reached ();
+          else if (!is_close_tag && open_tags[tag] == -1)
+            open_tags[tag] = offset;
+          else if (is_close_tag && open_tags[tag] != -1)
+            {
+              TextSpan span = { tag, open_tags[tag], offset };
+
+              if (span.start != span.end)
+                g_array_append_val (spans, span);
+              open_tags[tag] = -1;
+            }
 
           end = strchr (end, '>');
           g_return_if_fail (end != NULL);
-
-          end++;
-          start = end;
         }
-      else if (c == '&')
+      else
         {
           gchar *str = "";
 
-          gn_xml_note_update_buffer (self, text_buffer, start, end);
-          gtk_text_buffer_get_end_iter (text_buffer, &end_iter);
-
           if (g_str_has_prefix (end, "&lt;"))
             str = "<";
           else if (g_str_has_prefix (end, "&gt;"))
             str = ">";
           else if (g_str_has_prefix (end, "&amp;"))
             str = "&";
-          else if (g_str_has_prefix (end, "&quote;"))
+          else if (g_str_has_prefix (end, "&quote;") ||
+                   g_str_has_prefix (end, "&quot;"))
             str = "\"";
-          else if (g_str_has_prefix (end, "&apos;"))
+          else if (g_str_has_prefix (end, "&apos;") ||
+                   g_str_has_prefix (end, "&#39;"))
             str = "'";
           else
             g_warn_if_reached ();
 
-          gtk_text_buffer_insert (text_buffer, &end_iter, str, 1);
+          if (*str)
+            {
+              g_string_append_c (text, *str);
+              offset++;
+            }
 
           end = strchr (end, ';');
           g_return_if_fail (end != NULL);
-
-          end++;
-          start = end;
         }
-      else
-        end++;
+
+      end++;
+      start = end;
+    }
+
+  /* Content without </note-content> */
+  if (start != end)
+    {
+      g_string_append_len (text, start, end - start);
+      offset += g_utf8_strlen (start, end - start);
+    }
+
+  /* Tags left open are applied till the end */
+  for (guint i = 0; i < G_N_ELEMENTS (open_tags); i++)
+    if (open_tags[i] != -1 && open_tags[i] != offset)
+      {
+        TextSpan span = { i, open_tags[i], offset };
+
+        g_array_append_val (spans, span);
+      }
+}
+
+static void
+gn_xml_note_set_content_to_buffer (GnNote       *note,
+                                   GnNoteBuffer *buffer)
+{
+  GtkTextBuffer *text_buffer;
+  GtkTextTagTable *tag_table;
+  GtkTextTag *tags[G_N_ELEMENTS (content_tags)];
+  g_autoptr(GArray) spans = NULL;
+  GString *text;
+  const gchar *title;
+  GtkTextIter start_iter, end_iter;
+
+  GnXmlNote *self = GN_XML_NOTE (note);
+
+  g_assert (GN_IS_XML_NOTE (self));
+
+  text_buffer = GTK_TEXT_BUFFER (buffer);
+
+  /*
+   * Decode the whole content first, so that the buffer is modified
+   * only once, instead of once for every text run and tag.
+   */
+  title = gn_item_get_title (GN_ITEM (self));
+  text = g_string_new (title);
+  spans = g_array_new (FALSE, FALSE, sizeof (TextSpan));
+
+  g_mutex_lock (&self->content_lock);
+  if (gn_xml_note_ensure_content (self) &&
+      !g_str_has_prefix (self->content_xml, "</note-content>"))
+    {
+      g_string_append_c (text, '\n');
+      gn_xml_note_decode_content (self->content_xml, text, spans);
+    }
+  g_mutex_unlock (&self->content_lock);
+
+  gn_note_buffer_freeze (buffer);
+  gtk_text_buffer_set_text (text_buffer, text->str, text->len);
+  g_string_free (text, TRUE);
+
+  tag_table = gtk_text_buffer_get_tag_table (text_buffer);
+  for (guint i = 0; i < G_N_ELEMENTS (content_tags); i++)
+    tags[i] = gtk_text_tag_table_lookup (tag_table, content_tags[i]);
+
+  for (guint i = 0; i < spans->len; i++)
+    {
+      TextSpan *span = &g_array_index (spans, TextSpan, i);
+
+      gtk_text_buffer_get_iter_at_offset (text_buffer, &start_iter, span->start);
+      gtk_text_buffer_get_iter_at_offset (text_buffer, &end_iter, span->end);
+      gtk_text_buffer_apply_tag (text_buffer, tags[span->tag],
+                                 &start_iter, &end_iter);
     }
 
   /* Set common font */
@@ -429,41 +926,49 @@ gn_xml_note_set_content_to_buffer (GnNote       *note,
   /* Set title font */
   gtk_text_buffer_get_iter_at_line (text_buffer, &end_iter, 1);
   gtk_text_buffer_apply_tag_by_name (text_buffer, "title", &start_iter, &end_iter);
+  gn_note_buffer_thaw (buffer);
 
   gtk_text_buffer_set_modified (text_buffer, FALSE);
 }
 
+/* In the order of #GnTextTag */
+static const gchar *content_open_tags[] = { "<b>", "<i>", "<s>", "<u>" };
+static const gchar *content_close_tags[] = { "</b>", "</i>", "</s>", "</u>" };
+
+
 static void
-gn_xml_note_close_tag (GnXmlNote   *self,
-                       GString     *raw_content,
-                       const gchar *tag_name,
-                       GQueue      *tags_queue)
+gn_xml_note_close_tag (GString *raw_content,
+                       guint    tag,
+                       guint   *open_tags,
+                       guint   *n_open_tags)
 {
-  GList *last_tag;
-  GList *node;
+  guint last_tag, i;
 
-  g_assert (GN_IS_XML_NOTE (self));
   g_assert (raw_content != NULL);
-  g_assert (tag_name != NULL);
-  g_assert (tags_queue != NULL);
+  g_assert (tag < G_N_ELEMENTS (content_tags));
+  g_assert (open_tags != NULL);
+  g_assert (n_open_tags != NULL);
 
-  last_tag = g_queue_find (tags_queue, g_intern_string (tag_name));
+  /* @open_tags is in the order the tags are opened */
+  for (last_tag = 0; last_tag < *n_open_tags; last_tag++)
+    if (open_tags[last_tag] == tag)
+      break;
 
-  if (last_tag == NULL)
+  if (last_tag == *n_open_tags)
     return;
 
   /*
    * First, we have to close the tags in the reverse order it is opened.
-   * Eg: If the @tags_queue has "i" as head, then "s" and then "b", and
-   * if the @tag_name represents "b", we have to close "i"  tag first,
+   * Eg: If @open_tags has "b", then "s" and then "i" open, and
+   * if @tag represents "b", we have to close "i"  tag first,
    * then "s", and then close "b" tag.  That is, the result
    * should be the following:
    * <b><s><i>some text</i></s></b> and not <b><s><i>some text</b>...
    */
-  for (node = tags_queue->head; node != NULL; node = node->next)
+  for (i = *n_open_tags; i-- > last_tag;)
     {
-      g_autofree gchar *tag = g_strconcat ("<", node->data, ">", NULL);
-      gsize length = strlen (tag);
+      const gchar *open_tag = content_open_tags[open_tags[i]];
+      gsize length = strlen (open_tag);
 
       /*
        * Remove empty tags.
@@ -475,29 +980,297 @@ gn_xml_note_close_tag (GnXmlNote   *self,
        * it further to "<i>test<u>g</u></i>".  Do so if it’s possible.
        */
       if (raw_content->len >= length &&
-          g_str_equal (raw_content->str + raw_content->len - length, tag))
+          memcmp (raw_content->str + raw_content->len - length, open_tag, length) == 0)
         g_string_truncate (raw_content, raw_content->len - length);
       else
-        g_string_append_printf (raw_content, "</%s>", (gchar *)node->data);
-
-      if (node == last_tag)
-        break;
+        g_string_append (raw_content, content_close_tags[open_tags[i]]);
     }
 
   /*
    * To make the XML valid, we have to open the closed tags that aren't
    * supposed to be closed.  Again, from the previous example: We
-   * have closed "s" and "i" tags.  We have to open them in reverse
-   * order. This results in: <b><s><i>some text</i></s></b><s><i>
+   * have closed "s" and "i" tags.  We have to open them in the order
+   * they were opened. This results in: <b><s><i>some text</i></s></b><s><i>
    */
-  for (node = node->prev; node != NULL; node = node->prev)
-    g_string_append_printf (raw_content, "<%s>", (gchar *)node->data);
+  for (i = last_tag + 1; i < *n_open_tags; i++)
+    g_string_append (raw_content, content_open_tags[open_tags[i]]);
 
-  /* Remove the tag we closed from the queue */
-  g_queue_delete_link (tags_queue, last_tag);
+  /* Remove the tag we closed */
+  memmove (open_tags + last_tag, open_tags + last_tag + 1,
+           (*n_open_tags - last_tag - 1) * sizeof (*open_tags));
+  (*n_open_tags)--;
 }
 
-void
+/*
+ * Same as g_markup_escape_text(), but appends to @xml without
+ * allocating a copy for every piece of text.
+ */
+static void
+gn_xml_note_append_escaped_len (GString     *xml,
+                                const gchar *text,
+                                gsize        length)
+{
+  const gchar *start, *end, *p;
+
+  g_assert (xml != NULL);
+  g_assert (text != NULL);
+
+  start = text;
+  end = text + length;
+
+  for (p = text; p < end; p++)
+    {
+      const gchar *entity = NULL;
+      guchar c = *p;
+      gsize char_length = 1;
+
+      if (c == '&')
+        entity = "&amp;";
+      else if (c == '<')
+        entity = "&lt;";
+      else if (c == '>')
+        entity = "&gt;";
+      else if (c == '"')
+        entity = "&quot;";
+      else if (c == '\'' ||
+               (c < 0x20 && c != '\t' && c != '\n' && c != '\r') ||
+               c == 0x7f)
+        ;
+      else if (c == 0xc2 && p + 1 < end &&
+               (guchar)p[1] >= 0x80 && (guchar)p[1] <= 0x9f)
+        char_length = 2;
+      else
+        continue;
+
+      g_string_append_len (xml, start, p - start);
+
+      /*
+       * Apostrophes and control characters are rare, and the way
+       * they are escaped depends on the GLib version.  Let GLib do it.
+       */
+      if (entity != NULL)
+        {
+          g_string_append (xml, entity);
+        }
+      else
+        {
+          g_autofree gchar *escaped = NULL;
+
+          escaped = g_markup_escape_text (p, char_length);
+          g_string_append (xml, escaped);
+        }
+
+      p += char_length - 1;
+      start = p + 1;
+    }
+
+  g_string_append_len (xml, start, end - start);
+}
+
+/*
+ * Append the XML for @text from @start till @end (byte offsets) to
+ * @raw_content.  @runs should point to the run that covers @start.
+ * @open_tags has the tags open at @start, and is updated with the
+ * tags open at @end.  If @close_all is %TRUE, all tags are closed
+ * at @end.
+ */
+static void
+gn_xml_note_append_runs (GString         *raw_content,
+                         const gchar     *text,
+                         const GnTextRun *runs,
+                         guint            start,
+                         guint            end,
+                         guint           *open_tags,
+                         guint           *n_open_tags,
+                         gboolean         close_all)
+{
+  guint mask = 0;
+  guint pos = start;
+
+  g_assert (raw_content != NULL);
+  g_assert (text != NULL);
+  g_assert (runs != NULL);
+
+  for (guint i = 0; i < *n_open_tags; i++)
+    mask |= 1 << open_tags[i];
+
+  while (TRUE)
+    {
+      GnTextRun run = { end, 0 };
+      guint closed, opened;
+      guint tag;
+
+      if (pos < end)
+        {
+          run.end = MIN (runs->end, end);
+          run.tags = runs->tags;
+          runs++;
+        }
+      else if (!close_all)
+        {
+          break;
+        }
+
+      closed = mask & ~run.tags;
+      opened = run.tags & ~mask;
+
+      /*
+       * First, we have to handle tags that are closed.  The order of
+       * tags to be closed should be opposite to that of opened.
+       */
+      for (tag = G_N_ELEMENTS (content_tags); tag-- > 0;)
+        if (closed & (1 << tag))
+          gn_xml_note_close_tag (raw_content, tag, open_tags, n_open_tags);
+
+      if (pos == end)
+        break;
+
+      /* Now, let's handle open tags */
+      for (tag = 0; tag < G_N_ELEMENTS (content_tags); tag++)
+        if (opened & (1 << tag))
+          {
+            g_string_append (raw_content, content_open_tags[tag]);
+            open_tags[(*n_open_tags)++] = tag;
+          }
+
+      gn_xml_note_append_escaped_len (raw_content, text + pos, run.end - pos);
+      pos = run.end;
+      mask = run.tags;
+    }
+
+  g_assert (!close_all || *n_open_tags == 0);
+}
+
+/* Pack the tags in @open_tags, in order, with the count in the lowest bits */
+static guint
+gn_xml_note_pack_open_tags (const guint *open_tags,
+                            guint        n_open_tags)
+{
+  guint packed = n_open_tags;
+
+  for (guint i = 0; i < n_open_tags; i++)
+    packed |= open_tags[i] << (3 + 2 * i);
+
+  return packed;
+}
+
+static guint
+gn_xml_note_unpack_open_tags (guint  packed,
+                              guint *open_tags)
+{
+  guint n_open_tags = packed & 0x7;
+
+  for (guint i = 0; i < n_open_tags; i++)
+    open_tags[i] = (packed >> (3 + 2 * i)) & 0x3;
+
+  return n_open_tags;
+}
+
+static void
+paragraph_clear (gpointer data)
+{
+  Paragraph *paragraph = data;
+
+  g_clear_pointer (&paragraph->xml, g_bytes_unref);
+}
+
+static GArray *
+paragraph_array_new (guint n_paragraphs)
+{
+  GArray *paragraphs;
+
+  paragraphs = g_array_sized_new (FALSE, FALSE, sizeof (Paragraph), n_paragraphs);
+  g_array_set_clear_func (paragraphs, paragraph_clear);
+
+  return paragraphs;
+}
+
+/* Serializes the lines of a snapshot one by one */
+typedef struct
+{
+  const gchar     *text;
+  gsize            length;
+  gsize            line_start;
+  const GnTextRun *run;
+  const GnTextRun *runs_end;
+  guint            open_tags[G_N_ELEMENTS (content_tags)];
+  guint            n_open_tags;
+} LineWriter;
+
+/*
+ * Start serializing @snapshot from @first_line, with the tags in
+ * @end_tags of the previous paragraph open.
+ */
+static void
+line_writer_init (LineWriter     *writer,
+                  GnNoteSnapshot *snapshot,
+                  guint           first_line,
+                  guint           end_tags)
+{
+  guint n_runs;
+
+  g_assert (writer != NULL);
+  g_assert (snapshot != NULL);
+
+  writer->text = gn_note_snapshot_get_text (snapshot, &writer->length);
+  writer->run = gn_note_snapshot_get_runs (snapshot, &n_runs);
+  writer->runs_end = writer->run + n_runs;
+  writer->line_start = 0;
+  writer->n_open_tags = gn_xml_note_unpack_open_tags (end_tags, writer->open_tags);
+
+  for (guint i = 0; i < first_line; i++)
+    {
+      const gchar *line_end;
+
+      line_end = memchr (writer->text + writer->line_start, '\n',
+                         writer->length - writer->line_start);
+      g_return_if_fail (line_end != NULL);
+      writer->line_start = line_end - writer->text + 1;
+    }
+}
+
+/* Append the paragraph for the next line to @paragraphs */
+static void
+line_writer_append_line (LineWriter *writer,
+                         GArray     *paragraphs)
+{
+  Paragraph paragraph;
+  const gchar *line_end;
+  GString *xml;
+  gsize end;
+
+  g_assert (writer != NULL);
+  g_assert (paragraphs != NULL);
+
+  line_end = memchr (writer->text + writer->line_start, '\n',
+                     writer->length - writer->line_start);
+  /* Include the new line, so that tags can be closed before it */
+  end = line_end ? (gsize)(line_end - writer->text) + 1 : writer->length;
+
+  /* Skip runs that end before this line */
+  while (writer->run + 1 < writer->runs_end && writer->run->end <= writer->line_start)
+    writer->run++;
+
+  xml = g_string_sized_new (end - writer->line_start + 16);
+  gn_xml_note_append_runs (xml, writer->text, writer->run,
+                           writer->line_start, end, writer->open_tags,
+                           &writer->n_open_tags, line_end == NULL);
+
+  paragraph.xml = g_string_free_to_bytes (xml);
+  paragraph.end_tags = gn_xml_note_pack_open_tags (writer->open_tags,
+                                                   writer->n_open_tags);
+  g_array_append_val (paragraphs, paragraph);
+
+  writer->line_start = end;
+}
+
+static guint
+line_writer_get_end_tags (LineWriter *writer)
+{
+  return gn_xml_note_pack_open_tags (writer->open_tags, writer->n_open_tags);
+}
+
+void
 gn_xml_note_append_escaped (GString     *xml,
                             const gchar *content)
 {
@@ -533,13 +1306,13 @@ gn_xml_note_add_time_tag (GString     *xml,
                           const gchar *tag,
                           gint64       unix_time)
 {
-  g_autofree gchar *iso_time = NULL;
+  gchar iso_time[GN_ISO_TIME_BUFFER_SIZE];
 
   g_return_if_fail (xml != NULL);
   g_return_if_fail (tag != NULL);
   g_return_if_fail (*tag);
 
-  iso_time = gn_utils_unix_time_to_iso (unix_time);
+  gn_utils_unix_time_to_iso_buffer (unix_time, iso_time);
   g_string_append_printf (xml, "<%s>%s</%s>\n", tag, iso_time, tag);
 }
 
@@ -594,133 +1367,177 @@ gn_xml_note_update_raw_xml (GnXmlNote *self)
                    "<note-content>");
 }
 
-static gint
-gn_xml_note_sort_tag (gconstpointer a,
-                      gconstpointer b)
+typedef struct
 {
-  GtkTextTag *tag_a = (gpointer)a;
-  GtkTextTag *tag_b = (gpointer)b;
-
-  return gtk_text_tag_get_priority (tag_a) -
-    gtk_text_tag_get_priority (tag_b);
-}
+  GArray  *paragraphs;  /* of Paragraph */
+  GString *content;
+} XmlContent;
 
-static gint
-gn_xml_note_sort_tag_reverse (gconstpointer a,
-                              gconstpointer b)
-{
-  GtkTextTag *tag_a = (gpointer)a;
-  GtkTextTag *tag_b = (gpointer)b;
-
-  return gtk_text_tag_get_priority (tag_b) -
-    gtk_text_tag_get_priority (tag_a);
-}
-
-static void
-gn_xml_note_set_content_from_buffer (GnNote        *note,
-                                     GtkTextBuffer *buffer)
+/*
+ * Serialize the content of @snapshot.  The XML of the paragraphs
+ * that were not changed since the last saved snapshot is reused.
+ *
+ * This may be run in a thread.
+ */
+static gpointer
+gn_xml_note_serialize_snapshot (GnNote         *note,
+                                GnNoteSnapshot *snapshot)
 {
-  GnXmlNote *self = GN_XML_NOTE (note);
-  GQueue *tags_queue;
-  GString *raw_content;
-  g_autofree gchar *content = NULL;
-  GtkTextIter start, end, iter;
-  gboolean has_content;
-  gint content_start;
+  GnXmlNote *self = (GnXmlNote *)note;
+  g_autoptr(GArray) old_paragraphs = NULL;
+  XmlContent *content;
+  LineWriter writer = { 0 };
+  GArray *paragraphs;
+  gsize size = 0;
+  guint n_head, n_tail, n_lines;
+  guint serial;
 
   g_assert (GN_IS_XML_NOTE (self));
-  g_assert (GTK_IS_TEXT_BUFFER (buffer));
+  g_assert (snapshot != NULL);
 
-  tags_queue = g_queue_new ();
-  raw_content = g_string_sized_new (gtk_text_buffer_get_char_count (buffer));
+  G_LOCK (paragraphs);
+  if (self->paragraphs != NULL)
+    old_paragraphs = g_array_ref (self->paragraphs);
+  serial = self->paragraphs_serial;
+  G_UNLOCK (paragraphs);
 
-  if (gn_item_get_creation_time (GN_ITEM (self)) == 0)
-    g_object_set (self, "creation-time", time (NULL), NULL);
-  if (gn_item_get_meta_modification_time (GN_ITEM (self)) == 0)
-    g_object_set (self, "meta-modification-time", time (NULL), NULL);
+  n_lines = gn_note_snapshot_get_n_lines (snapshot);
+  paragraphs = paragraph_array_new (n_lines);
 
-  g_object_set (self, "modification-time", time (NULL), NULL);
+  if (old_paragraphs != NULL &&
+      gn_note_snapshot_get_changed_lines (snapshot, serial, &n_head, &n_tail) &&
+      n_head + n_tail <= n_lines &&
+      n_head + n_tail <= old_paragraphs->len)
+    {
+      guint end_tags = 0;
 
-  gtk_text_buffer_get_start_iter (buffer, &start);
-  gtk_text_buffer_get_iter_at_line_offset (buffer, &end, 0, G_MAXINT);
-  content = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
-  gn_item_set_title (GN_ITEM (note), content);
-  has_content = gtk_text_iter_forward_char (&end);
+      /*
+       * Only the last paragraph has no new line at the end, so it can
+       * be reused in the head only if it is still the last one.
+       */
+      if (n_head > 0 && (n_head == n_lines) != (n_head == old_paragraphs->len))
+        n_head--;
 
-  gn_xml_note_update_raw_xml (self);
-  /* Point to end of <note-content> */
-  content_start = self->raw_xml->len;
+      for (guint i = 0; i < n_head; i++)
+        {
+          Paragraph paragraph = g_array_index (old_paragraphs, Paragraph, i);
 
-  if (!has_content)
-    goto end;
+          paragraph.xml = g_bytes_ref (paragraph.xml);
+          end_tags = paragraph.end_tags;
+          g_array_append_val (paragraphs, paragraph);
+        }
 
-  gtk_text_iter_set_line (&end, 1);
-  iter = start = end;
+      /* Replace the paragraphs in between the unchanged ones */
+      if (n_head < n_lines)
+        line_writer_init (&writer, snapshot, n_head, end_tags);
 
-  while (gtk_text_iter_forward_to_tag_toggle (&iter, NULL))
-    {
-      GSList *tags;
-      const gchar *tag_name;
+      for (guint i = n_head; i < n_lines - n_tail; i++)
+        line_writer_append_line (&writer, paragraphs);
 
-      if (!gtk_text_iter_equal (&iter, &start))
+      /*
+       * The unchanged paragraphs at the end can be reused only if the
+       * same tags are open before them as before.  Else, serialize
+       * them too, till the open tags are the same again.
+       */
+      while (n_tail > 0)
         {
-          g_autofree gchar *content = NULL;
-          g_autofree gchar *markup = NULL;
+          guint first_tail = old_paragraphs->len - n_tail;
 
-          content = gtk_text_buffer_get_text (buffer, &start, &iter, FALSE);
-          markup = g_markup_escape_text (content, -1);
-          g_string_append (raw_content, markup);
+          end_tags = 0;
+          if (first_tail > 0)
+            end_tags = g_array_index (old_paragraphs, Paragraph, first_tail - 1).end_tags;
 
-          start = iter;
+          if (end_tags == line_writer_get_end_tags (&writer))
+            break;
+
+          line_writer_append_line (&writer, paragraphs);
+          n_tail--;
         }
 
-      /* First, we have to handle tags that are closed */
-      tags = gtk_text_iter_get_toggled_tags (&iter, FALSE);
-      /*
-       * The order of tags are undefined, let’s make it deterministic.
-       * The sort order of open and close tags should be opposite to
-       * each other.
-       */
-      tags = g_slist_sort (tags, gn_xml_note_sort_tag_reverse);
-      for (GSList *node = tags; node != NULL; node = node->next)
+      for (guint i = old_paragraphs->len - n_tail; i < old_paragraphs->len; i++)
         {
-          GtkTextTag *tag = node->data;
+          Paragraph paragraph = g_array_index (old_paragraphs, Paragraph, i);
 
-          tag_name = gn_note_buffer_get_name_for_tag (GN_NOTE_BUFFER (buffer),
-                                                      tag);
-          if (*tag_name != '\0')
-            gn_xml_note_close_tag (self, raw_content, tag_name, tags_queue);
+          paragraph.xml = g_bytes_ref (paragraph.xml);
+          g_array_append_val (paragraphs, paragraph);
         }
-      g_slist_free (tags);
+    }
+  else
+    {
+      line_writer_init (&writer, snapshot, 0, 0);
 
-      /* Now, let's handle open tags */
-      tags = gtk_text_iter_get_toggled_tags (&iter, TRUE);
-      tags = g_slist_sort (tags, gn_xml_note_sort_tag);
-      for (GSList *node = tags; node != NULL; node = node->next)
-        {
-          GtkTextTag *tag = node->data;
+      for (guint i = 0; i < n_lines; i++)
+        line_writer_append_line (&writer, paragraphs);
+    }
 
-          tag_name = gn_note_buffer_get_name_for_tag (GN_NOTE_BUFFER (buffer),
-                                                      tag);
-          if (*tag_name != '\0')
-            {
-              g_string_append_printf (raw_content, "<%s>", tag_name);
-              g_queue_push_head (tags_queue, (gchar *)g_intern_string (tag_name));
-            }
-        }
+  g_warn_if_fail (paragraphs->len == n_lines);
+
+  for (guint i = 0; i < paragraphs->len; i++)
+    size += g_bytes_get_size (g_array_index (paragraphs, Paragraph, i).xml);
+
+  content = g_new0 (XmlContent, 1);
+  content->paragraphs = paragraphs;
+  content->content = g_string_sized_new (size + 1);
 
-      g_slist_free (tags);
+  for (guint i = 0; i < paragraphs->len; i++)
+    {
+      gconstpointer data;
+      gsize length;
+
+      data = g_bytes_get_data (g_array_index (paragraphs, Paragraph, i).xml, &length);
+      g_string_append_len (content->content, data, length);
     }
 
-  for (GList *node = tags_queue->head; node != NULL; node = node->next)
-    g_string_append_printf (raw_content, "</%s>", (gchar *)node->data);
+  return content;
+}
+
+static void
+gn_xml_note_apply_snapshot (GnNote         *note,
+                            GnNoteSnapshot *snapshot,
+                            gpointer        serialized)
+{
+  GnXmlNote *self = GN_XML_NOTE (note);
+  XmlContent *content = serialized;
+  gsize content_start;
+
+  g_assert (GN_IS_XML_NOTE (self));
+  g_assert (snapshot != NULL);
+  g_assert (content != NULL);
+
+  /* Once saved, the file is in the current format */
+  self->is_legacy = FALSE;
+
+  if (gn_item_get_creation_time (GN_ITEM (self)) == 0)
+    g_object_set (self, "creation-time", time (NULL), NULL);
+  if (gn_item_get_meta_modification_time (GN_ITEM (self)) == 0)
+    g_object_set (self, "meta-modification-time", time (NULL), NULL);
 
-  g_queue_free (tags_queue);
+  g_object_set (self, "modification-time", time (NULL), NULL);
+  gn_item_set_title (GN_ITEM (note), gn_note_snapshot_get_title (snapshot));
+
+  G_LOCK (paragraphs);
+  g_clear_pointer (&self->paragraphs, g_array_unref);
+  self->paragraphs = g_steal_pointer (&content->paragraphs);
+  self->paragraphs_serial = gn_note_snapshot_get_serial (snapshot);
+  G_UNLOCK (paragraphs);
 
-  if (raw_content && raw_content->str)
-    g_string_append (self->raw_xml, raw_content->str);
+  g_mutex_lock (&self->content_lock);
 
- end:
+  /*
+   * The content is going to be modified, and the file is no more
+   * in sync with the content.  So never drop the content from now.
+   */
+  G_LOCK (loaded_contents);
+  gn_xml_note_remove_from_lru (self);
+  G_UNLOCK (loaded_contents);
+  self->is_lazy = FALSE;
+
+  gn_xml_note_update_raw_xml (self);
+  /* Point to end of <note-content> */
+  content_start = self->raw_xml->len;
+
+  g_string_append_len (self->raw_xml, content->content->str,
+                       content->content->len);
   g_string_append (self->raw_xml, "</note-content></text></note>\n");
   self->content_xml = self->raw_xml->str + content_start;
 
@@ -730,6 +1547,11 @@ gn_xml_note_set_content_from_buffer (GnNote        *note,
   if (self->markup)
     g_string_free (self->markup, TRUE);
   self->markup = NULL;
+
+  g_mutex_unlock (&self->content_lock);
+
+  g_string_free (content->content, TRUE);
+  g_free (content);
 }
 
 static void
@@ -739,17 +1561,24 @@ gn_xml_note_finalize (GObject *object)
 
   GN_ENTRY;
 
+  G_LOCK (loaded_contents);
+  gn_xml_note_remove_from_lru (self);
+  G_UNLOCK (loaded_contents);
+
   g_free (self->title);
-  if (self->text_content)
-    g_string_free (self->text_content, TRUE);
-  if (self->markup)
-    g_string_free (self->markup, TRUE);
+  G_LOCK (paragraphs);
+  g_clear_pointer (&self->paragraphs, g_array_unref);
+  G_UNLOCK (paragraphs);
+  gn_xml_note_clear_content (self);
+  g_clear_object (&self->file);
+  g_mutex_clear (&self->content_lock);
 
   G_OBJECT_CLASS (gn_xml_note_parent_class)->finalize (object);
 
   GN_EXIT;
 }
 
+/* Should be called with content lock held */
 static void
 gn_xml_note_update_text_content (GnXmlNote *self)
 {
@@ -762,17 +1591,19 @@ gn_xml_note_update_text_content (GnXmlNote *self)
     g_string_free (self->text_content, TRUE);
   self->text_content = NULL;
 
+  if (!gn_xml_note_ensure_content (self))
+    return;
+
   content = gn_utils_get_text_from_xml (self->raw_xml->str);
   casefold_content = g_utf8_casefold (content, -1);
   self->text_content = g_string_new (casefold_content);
 }
 
+/* Should be called with content lock held */
 static gchar *
-gn_xml_note_get_text_content (GnNote *note)
+gn_xml_note_dup_text_content (GnXmlNote *self)
 {
-  GnXmlNote *self = GN_XML_NOTE (note);
-
-  g_assert (GN_IS_NOTE (note));
+  g_assert (GN_IS_XML_NOTE (self));
 
   if (self->text_content == NULL)
     gn_xml_note_update_text_content (self);
@@ -788,20 +1619,45 @@ gn_xml_note_get_text_content (GnNote *note)
   return g_strdup (self->text_content->str);
 }
 
+static gchar *
+gn_xml_note_get_text_content (GnNote *note)
+{
+  GnXmlNote *self = GN_XML_NOTE (note);
+  gchar *content;
+
+  g_assert (GN_IS_NOTE (note));
+
+  g_mutex_lock (&self->content_lock);
+  content = gn_xml_note_dup_text_content (self);
+  g_mutex_unlock (&self->content_lock);
+
+  return content;
+}
+
+/*
+ * Returns %NULL if the content of @note can’t be loaded, so that
+ * the file isn’t overwritten with an empty note.
+ */
 static gchar *
 gn_xml_note_get_raw_content (GnNote *note)
 {
   GnXmlNote *self = GN_XML_NOTE (note);
+  gchar *raw_content = NULL;
 
   g_assert (GN_IS_NOTE (note));
 
+  g_mutex_lock (&self->content_lock);
+
+  if (!gn_xml_note_ensure_content (self))
+    goto out;
+
   /* TODO: only for notes being imported */
   if (self->raw_xml == NULL)
     {
       g_autofree gchar *content = NULL;
 
       gn_xml_note_update_raw_xml (self);
-      content = gn_note_get_text_content (GN_NOTE (self));
+      content = gn_xml_note_dup_text_content (self);
 
       if (content)
         {
@@ -812,7 +1668,12 @@ gn_xml_note_get_raw_content (GnNote *note)
       g_string_append (self->raw_xml, "</note-content></text></note>");
     }
 
-  return g_strdup (self->raw_xml->str);
+  raw_content = g_strdup (self->raw_xml->str);
+
+ out:
+  g_mutex_unlock (&self->content_lock);
+
+  return raw_content;
 }
 
 static void
@@ -838,16 +1699,23 @@ gn_xml_add_pending (GString     *string,
   g_string_append_len (string, start, end - start);
 }
 
+/* Should be called with content lock held */
 static void
 gn_xml_note_update_markup (GnXmlNote *self)
 {
-  GQueue *tags_queue;
+  guint open_tags[G_N_ELEMENTS (content_tags)];
+  guint tag_count[G_N_ELEMENTS (content_tags)] = { 0 };
+  guint n_open_tags = 0;
   gchar *tag_start, *start, *tag_end;
 
   g_assert (GN_IS_XML_NOTE (self));
 
   if (self->markup)
     g_string_free (self->markup, TRUE);
+  self->markup = NULL;
+
+  if (!gn_xml_note_ensure_content (self))
+    return;
 
   /* Exit early if empty note contentn */
   if (g_str_has_prefix (self->content_xml, "</note-content>"))
@@ -856,16 +1724,14 @@ gn_xml_note_update_markup (GnXmlNote *self)
       return;
     }
 
-  tags_queue = g_queue_new ();
   start = tag_start = self->content_xml;
   self->markup = g_string_new ("<markup>"
                                "<span font='Cantarell'>");
 
   while ((tag_start = strchr (tag_start, '<')))
     {
-      g_autofree gchar *tag = NULL;
-      const gchar *interned_tag;
       gboolean is_close_tag = FALSE;
+      gint tag;
 
       gn_xml_add_pending (self->markup, start, tag_start);
 
@@ -882,30 +1748,32 @@ gn_xml_note_update_markup (GnXmlNote *self)
       if (G_UNLIKELY (!tag_end))
         break;
 
-      tag = g_strndup (tag_start, tag_end - tag_start);
-      interned_tag = g_intern_string (tag);
-
-      if (interned_tag == g_intern_static_string ("note-content"))
+      if (g_str_has_prefix (tag_start, "note-content>"))
         break;
 
-      if (interned_tag == g_intern_static_string ("b") ||
-          interned_tag == g_intern_static_string ("i") ||
-          interned_tag == g_intern_static_string ("s") ||
-          interned_tag == g_intern_static_string ("u"))
+      tag = tag_end - tag_start == 1 ? gn_xml_note_get_content_tag (tag_start) : -1;
+
+      /*
+       * Nested tags of the same kind don’t change the markup, so only
+       * the outermost one is written, which keeps @open_tags unique.
+       */
+      if (tag == -1)
+        ;
+      else if (!is_close_tag && tag_count[tag]++ == 0)
         {
-          if (is_close_tag)
-            gn_xml_note_close_tag (self, self->markup, interned_tag, tags_queue);
-          else
-            {
-              g_queue_push_head (tags_queue, (gchar *)interned_tag);
-              g_string_append_printf (self->markup, "<%s>", interned_tag);
-            }
+          g_string_append (self->markup, content_open_tags[tag]);
+          open_tags[n_open_tags++] = tag;
         }
+      else if (is_close_tag && tag_count[tag] > 0 && --tag_count[tag] == 0)
+        {
+          gn_xml_note_close_tag (self->markup, tag, open_tags, &n_open_tags);
+        }
+
       tag_start = start = tag_end + 1;
     }
 
-  for (GList *node = tags_queue->head; node != NULL; node = node->next)
-    g_string_append_printf (self->markup, "</%s>", (gchar *)node->data);
+  while (n_open_tags > 0)
+    g_string_append (self->markup, content_close_tags[open_tags[--n_open_tags]]);
 
   g_string_append (self->markup, "</span></markup>");
 }
@@ -914,14 +1782,19 @@ static gchar *
 gn_xml_note_get_markup (GnNote *note)
 {
   GnXmlNote *self = GN_XML_NOTE (note);
+  gchar *markup;
 
   g_assert (GN_IS_NOTE (note));
 
+  g_mutex_lock (&self->content_lock);
 
   if (self->markup == NULL)
     gn_xml_note_update_markup (self);
 
-  return g_strdup (self->markup->str);
+  markup = g_strdup (self->markup ? self->markup->str : "");
+  g_mutex_unlock (&self->content_lock);
+
+  return markup;
 }
 
 static GList *
@@ -943,7 +1816,6 @@ gn_xml_note_match (GnItem      *item,
                    const gchar *needle)
 {
   GnXmlNote *self = GN_XML_NOTE (item);
-  g_autofree gchar *content = NULL;
   gboolean match;
 
   match = GN_ITEM_CLASS (gn_xml_note_parent_class)->match (item, needle);
@@ -951,13 +1823,18 @@ gn_xml_note_match (GnItem      *item,
   if (match)
     return TRUE;
 
+  g_mutex_lock (&self->content_lock);
+
   if (self->text_content == NULL)
     gn_xml_note_update_text_content (self);
 
-  if (strstr (self->text_content->str, needle) != NULL)
-    return TRUE;
+  /* The text content is already casefolded */
+  match = self->text_content != NULL &&
+          strstr (self->text_content->str, needle) != NULL;
 
-  return FALSE;
+  g_mutex_unlock (&self->content_lock);
+
+  return match;
 }
 
 static GnFeature
@@ -984,7 +1861,8 @@ gn_xml_note_class_init (GnXmlNoteClass *klass)
   note_class->get_extension = gn_xml_note_get_extension;
 
   note_class->set_content_to_buffer = gn_xml_note_set_content_to_buffer;
-  note_class->set_content_from_buffer = gn_xml_note_set_content_from_buffer;
+  note_class->serialize_snapshot = gn_xml_note_serialize_snapshot;
+  note_class->apply_snapshot = gn_xml_note_apply_snapshot;
 
   item_class->match = gn_xml_note_match;
   item_class->get_features = gn_xml_note_get_features;
@@ -993,10 +1871,360 @@ gn_xml_note_class_init (GnXmlNoteClass *klass)
 static void
 gn_xml_note_init (GnXmlNote *self)
 {
+  g_mutex_init (&self->content_lock);
   self->text_content = g_string_new ("");
   self->note_format = NOTE_FORMAT_BIJIBEN_2;
 }
 
+/*
+ * Content of a note in older format, converted to the current
+ * format as it is read.  The first line of the content is the
+ * title, and the rest goes to @body.
+ */
+typedef struct
+{
+  GString  *title;
+  GString  *body;
+  /* Number of open elements for each of b, i, s and u tags */
+  guint     tag_count[4];
+  /* Tags opened in @body, the innermost at the end */
+  gchar     open_tags[4];
+  guint     n_open_tags;
+  gboolean  in_body;
+  gboolean  at_line_start;
+} LegacyContent;
+
+static const gchar legacy_tags[] = { 'b', 'i', 's', 'u' };
+
+/* Get the index of the format tag in legacy_tags for element @name */
+static gint
+gn_xml_note_get_legacy_tag (const gchar *name)
+{
+  static const gchar *tag_names[][4] = {
+    { "b", "bold", "strong", NULL },
+    { "i", "italic", "em", NULL },
+    { "s", "strikethrough", "strike", "del" },
+    { "u", "underline", NULL, NULL },
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (tag_names); i++)
+    for (guint j = 0; j < G_N_ELEMENTS (tag_names[i]) && tag_names[i][j]; j++)
+      if (g_str_equal (name, tag_names[i][j]))
+        return i;
+
+  return -1;
+}
+
+static void
+gn_xml_note_append_legacy_text (LegacyContent *content,
+                                const gchar   *text)
+{
+  g_assert (content != NULL);
+
+  for (const gchar *c = text; c && *c; c++)
+    {
+      if (!content->in_body)
+        {
+          if (*c != '\n')
+            {
+              g_string_append_c (content->title, *c);
+              content->at_line_start = FALSE;
+              continue;
+            }
+
+          /* Reopen the tags continuing from the title */
+          content->in_body = TRUE;
+          content->at_line_start = TRUE;
+
+          for (guint i = 0; i < G_N_ELEMENTS (legacy_tags); i++)
+            if (content->tag_count[i] > 0)
+              {
+                g_string_append_printf (content->body, "<%c>", legacy_tags[i]);
+                content->open_tags[content->n_open_tags++] = legacy_tags[i];
+              }
+
+          continue;
+        }
+
+      if (*c == '<')
+        g_string_append (content->body, "&lt;");
+      else if (*c == '>')
+        g_string_append (content->body, "&gt;");
+      else if (*c == '&')
+        g_string_append (content->body, "&amp;");
+      else
+        g_string_append_c (content->body, *c);
+
+      content->at_line_start = *c == '\n';
+    }
+}
+
+static void
+gn_xml_note_toggle_legacy_tag (LegacyContent *content,
+                               gint           tag,
+                               gboolean       is_open)
+{
+  g_assert (content != NULL);
+  g_assert (tag >= 0 && tag < (gint)G_N_ELEMENTS (legacy_tags));
+
+  /*
+   * Only the outermost element of each kind is written, so that
+   * nested elements like <b>a<b>b</b></b> don’t end up as nested
+   * tags of the same kind, which we don’t support.  As the source
+   * is valid XML, the written tags are then nested properly.
+   */
+  if (is_open)
+    {
+      if (content->tag_count[tag]++ > 0 || !content->in_body)
+        return;
+
+      g_string_append_printf (content->body, "<%c>", legacy_tags[tag]);
+      content->open_tags[content->n_open_tags++] = legacy_tags[tag];
+    }
+  else
+    {
+      guint last_tag, i;
+
+      if (content->tag_count[tag] == 0 || --content->tag_count[tag] > 0)
+        return;
+
+      for (last_tag = 0; last_tag < content->n_open_tags; last_tag++)
+        if (content->open_tags[last_tag] == legacy_tags[tag])
+          break;
+
+      if (last_tag == content->n_open_tags)
+        return;
+
+      /*
+       * Tags continued from the title are reopened in a fixed order,
+       * so the tag may not be the innermost one.  Like in
+       * gn_xml_note_close_tag(), close the tags opened inside it
+       * first, and reopen them after closing the tag.
+       */
+      for (i = content->n_open_tags; i-- > last_tag;)
+        g_string_append_printf (content->body, "</%c>", content->open_tags[i]);
+
+      for (i = last_tag + 1; i < content->n_open_tags; i++)
+        g_string_append_printf (content->body, "<%c>", content->open_tags[i]);
+
+      memmove (content->open_tags + last_tag, content->open_tags + last_tag + 1,
+               content->n_open_tags - last_tag - 1);
+      content->n_open_tags--;
+    }
+}
+
+static void
+gn_xml_note_handle_legacy_element (LegacyContent *content,
+                                   const gchar   *name,
+                                   gboolean       is_open,
+                                   gboolean       is_empty)
+{
+  gint tag;
+
+  g_assert (content != NULL);
+  g_assert (name != NULL);
+
+  tag = gn_xml_note_get_legacy_tag (name);
+
+  if (tag >= 0)
+    {
+      if (!is_empty)
+        gn_xml_note_toggle_legacy_tag (content, tag, is_open);
+    }
+  else if (g_str_equal (name, "br"))
+    {
+      if (is_open)
+        gn_xml_note_append_legacy_text (content, "\n");
+    }
+  else if (g_str_equal (name, "div") ||
+           g_str_equal (name, "p") ||
+           g_str_equal (name, "li"))
+    {
+      /* Block elements (from old Bijiben HTML) begin in a new line */
+      if (!content->at_line_start)
+        gn_xml_note_append_legacy_text (content, "\n");
+    }
+}
+
+static void
+gn_xml_note_set_legacy_metadata (GnXmlNote     *self,
+                                 xmlTextReader *xml_reader,
+                                 const gchar   *name,
+                                 GnTagStore    *tag_store)
+{
+  g_autofree gchar *value = NULL;
+  const gchar *property = NULL;
+  gint64 unix_time;
+
+  g_assert (GN_IS_XML_NOTE (self));
+
+  /* Don’t read the string of containers like <text>, which can be huge */
+  if (!g_str_equal (name, "title") && !g_str_equal (name, "create-date") &&
+      !g_str_equal (name, "last-change-date") && !g_str_equal (name, "color") &&
+      !g_str_equal (name, "last-metadata-change-date") && !g_str_equal (name, "tag"))
+    return;
+
+  value = xml_reader_dup_string (xml_reader);
+
+  if (value == NULL || *value == '\0')
+    return;
+
+  if (g_str_equal (name, "title"))
+    gn_item_set_title (GN_ITEM (self), value);
+  else if (g_str_equal (name, "create-date"))
+    property = "creation-time";
+  else if (g_str_equal (name, "last-change-date"))
+    property = "modification-time";
+  else if (g_str_equal (name, "last-metadata-change-date"))
+    property = "meta-modification-time";
+  else if (g_str_equal (name, "color"))
+    {
+      GdkRGBA rgba;
+
+      if (gdk_rgba_parse (&rgba, value))
+        gn_item_set_rgba (GN_ITEM (self), &rgba);
+    }
+  else if (g_str_equal (name, "tag") && tag_store != NULL)
+    {
+      const gchar *tag_name = value;
+      GnTag *tag;
+
+      /* Tomboy notebooks are tags for us, other system tags are ignored */
+      if (g_str_has_prefix (tag_name, "system:notebook:"))
+        tag_name += strlen ("system:notebook:");
+      else if (g_str_has_prefix (tag_name, "system:"))
+        return;
+
+      tag = gn_tag_store_insert (tag_store, g_intern_string (tag_name), NULL);
+      self->tags = g_list_prepend (self->tags, tag);
+    }
+
+  if (property != NULL &&
+      gn_utils_iso_to_unix_time (value, -1, &unix_time))
+    g_object_set (G_OBJECT (self), property, unix_time, NULL);
+}
+
+/*
+ * Create a note in the current format from @data in any of the
+ * older Tomboy or Bijiben formats.  The XML is read as a stream,
+ * and the content is converted as it is read.  Format tags are
+ * mapped to our b, i, s and u tags, Bijiben HTML block elements
+ * are converted to new lines (like gn_utils_get_markup_from_bijiben()
+ * does) and the rest of the elements are dropped keeping the text.
+ */
+static GnXmlNote *
+gn_xml_note_new_from_legacy (const gchar  *data,
+                             gsize         length,
+                             GnTagStore   *tag_store,
+                             GError      **error)
+{
+  g_autoptr(GnXmlNote) self = NULL;
+  xmlTextReader *xml_reader;
+  LegacyContent content = { 0 };
+  const gchar *content_tag = NULL;
+  gsize content_start;
+  gint ret;
+
+  g_assert (data != NULL);
+
+  self = g_object_new (GN_TYPE_XML_NOTE, NULL);
+  content.title = g_string_new (NULL);
+  content.body = g_string_sized_new (length);
+  content.at_line_start = TRUE;
+
+  xml_reader = xml_reader_new (data, length);
+
+  while ((ret = xml_reader_read (xml_reader)) == 1)
+    {
+      const gchar *name = xml_reader_get_name (xml_reader);
+      gint node_type = xml_reader_get_node_type (xml_reader);
+
+      if (content_tag == NULL)
+        {
+          if (node_type != XML_READER_TYPE_ELEMENT || name == NULL)
+            continue;
+
+          /* Tomboy has the content in <note-content>, old Bijiben in <body> */
+          if ((g_str_equal (name, "note-content") || g_str_equal (name, "body")) &&
+              !xml_reader_is_empty_element (xml_reader))
+            content_tag = g_intern_string (name);
+          else
+            gn_xml_note_set_legacy_metadata (self, xml_reader, name, tag_store);
+
+          continue;
+        }
+
+      switch (node_type)
+        {
+        case XML_READER_TYPE_ELEMENT:
+          gn_xml_note_handle_legacy_element (&content, name, TRUE,
+                                             xml_reader_is_empty_element (xml_reader));
+          break;
+
+        case XML_READER_TYPE_END_ELEMENT:
+          if (g_intern_string (name) == content_tag)
+            content_tag = NULL;
+          else
+            gn_xml_note_handle_legacy_element (&content, name, FALSE, FALSE);
+          break;
+
+        case XML_READER_TYPE_TEXT:
+        case XML_READER_TYPE_CDATA:
+        case XML_READER_TYPE_WHITESPACE:
+        case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+          gn_xml_note_append_legacy_text (&content, xml_reader_get_value (xml_reader));
+          break;
+
+        default:
+          break;
+        }
+    }
+
+  xml_reader_free (xml_reader);
+
+  if (ret != 0)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                           "Failed to parse note");
+      g_string_free (content.title, TRUE);
+      g_string_free (content.body, TRUE);
+
+      return NULL;
+    }
+
+  /* Trailing new lines are of no use */
+  while (content.body->len > 0 &&
+         content.body->str[content.body->len - 1] == '\n')
+    g_string_truncate (content.body, content.body->len - 1);
+
+  while (content.n_open_tags > 0)
+    g_string_append_printf (content.body, "</%c>",
+                            content.open_tags[--content.n_open_tags]);
+
+  /* The first line of the content is the title */
+  if (content.title->len > 0)
+    gn_item_set_title (GN_ITEM (self), content.title->str);
+
+  self->tags = g_list_sort (self->tags, (GCompareFunc)gn_tag_compare);
+  self->parse_complete = 1;
+  self->is_legacy = 1;
+
+  gn_xml_note_update_raw_xml (self);
+  content_start = self->raw_xml->len;
+  g_string_append_len (self->raw_xml, content.body->str, content.body->len);
+  g_string_append (self->raw_xml, "</note-content></text></note>\n");
+  self->content_xml = self->raw_xml->str + content_start;
+
+  /* Created from the converted content when first required */
+  g_string_free (self->text_content, TRUE);
+  self->text_content = NULL;
+
+  g_string_free (content.title, TRUE);
+  g_string_free (content.body, TRUE);
+
+  return g_steal_pointer (&self);
+}
+
 /*
  * This is a stupid parser.  All we need to get is the
  * title, and the boundaries of note content.
@@ -1019,26 +2247,359 @@ gn_xml_note_create_from_data (const gchar *data,
 
   g_return_val_if_fail (note_format != NOTE_FORMAT_UNKNOWN, NULL);
 
+  if (note_format != NOTE_FORMAT_BIJIBEN_2)
+    {
+      g_autoptr(GError) error = NULL;
+
+      self = gn_xml_note_new_from_legacy (data, length, tag_store, &error);
+
+      if (error != NULL)
+        g_warning ("Failed to convert note: %s", error->message);
+
+      return g_steal_pointer (&self);
+    }
+
   self = g_object_new (GN_TYPE_XML_NOTE, NULL);
   self->note_format = note_format;
+  self->raw_xml = g_string_new_len (data, length);
+  self->content_xml = strstr (self->raw_xml->str, "<note-content>");
+
+  if (self->content_xml == NULL)
+    return NULL;
+
+  self->content_xml = self->content_xml + strlen ("<note-content>");
+  gn_xml_note_parse (self, self->raw_xml->str, self->raw_xml->len,
+                     tag_store);
 
-  if (note_format == NOTE_FORMAT_BIJIBEN_2)
+  return g_steal_pointer (&self);
+}
+
+/**
+ * gn_xml_note_get_metadata:
+ * @self: A #GnXmlNote
+ *
+ * Get the metadata of @self as a #GVariant of type
+ * %GN_XML_NOTE_METADATA_TYPE, containing the title, creation time,
+ * modification time, metadata modification time, color and the
+ * names of tags of @self.  This can be given to
+ * gn_xml_note_new_from_file() to create the same note again
+ * without reading the file.
+ *
+ * Only notes in the current Bijiben format has metadata.
+ * Notes converted from older formats has no metadata until
+ * saved, as the metadata doesn’t match the file.
+ *
+ * Returns: (transfer full) (nullable): a floating #GVariant
+ */
+GVariant *
+gn_xml_note_get_metadata (GnXmlNote *self)
+{
+  GVariantBuilder tags;
+  g_autofree gchar *color = NULL;
+  GnItem *item;
+  GdkRGBA rgba;
+
+  g_return_val_if_fail (GN_IS_XML_NOTE (self), NULL);
+
+  if (self->note_format != NOTE_FORMAT_BIJIBEN_2 || self->is_legacy ||
+      (self->raw_xml == NULL && !self->is_lazy))
+    return NULL;
+
+  item = GN_ITEM (self);
+
+  if (gn_item_get_rgba (item, &rgba))
+    color = gdk_rgba_to_string (&rgba);
+
+  g_variant_builder_init (&tags, G_VARIANT_TYPE_STRING_ARRAY);
+
+  for (GList *node = self->tags; node != NULL; node = node->next)
+    g_variant_builder_add (&tags, "s", gn_tag_get_name (node->data));
+
+  return g_variant_new (GN_XML_NOTE_METADATA_TYPE,
+                        gn_item_get_title (item),
+                        gn_item_get_creation_time (item),
+                        gn_item_get_modification_time (item),
+                        gn_item_get_meta_modification_time (item),
+                        color, &tags);
+}
+
+static void
+gn_xml_note_set_metadata (GnXmlNote  *self,
+                          GVariant   *metadata,
+                          GnTagStore *tag_store)
+{
+  g_autoptr(GVariantIter) tags = NULL;
+  const gchar *title, *color, *tag_name;
+  gint64 creation_time, modification_time, meta_modification_time;
+  GdkRGBA rgba;
+
+  g_assert (GN_IS_XML_NOTE (self));
+  g_assert (metadata != NULL);
+
+  self->parse_complete = 1;
+
+  g_variant_get (metadata, "(m&sxxxm&sas)", &title, &creation_time,
+                 &modification_time, &meta_modification_time,
+                 &color, &tags);
+
+  if (title != NULL)
+    gn_item_set_title (GN_ITEM (self), title);
+
+  g_object_set (G_OBJECT (self),
+                "creation-time", creation_time,
+                "modification-time", modification_time,
+                "meta-modification-time", meta_modification_time,
+                NULL);
+
+  if (color != NULL && gdk_rgba_parse (&rgba, color))
+    gn_item_set_rgba (GN_ITEM (self), &rgba);
+
+  while (tag_store != NULL && g_variant_iter_next (tags, "&s", &tag_name))
+    {
+      GnTag *tag;
+
+      tag = gn_tag_store_insert (tag_store, g_intern_string (tag_name), NULL);
+      self->tags = g_list_prepend (self->tags, tag);
+    }
+
+  self->tags = g_list_sort (self->tags, (GCompareFunc)gn_tag_compare);
+}
+
+static GnXmlNote *
+gn_xml_note_new_lazy (GFile *file)
+{
+  GnXmlNote *self;
+
+  g_assert (G_IS_FILE (file));
+
+  self = g_object_new (GN_TYPE_XML_NOTE, NULL);
+  self->is_lazy = TRUE;
+  g_string_free (self->text_content, TRUE);
+  self->text_content = NULL;
+  gn_xml_note_set_file (self, file);
+
+  return self;
+}
+
+/**
+ * gn_xml_note_new_from_file:
+ * @file: A #GFile
+ * @metadata: (nullable): A #GVariant of type %GN_XML_NOTE_METADATA_TYPE
+ * @tag_store: (nullable): A #GnTagStore
+ * @cancellable: (nullable): A #GCancellable
+ * @error: return location for a #GError, or %NULL
+ *
+ * Create a new XML note from @file, without loading the
+ * content of the note.  The content is loaded from @file
+ * only when it’s first required.  @file is set as the file
+ * of the note, see gn_xml_note_set_file().
+ *
+ * If @metadata is given, it’s used as the metadata of the
+ * note, and @file is not read at all.  Otherwise, only the
+ * part of @file until the beginning of note content is read
+ * to get the metadata.
+ *
+ * Notes in older formats are loaded in full.
+ *
+ * Returns: (transfer full) (nullable): a new #GnXmlNote.
+ * %NULL on error.
+ */
+GnXmlNote *
+gn_xml_note_new_from_file (GFile         *file,
+                           GVariant      *metadata,
+                           GnTagStore    *tag_store,
+                           GCancellable  *cancellable,
+                           GError       **error)
+{
+  g_autoptr(GnXmlNote) self = NULL;
+  g_autoptr(GFileInputStream) stream = NULL;
+  g_autoptr(GString) header = NULL;
+  gchar *content = NULL;
+  NoteFormat note_format;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (!metadata ||
+                        g_variant_is_of_type (metadata,
+                                              G_VARIANT_TYPE (GN_XML_NOTE_METADATA_TYPE)),
+                        NULL);
+
+  if (metadata != NULL)
+    {
+      self = gn_xml_note_new_lazy (file);
+      gn_xml_note_set_metadata (self, metadata, tag_store);
+
+      return g_steal_pointer (&self);
+    }
+
+  stream = g_file_read (file, cancellable, error);
+
+  if (stream == NULL)
+    return NULL;
+
+  header = g_string_sized_new (HEADER_CHUNK_SIZE);
+
+  /* Read until the beginning of note content */
+  while (content == NULL)
     {
-      self->raw_xml = g_string_new_len (data, length);
-      self->content_xml = strstr (self->raw_xml->str, "<note-content>");
+      gsize old_length = header->len;
+      gsize start;
+      gssize n_read;
+
+      g_string_set_size (header, old_length + HEADER_CHUNK_SIZE);
+      n_read = g_input_stream_read (G_INPUT_STREAM (stream),
+                                    header->str + old_length,
+                                    HEADER_CHUNK_SIZE, cancellable, error);
+      if (n_read < 0)
+        return NULL;
+
+      g_string_set_size (header, old_length + n_read);
+
+      if (n_read == 0)
+        break;
 
-      if (self->content_xml == NULL)
+      /* The tag may span across chunks */
+      start = old_length - MIN (old_length, strlen ("<note-content>"));
+      content = g_strstr_len (header->str + start, header->len - start,
+                              "<note-content>");
+    }
+
+  note_format = gn_xml_note_get_format (header->str, header->len);
+
+  if (note_format != NOTE_FORMAT_BIJIBEN_2)
+    {
+      g_autofree gchar *contents = NULL;
+      gsize length;
+
+      g_clear_object (&stream);
+
+      if (!g_file_load_contents (file, cancellable, &contents, &length,
+                                 NULL, error))
         return NULL;
 
-      self->content_xml = self->content_xml + strlen ("<note-content>");
-      gn_xml_note_parse (self, tag_store);
+      self = gn_xml_note_new_from_data (contents, length, tag_store);
+
+      if (self != NULL)
+        gn_xml_note_set_file (self, file);
+
+      return g_steal_pointer (&self);
     }
-  else
-    self->raw_data = g_string_new_len (data, length);
+
+  if (content == NULL)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                           "Note content not found");
+      return NULL;
+    }
+
+  /* Close the open tags so that the header is a valid XML */
+  g_string_truncate (header, content - header->str + strlen ("<note-content>"));
+  g_string_append (header, "</note-content></text></note>");
+
+  self = gn_xml_note_new_lazy (file);
+  gn_xml_note_parse (self, header->str, header->len, tag_store);
 
   return g_steal_pointer (&self);
 }
 
+/**
+ * gn_xml_note_set_file:
+ * @self: A #GnXmlNote
+ * @file: A #GFile
+ *
+ * Set @file as the file of @self, also as the "file" data
+ * of @self.  Lazily loaded notes read their content from
+ * @file in whichever thread the content is first required,
+ * so the file of an XML note should be changed only with
+ * this, never by setting the "file" data directly.
+ */
+void
+gn_xml_note_set_file (GnXmlNote *self,
+                      GFile     *file)
+{
+  g_return_if_fail (GN_IS_XML_NOTE (self));
+  g_return_if_fail (G_IS_FILE (file));
+
+  g_mutex_lock (&self->content_lock);
+  g_set_object (&self->file, file);
+  g_mutex_unlock (&self->content_lock);
+
+  g_object_set_data_full (G_OBJECT (self), "file", g_object_ref (file),
+                          g_object_unref);
+}
+
+/**
+ * gn_xml_note_is_legacy:
+ * @self: A #GnXmlNote
+ *
+ * Get if @self was converted from an older Tomboy or
+ * Bijiben format when loaded.  The file of such notes
+ * is still in the old format, until saved again, or
+ * converted with gn_xml_note_convert_legacy().
+ *
+ * Returns: %TRUE if @self was in an older format
+ */
+gboolean
+gn_xml_note_is_legacy (GnXmlNote *self)
+{
+  g_return_val_if_fail (GN_IS_XML_NOTE (self), FALSE);
+
+  return self->is_legacy;
+}
+
+/**
+ * gn_xml_note_convert_legacy:
+ * @data: The raw note content
+ * @length: The length of @data, or -1
+ * @error: return location for a #GError, or %NULL
+ *
+ * Convert the note @data in older Tomboy or Bijiben
+ * format to the current Bijiben format.  This can be
+ * called from any thread.
+ *
+ * Returns: (transfer full) (nullable): The converted
+ * note.  %NULL on error, or if @data is already in
+ * current format.  Free with g_free().
+ */
+gchar *
+gn_xml_note_convert_legacy (const gchar  *data,
+                            gsize         length,
+                            GError      **error)
+{
+  g_autoptr(GnXmlNote) self = NULL;
+  GnTagStore *tag_store;
+  NoteFormat note_format;
+  gchar *converted;
+
+  g_return_val_if_fail (data != NULL, NULL);
+
+  if (length == -1)
+    length = strlen (data);
+
+  note_format = gn_xml_note_get_format (data, length);
+
+  if (note_format == NOTE_FORMAT_UNKNOWN ||
+      note_format == NOTE_FORMAT_BIJIBEN_2)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "Not a note in older format");
+      return NULL;
+    }
+
+  /* The tags are required only to write the note */
+  tag_store = gn_tag_store_new ();
+  self = gn_xml_note_new_from_legacy (data, length, tag_store, error);
+
+  if (self != NULL)
+    converted = g_strdup (self->raw_xml->str);
+  else
+    converted = NULL;
+
+  g_clear_object (&self);
+  gn_tag_store_free (tag_store);
+
+  return converted;
+}
+
 /**
  * gn_xml_note_new_from_data:
  * @data (nullable): The raw note content
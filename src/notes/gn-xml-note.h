@@ -20,7 +20,7 @@
 
 #pragma once
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
 #include "gn-note.h"
 #include "gn-tag-store.h"
@@ -29,10 +29,25 @@ G_BEGIN_DECLS
 
 #define GN_TYPE_XML_NOTE (gn_xml_note_get_type ())
 
+/* title, creation time, modification time, metadata modification time, color, tags */
+#define GN_XML_NOTE_METADATA_TYPE "(msxxxmsas)"
+
 G_DECLARE_FINAL_TYPE (GnXmlNote, gn_xml_note, GN, XML_NOTE, GnNote)
 
-GnXmlNote *gn_xml_note_new_from_data (const gchar *text,
-                                      gsize        length,
-                                      GnTagStore  *tag_store);
+GnXmlNote *gn_xml_note_new_from_data     (const gchar   *text,
+                                          gsize          length,
+                                          GnTagStore    *tag_store);
+GnXmlNote *gn_xml_note_new_from_file     (GFile         *file,
+                                          GVariant      *metadata,
+                                          GnTagStore    *tag_store,
+                                          GCancellable  *cancellable,
+                                          GError       **error);
+GVariant  *gn_xml_note_get_metadata      (GnXmlNote     *self);
+void       gn_xml_note_set_file          (GnXmlNote     *self,
+                                          GFile         *file);
+gboolean   gn_xml_note_is_legacy         (GnXmlNote     *self);
+gchar     *gn_xml_note_convert_legacy    (const gchar   *data,
+                                          gsize          length,
+                                          GError       **error);
 
 G_END_DECLS
@@ -52,7 +52,7 @@ struct _GnGoaProvider
   GMount           *mount;
   GFile *note_dir;
 
-  GListStore *notes_store;
+  GnItemStore *notes_store;
 };
 
 G_DEFINE_TYPE (GnGoaProvider, gn_goa_provider, GN_TYPE_PROVIDER)
@@ -111,7 +111,7 @@ gn_goa_provider_get_location_name (GnProvider *provider)
   return self->location_name;
 }
 
-static GListStore *
+static GnItemStore *
 gn_goa_provider_get_notes (GnProvider *provider)
 {
   return GN_GOA_PROVIDER (provider)->notes_store;
@@ -234,7 +234,7 @@ gn_goa_provider_load_items (GnGoaProvider *self,
       g_object_set_data (G_OBJECT (note), "provider", GN_PROVIDER (self));
       g_object_set_data_full (G_OBJECT (note), "file", g_steal_pointer (&file),
                               g_object_unref);
-      g_list_store_append (self->notes_store, note);
+      gn_item_store_append (self->notes_store, GN_ITEM (note));
       /* self->notes = g_list_prepend (self->notes, note); */
     }
 
@@ -380,7 +380,7 @@ gn_goa_provider_class_init (GnGoaProviderClass *klass)
 static void
 gn_goa_provider_init (GnGoaProvider *self)
 {
-  self->notes_store = g_list_store_new (GN_TYPE_ITEM);
+  self->notes_store = gn_item_store_new ();
 }
 
 GnProvider *
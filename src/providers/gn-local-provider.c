@@ -51,7 +51,37 @@
  * The notebook names are stored in the file notebooks.xml in the same
  * directory. The unique ids of the notes in each notebook is also
  * added here.
+ *
+ * The metadata of the notes (both in the notes directory and trash)
+ * is cached in the file notes.index in the same directory, as a
+ * serialized GVariant of type INDEX_TYPE.  The entries are keyed by
+ * the uid of the note, and each entry is valid only if the modification
+ * time and size of the file matches the ones in the entry.  So that
+ * only the notes that are new or changed since the last run are parsed.
+ *
+ * Notes in older Tomboy and Bijiben formats are converted to the current
+ * format when loaded.  Once all notes are loaded, the files of such notes
+ * are converted in the background, so that they are loaded faster the
+ * next time.
+ */
+
+/* Upper limit on the number of threads used to parse notes */
+#define MAX_LOAD_THREADS 8
+
+/*
+ * Parsed notes are handed over to the main thread in batches.
+ * The first batch is small so that the first page can be shown
+ * as early as possible, each following batch doubles in size so
+ * that the number of model updates stays low for large corpora.
  */
+#define FIRST_LOAD_BATCH 32
+#define MAX_LOAD_BATCH   4096
+
+#define INDEX_FILE_NAME  "notes.index"
+#define INDEX_VERSION    1
+/* mtime in seconds, mtime microseconds, file size, metadata */
+#define INDEX_ENTRY_TYPE "(tut" GN_XML_NOTE_METADATA_TYPE ")"
+#define INDEX_TYPE       "(ua{s" INDEX_ENTRY_TYPE "})"
 
 struct _GnLocalProvider
 {
@@ -63,13 +93,73 @@ struct _GnLocalProvider
   gchar *location;
   gchar *trash_location;
 
-  GListStore *notes_store;
+  GnItemStore *notes_store;
   GnTagStore *tag_store;
-  GListStore *trash_store;
+  GnItemStore *trash_store;
+
+  /* Metadata index, used only while loading notes */
+  GHashTable *index;      /* uid -> entry read from the index file */
+  GHashTable *new_index;  /* uid -> entry for the notes loaded */
+  gboolean    index_changed;
+  /* GFile of notes in older formats found while loading */
+  GPtrArray  *legacy_files;
   /* GList *notes; */
   /* GList *trash_notes; */
 };
 
+/* Data shared with the workers loading notes from a directory */
+typedef struct
+{
+  GnLocalProvider *self;
+  GFile           *location;
+  /* GFileInfo of the note files, sorted by name */
+  GPtrArray       *file_infos;
+  GCancellable    *cancellable;
+  /* Parsed notes, in the same order as @file_infos */
+  GnXmlNote      **items;
+  /* Whether the worker is done with the file at the same index */
+  gboolean        *done;
+  GMutex           mutex;
+  GCond            cond;
+} LoadData;
+
+/* Data shared with the workers converting notes in older formats */
+typedef struct
+{
+  GPtrArray    *files;
+  GCancellable *cancellable;
+  gint64        start_time;
+  guint         n_done;     /* atomic */
+  guint         n_converted; /* atomic */
+} ConvertData;
+
+/* A note to be saved by a worker, to @file */
+typedef struct
+{
+  GnItem *item;
+  GFile  *file;
+} SaveData;
+
+/*
+ * Notes moved by a worker in one batch, each item at the
+ * same index as its file, and the file to be moved to.
+ */
+typedef struct
+{
+  GTask     *task;         /* The task of the caller */
+  GPtrArray *items;
+  GPtrArray *files;
+  GPtrArray *new_files;
+  guint      n_done;       /* Items done before an error, if any */
+} BatchData;
+
+/* A batch of notes to be appended to @store in the main thread */
+typedef struct
+{
+  GnItemStore *store;
+  GPtrArray   *notes;
+} PublishData;
+
 G_DEFINE_TYPE (GnLocalProvider, gn_local_provider, GN_TYPE_PROVIDER)
 
 static void
@@ -206,16 +296,328 @@ gn_local_provider_load_tags (GnLocalProvider *self,
   GN_EXIT;
 }
 
+static gboolean
+gn_local_provider_entry_is_valid (GVariant  *entry,
+                                  GFileInfo *file_info)
+{
+  guint64 mtime, size;
+  guint32 mtime_usec;
+
+  g_assert (G_IS_FILE_INFO (file_info));
+
+  if (entry == NULL)
+    return FALSE;
+
+  g_variant_get (entry, "(tut@" GN_XML_NOTE_METADATA_TYPE ")",
+                 &mtime, &mtime_usec, &size, NULL);
+
+  return mtime == g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED) &&
+    mtime_usec == g_file_info_get_attribute_uint32 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC) &&
+    size == (guint64)g_file_info_get_size (file_info);
+}
+
+/*
+ * Load the note at @index.  @entry is set to the index entry
+ * to be saved for the note, if any.
+ */
+static GnXmlNote *
+gn_local_provider_parse_file (LoadData  *load_data,
+                              guint      index,
+                              GVariant **entry)
+{
+  GnLocalProvider *self;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GVariant) metadata = NULL;
+  g_autofree gchar *uid = NULL;
+  GFileInfo *file_info;
+  const gchar *name;
+  GnXmlNote *note;
+  GVariant *cached;
+
+  g_assert (load_data != NULL);
+  g_assert (index < load_data->file_infos->len);
+  g_assert (entry != NULL);
+
+  self = load_data->self;
+  *entry = NULL;
+
+  if (g_cancellable_is_cancelled (load_data->cancellable))
+    return NULL;
+
+  file_info = g_ptr_array_index (load_data->file_infos, index);
+  name = g_file_info_get_name (file_info);
+  file = g_file_get_child (load_data->location, name);
+
+  /* strip the extension to get the uid */
+  uid = g_strndup (name, strlen (name) - strlen (".note"));
+
+  /* @self->index isn’t modified while loading, so no locking required */
+  cached = g_hash_table_lookup (self->index, uid);
+
+  /*
+   * The notes are created lazily, the content is loaded only when
+   * required.  If the index entry is valid, the file isn’t read.
+   */
+  if (gn_local_provider_entry_is_valid (cached, file_info))
+    {
+      metadata = g_variant_get_child_value (cached, 3);
+      note = gn_xml_note_new_from_file (file, metadata, self->tag_store,
+                                        load_data->cancellable, NULL);
+      if (note != NULL)
+        *entry = g_variant_ref (cached);
+    }
+  else
+    {
+      note = gn_xml_note_new_from_file (file, NULL, self->tag_store,
+                                        load_data->cancellable, NULL);
+
+      if (note != NULL)
+        metadata = gn_xml_note_get_metadata (note);
+
+      if (metadata != NULL)
+        {
+          g_variant_ref_sink (metadata);
+          *entry = g_variant_new ("(tut@" GN_XML_NOTE_METADATA_TYPE ")",
+                                  g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                                  g_file_info_get_attribute_uint32 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC),
+                                  (guint64)g_file_info_get_size (file_info),
+                                  metadata);
+          g_variant_ref_sink (*entry);
+        }
+    }
+
+  if (note == NULL)
+    return NULL;
+
+  /* The "file" data is set by the note */
+  gn_item_set_uid (GN_ITEM (note), uid);
+  g_object_set_data (G_OBJECT (note), "provider", self);
+
+  return note;
+}
+
+static void
+gn_local_provider_load_file (gpointer data,
+                             gpointer user_data)
+{
+  LoadData *load_data = user_data;
+  GnLocalProvider *self;
+  GnXmlNote *note;
+  GVariant *entry;
+  guint index;
+
+  g_assert (load_data != NULL);
+
+  self = load_data->self;
+  /* Indices are pushed with an offset of 1 as the pool doesn’t accept NULL */
+  index = GPOINTER_TO_UINT (data) - 1;
+  note = gn_local_provider_parse_file (load_data, index, &entry);
+
+  g_mutex_lock (&load_data->mutex);
+
+  if (note != NULL && gn_xml_note_is_legacy (note))
+    g_ptr_array_add (self->legacy_files,
+                     g_object_ref (g_object_get_data (G_OBJECT (note), "file")));
+
+  if (entry != NULL)
+    {
+      if (entry != g_hash_table_lookup (self->index, gn_item_get_uid (GN_ITEM (note))))
+        self->index_changed = TRUE;
+
+      g_hash_table_insert (self->new_index,
+                           g_strdup (gn_item_get_uid (GN_ITEM (note))),
+                           entry);
+    }
+
+  load_data->items[index] = note;
+  load_data->done[index] = TRUE;
+  g_cond_signal (&load_data->cond);
+  g_mutex_unlock (&load_data->mutex);
+}
+
+static void
+publish_data_free (gpointer user_data)
+{
+  PublishData *publish_data = user_data;
+
+  g_object_unref (publish_data->store);
+  g_ptr_array_unref (publish_data->notes);
+  g_slice_free (PublishData, publish_data);
+}
+
+static gboolean
+gn_local_provider_publish_cb (gpointer user_data)
+{
+  PublishData *publish_data = user_data;
+  GnItemStore *store = publish_data->store;
+  GPtrArray *notes = publish_data->notes;
+
+  g_assert (GN_IS_MAIN_THREAD ());
+
+  gn_item_store_splice (store, g_list_model_get_n_items (G_LIST_MODEL (store)),
+                        0, notes->pdata, notes->len);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gn_local_provider_publish (GMainContext *context,
+                           GnItemStore  *store,
+                           GPtrArray    *notes)
+{
+  PublishData *publish_data;
+
+  g_assert (GN_IS_ITEM_STORE (store));
+  g_assert (notes != NULL);
+
+  if (notes->len == 0)
+    return;
+
+  publish_data = g_slice_new (PublishData);
+  publish_data->store = g_object_ref (store);
+  publish_data->notes = g_ptr_array_ref (notes);
+
+  g_main_context_invoke_full (context, G_PRIORITY_DEFAULT,
+                              gn_local_provider_publish_cb,
+                              publish_data, publish_data_free);
+}
+
+static gint
+gn_local_provider_compare_names (gconstpointer a,
+                                 gconstpointer b)
+{
+  GFileInfo *info_a = *(GFileInfo **)a;
+  GFileInfo *info_b = *(GFileInfo **)b;
+
+  return strcmp (g_file_info_get_name (info_a), g_file_info_get_name (info_b));
+}
+
+static void
+gn_local_provider_load_index (GnLocalProvider *self)
+{
+  g_autoptr(GMappedFile) mapped_file = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GVariant) index = NULL;
+  g_autoptr(GVariant) entries = NULL;
+  g_autofree gchar *file_name = NULL;
+  GVariantIter iter;
+  const gchar *uid;
+  GVariant *entry;
+  guint32 version;
+
+  GN_ENTRY;
+
+  g_assert (GN_IS_LOCAL_PROVIDER (self));
+
+  self->index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify)g_variant_unref);
+  self->new_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify)g_variant_unref);
+  self->index_changed = FALSE;
+
+  file_name = g_build_filename (self->location, INDEX_FILE_NAME, NULL);
+  mapped_file = g_mapped_file_new (file_name, FALSE, NULL);
+
+  if (mapped_file == NULL)
+    GN_EXIT;
+
+  bytes = g_mapped_file_get_bytes (mapped_file);
+  index = g_variant_new_from_bytes (G_VARIANT_TYPE (INDEX_TYPE), bytes, FALSE);
+  g_variant_ref_sink (index);
+  g_variant_get_child (index, 0, "u", &version);
+
+  /* The index may have been written on a machine with different endianness */
+  if (version == GUINT32_SWAP_LE_BE (INDEX_VERSION))
+    {
+      GVariant *swapped;
+
+      swapped = g_variant_byteswap (index);
+      g_variant_unref (index);
+      index = swapped;
+      version = INDEX_VERSION;
+    }
+
+  if (version != INDEX_VERSION)
+    {
+      g_debug ("Ignoring index of unknown version %u", version);
+      GN_EXIT;
+    }
+
+  entries = g_variant_get_child_value (index, 1);
+  g_variant_iter_init (&iter, entries);
+
+  while (g_variant_iter_next (&iter, "{&s@" INDEX_ENTRY_TYPE "}", &uid, &entry))
+    g_hash_table_insert (self->index, g_strdup (uid), entry);
+
+  g_debug ("%u entries loaded from index", g_hash_table_size (self->index));
+
+  GN_EXIT;
+}
+
+static void
+gn_local_provider_save_index (GnLocalProvider *self)
+{
+  g_autoptr(GVariant) index = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *file_name = NULL;
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  gpointer uid, entry;
+
+  GN_ENTRY;
+
+  g_assert (GN_IS_LOCAL_PROVIDER (self));
+
+  /*
+   * If no entry is changed or added, the index is outdated only
+   * if some notes were removed.
+   */
+  if (!self->index_changed &&
+      g_hash_table_size (self->new_index) == g_hash_table_size (self->index))
+    GN_EXIT;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{s" INDEX_ENTRY_TYPE "}"));
+  g_hash_table_iter_init (&iter, self->new_index);
+
+  while (g_hash_table_iter_next (&iter, &uid, &entry))
+    g_variant_builder_add (&builder, "{s@" INDEX_ENTRY_TYPE "}", uid, entry);
+
+  index = g_variant_new ("(ua{s" INDEX_ENTRY_TYPE "})", INDEX_VERSION, &builder);
+  g_variant_ref_sink (index);
+
+  file_name = g_build_filename (self->location, INDEX_FILE_NAME, NULL);
+
+  if (!g_file_set_contents (file_name, g_variant_get_data (index),
+                            g_variant_get_size (index), &error))
+    g_warning ("Failed to save index: %s", error->message);
+  else
+    g_debug ("%u entries saved to index", g_hash_table_size (self->new_index));
+
+  GN_EXIT;
+}
+
+/*
+ * Load the notes in @path, and append them to @store in batches.
+ * @store is modified only in @context, and so the notes in the first
+ * batches can be shown before the rest of the files are parsed.
+ */
 static void
 gn_local_provider_load_path (GnLocalProvider  *self,
                              const gchar      *path,
-                             GListStore       *store,
+                             GnItemStore      *store,
+                             GMainContext     *context,
                              GCancellable     *cancellable,
                              GError          **error)
 {
   g_autoptr(GFileEnumerator) enumerator = NULL;
   g_autoptr(GFile) location = NULL;
+  g_autoptr(GPtrArray) file_infos = NULL;
+  GThreadPool *pool;
+  LoadData load_data = { 0 };
   gpointer file_info_ptr;
+  guint n_threads;
+  guint batch_size = FIRST_LOAD_BATCH;
+  guint next = 0;
 
   GN_ENTRY;
 
@@ -226,47 +628,238 @@ gn_local_provider_load_path (GnLocalProvider  *self,
   location = g_file_new_for_path (path);
   enumerator = g_file_enumerate_children (location,
                                           G_FILE_ATTRIBUTE_STANDARD_NAME","
-                                          G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+                                          G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE","
+                                          G_FILE_ATTRIBUTE_STANDARD_SIZE","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
                                           G_FILE_QUERY_INFO_NONE,
                                           cancellable,
                                           error);
   if (*error != NULL)
     GN_EXIT;
 
+  file_infos = g_ptr_array_new_with_free_func (g_object_unref);
+
   while ((file_info_ptr = g_file_enumerator_next_file (enumerator, cancellable, NULL)))
     {
       g_autoptr(GFileInfo) file_info = file_info_ptr;
-      g_autoptr(GFile) file = NULL;
-      g_autofree gchar *contents = NULL;
-      g_autofree gchar *file_name = NULL;
-      GnXmlNote *note;
       const gchar *name;
-      gchar *end;
 
       name = g_file_info_get_name (file_info);
 
-      if (!g_str_has_suffix (name, ".note"))
-        continue;
+      if (g_str_has_suffix (name, ".note"))
+        g_ptr_array_add (file_infos, g_steal_pointer (&file_info));
+    }
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    GN_EXIT;
+
+  /*
+   * The directory enumeration order is undefined.  Sort the names
+   * so that the notes end up in the same order in every run,
+   * irrespective of the order the workers complete.
+   */
+  g_ptr_array_sort (file_infos, gn_local_provider_compare_names);
+
+  load_data.self = self;
+  load_data.location = location;
+  load_data.file_infos = file_infos;
+  load_data.cancellable = cancellable;
+  load_data.items = g_new0 (GnXmlNote *, file_infos->len);
+  load_data.done = g_new0 (gboolean, file_infos->len);
+  g_mutex_init (&load_data.mutex);
+  g_cond_init (&load_data.cond);
+
+  n_threads = CLAMP (g_get_num_processors (), 1, MAX_LOAD_THREADS);
+  n_threads = MIN (n_threads, MAX (file_infos->len, 1));
+  pool = g_thread_pool_new (gn_local_provider_load_file, &load_data,
+                            n_threads, FALSE, NULL);
+
+  for (guint i = 0; i < file_infos->len; i++)
+    g_thread_pool_push (pool, GUINT_TO_POINTER (i + 1), NULL);
+
+  /*
+   * Workers may complete in any order.  Publish the notes in file
+   * name order as soon as every file in the next batch is handled.
+   */
+  while (next < file_infos->len &&
+         !g_cancellable_is_cancelled (cancellable))
+    {
+      g_autoptr(GPtrArray) notes = NULL;
+      guint end;
+
+      end = MIN (next + batch_size, file_infos->len);
+      notes = g_ptr_array_new_full (end - next, g_object_unref);
+
+      g_mutex_lock (&load_data.mutex);
+      for (; next < end; next++)
+        {
+          while (!load_data.done[next])
+            g_cond_wait (&load_data.cond, &load_data.mutex);
+
+          if (load_data.items[next] != NULL)
+            g_ptr_array_add (notes, g_steal_pointer (&load_data.items[next]));
+        }
+      g_mutex_unlock (&load_data.mutex);
+
+      gn_local_provider_publish (context, store, notes);
+      batch_size = MIN (batch_size * 2, MAX_LOAD_BATCH);
+    }
+
+  /* Wait for every queued file to be handled */
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  /* Free the notes left unpublished, if cancelled */
+  for (guint i = next; i < file_infos->len; i++)
+    g_clear_object (&load_data.items[i]);
+
+  g_mutex_clear (&load_data.mutex);
+  g_cond_clear (&load_data.cond);
+  g_free (load_data.items);
+  g_free (load_data.done);
 
-      file_name = g_strdup (name);
-      end = g_strrstr (file_name, ".");
-      *end = '\0';
-      file = g_file_get_child (location, name);
-      g_file_load_contents (file, cancellable, &contents, NULL, NULL, NULL);
+  g_cancellable_set_error_if_cancelled (cancellable, error);
 
-      note = gn_xml_note_new_from_data (contents, -1, self->tag_store);
+  GN_EXIT;
+}
+
+static void
+convert_data_free (gpointer user_data)
+{
+  ConvertData *convert_data = user_data;
+
+  g_ptr_array_unref (convert_data->files);
+  g_clear_object (&convert_data->cancellable);
+  g_slice_free (ConvertData, convert_data);
+}
 
-      if (note == NULL)
-        continue;
+static void
+gn_local_provider_convert_file (gpointer data,
+                                gpointer user_data)
+{
+  ConvertData *convert_data = user_data;
+  GFile *file = data;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *contents = NULL;
+  g_autofree gchar *converted = NULL;
+  g_autofree gchar *etag = NULL;
+  gsize length;
+  guint n_done;
+
+  g_assert (convert_data != NULL);
+  g_assert (G_IS_FILE (file));
+
+  if (g_cancellable_is_cancelled (convert_data->cancellable))
+    return;
+
+  if (g_file_load_contents (file, convert_data->cancellable, &contents,
+                            &length, &etag, &error))
+    converted = gn_xml_note_convert_legacy (contents, length, &error);
+
+  /*
+   * The file is replaced atomically, and only if it’s not modified
+   * since we read it (eg: if the user saved the note meanwhile).
+   */
+  if (converted != NULL &&
+      g_file_replace_contents (file, converted, strlen (converted), etag,
+                               FALSE, G_FILE_CREATE_NONE, NULL,
+                               convert_data->cancellable, &error))
+    g_atomic_int_inc (&convert_data->n_converted);
+
+  if (error != NULL &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WRONG_ETAG))
+    {
+      g_autofree gchar *path = g_file_get_path (file);
 
-      gn_item_set_uid (GN_ITEM (note), file_name);
-      g_object_set_data (G_OBJECT (note), "provider", GN_PROVIDER (self));
-      g_object_set_data_full (G_OBJECT (note), "file", g_steal_pointer (&file),
-                              g_object_unref);
-      /* FIXME: Use g_list_store_splice? */
-      g_list_store_append (store, note);
-      /* *items = g_list_prepend (*items, note); */
+      g_warning ("Failed to convert note %s: %s", path, error->message);
     }
+
+  n_done = g_atomic_int_add (&convert_data->n_done, 1) + 1;
+
+  if (n_done % 100 == 0)
+    g_debug ("Converted %u of %u notes", n_done, convert_data->files->len);
+}
+
+static void
+gn_local_provider_convert_notes (GTask        *task,
+                                 gpointer      source_object,
+                                 gpointer      task_data,
+                                 GCancellable *cancellable)
+{
+  ConvertData *convert_data = task_data;
+  GThreadPool *pool;
+  gdouble elapsed;
+  guint n_threads;
+
+  GN_ENTRY;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (convert_data != NULL);
+
+  n_threads = CLAMP (g_get_num_processors (), 1, MAX_LOAD_THREADS);
+  n_threads = MIN (n_threads, convert_data->files->len);
+  pool = g_thread_pool_new (gn_local_provider_convert_file, convert_data,
+                            n_threads, FALSE, NULL);
+
+  for (guint i = 0; i < convert_data->files->len; i++)
+    g_thread_pool_push (pool, g_ptr_array_index (convert_data->files, i), NULL);
+
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  elapsed = (g_get_monotonic_time () - convert_data->start_time) / (gdouble)G_USEC_PER_SEC;
+  g_debug ("Converted %u of %u notes in %.3f seconds (%.1f notes/s)",
+           convert_data->n_converted, convert_data->files->len, elapsed,
+           elapsed > 0 ? convert_data->n_converted / elapsed : 0.0);
+
+  if (g_task_return_error_if_cancelled (task))
+    GN_EXIT;
+
+  g_task_return_boolean (task, TRUE);
+
+  GN_EXIT;
+}
+
+static void
+gn_local_provider_convert_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  g_autoptr(GError) error = NULL;
+
+  if (!g_task_propagate_boolean (G_TASK (result), &error) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    g_warning ("Failed to convert notes: %s", error->message);
+}
+
+/*
+ * Convert the files of notes in older formats to current format,
+ * in a batch job run in a pool of threads.
+ */
+static void
+gn_local_provider_convert_notes_async (GnLocalProvider *self,
+                                       GPtrArray       *files,
+                                       GCancellable    *cancellable)
+{
+  g_autoptr(GTask) task = NULL;
+  ConvertData *convert_data;
+
+  g_assert (GN_IS_LOCAL_PROVIDER (self));
+  g_assert (files != NULL);
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  g_debug ("Converting %u notes in older formats", files->len);
+
+  convert_data = g_slice_new0 (ConvertData);
+  convert_data->files = g_ptr_array_ref (files);
+  convert_data->start_time = g_get_monotonic_time ();
+  if (cancellable)
+    convert_data->cancellable = g_object_ref (cancellable);
+
+  task = g_task_new (self, cancellable, gn_local_provider_convert_cb, NULL);
+  g_task_set_source_tag (task, gn_local_provider_convert_notes_async);
+  g_task_set_task_data (task, convert_data, convert_data_free);
+  g_task_run_in_thread (task, gn_local_provider_convert_notes);
 }
 
 static void
@@ -276,26 +869,39 @@ gn_local_provider_load_notes (GTask        *task,
                               GCancellable *cancellable)
 {
   GnLocalProvider *self = source_object;
+  GMainContext *context;
   GError *error = NULL;
 
   g_assert (G_IS_TASK (task));
   g_assert (GN_IS_LOCAL_PROVIDER (self));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
+  context = g_task_get_context (task);
+
   gn_local_provider_load_tags (self, cancellable);
+  gn_local_provider_load_index (self);
+  self->legacy_files = g_ptr_array_new_with_free_func (g_object_unref);
   gn_local_provider_load_path (self, self->location,
-                               self->notes_store,
+                               self->notes_store, context,
                                cancellable, &error);
 
-  if (error)
-    {
-      g_task_return_error (task, error);
-      return;
-    }
+  if (error == NULL)
+    gn_local_provider_load_path (self, self->trash_location,
+                                 self->trash_store, context,
+                                 cancellable, &error);
+
+  /* Save the index only if every note is handled */
+  if (error == NULL)
+    gn_local_provider_save_index (self);
+
+  if (error == NULL && self->legacy_files->len > 0)
+    gn_local_provider_convert_notes_async (self, self->legacy_files, cancellable);
+
+  g_clear_pointer (&self->legacy_files, g_ptr_array_unref);
+
+  g_clear_pointer (&self->index, g_hash_table_unref);
+  g_clear_pointer (&self->new_index, g_hash_table_unref);
 
-  gn_local_provider_load_path (self, self->trash_location,
-                               self->trash_store,
-                               cancellable, &error);
   if (error)
     g_task_return_error (task, error);
   else
@@ -319,43 +925,84 @@ gn_local_provider_load_items_async (GnProvider          *provider,
   g_task_run_in_thread (task, gn_local_provider_load_notes);
 }
 
+/*
+ * Lazily loaded XML notes read their file in whichever thread
+ * their content is required, so it's changed under their lock.
+ */
+static void
+gn_local_provider_set_file (GnItem *item,
+                            GFile  *file)
+{
+  g_assert (GN_IS_ITEM (item));
+  g_assert (G_IS_FILE (file));
+
+  if (GN_IS_XML_NOTE (item))
+    gn_xml_note_set_file (GN_XML_NOTE (item), file);
+  else
+    g_object_set_data_full (G_OBJECT (item), "file", g_object_ref (file),
+                            g_object_unref);
+}
+
+/* Get a new file in the notes directory for @item */
+static GFile *
+gn_local_provider_get_new_file (GnLocalProvider *self,
+                                GnItem          *item)
+{
+  g_autofree gchar *uuid = NULL;
+  g_autofree gchar *file_name = NULL;
+
+  g_assert (GN_IS_LOCAL_PROVIDER (self));
+  g_assert (GN_IS_NOTE (item));
+
+  uuid = g_uuid_string_random ();
+  file_name = g_strconcat (uuid, gn_note_get_extension (GN_NOTE (item)), NULL);
+
+  return g_file_new_build_filename (self->location, file_name, NULL);
+}
+
+static void
+save_data_free (gpointer data)
+{
+  SaveData *save_data = data;
+
+  g_object_unref (save_data->item);
+  g_clear_object (&save_data->file);
+  g_slice_free (SaveData, save_data);
+}
+
 static void
 gn_local_provider_save_note (GnLocalProvider *self,
                              GnItem          *item,
+                             GFile           *file,
                              GTask           *task,
                              GCancellable    *cancellable)
 {
-  GFile *file;
   g_autofree gchar *content = NULL;
   gchar *full_content;
   g_autoptr(GError) error = NULL;
 
   g_assert (GN_IS_LOCAL_PROVIDER (self));
   g_assert (GN_IS_ITEM (item));
+  g_assert (G_IS_FILE (file));
   g_assert (G_IS_TASK (task));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  file = g_object_get_data (G_OBJECT (item), "file");
+  /* Lazily loaded notes may read the file here */
   content = gn_note_get_raw_content (GN_NOTE (item));
 
+  /* Don’t overwrite the file if the note content failed to load */
+  if (content == NULL && GN_IS_XML_NOTE (item))
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                               "Failed to load note content");
+      return;
+    }
+
   if (content)
     full_content = content;
   else
     full_content = "";
 
-  if (file == NULL)
-    {
-      g_autofree gchar *uuid = NULL;
-      g_autofree gchar *file_name = NULL;
-
-      uuid = g_uuid_string_random ();
-      file_name = g_strconcat (uuid, gn_note_get_extension (GN_NOTE (item)), NULL);
-      file = g_file_new_build_filename (g_get_user_data_dir (),
-                                        "gnome-notes", file_name, NULL);
-      g_object_set_data_full (G_OBJECT (item), "file", file,
-                              g_object_unref);
-    }
-
   g_file_replace_contents (file, full_content, strlen (full_content),
                            NULL, FALSE, 0, NULL, NULL, &error);
 
@@ -372,17 +1019,18 @@ gn_local_provider_real_save_item (GTask        *task,
                                   GCancellable *cancellable)
 {
   GnLocalProvider *self = source_object;
-  GnItem *item = task_data;
+  SaveData *save_data = task_data;
 
   GN_ENTRY;
 
   g_assert (G_IS_TASK (task));
   g_assert (GN_IS_LOCAL_PROVIDER (self));
-  g_assert (GN_IS_ITEM (item));
+  g_assert (GN_IS_ITEM (save_data->item));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
-  if (GN_IS_NOTE (item))
-    gn_local_provider_save_note (self, item, task, cancellable);
+  if (GN_IS_NOTE (save_data->item))
+    gn_local_provider_save_note (self, save_data->item, save_data->file,
+                                 task, cancellable);
   GN_EXIT;
 }
 
@@ -395,6 +1043,8 @@ gn_local_provider_save_item_async (GnProvider          *provider,
 {
   GnLocalProvider *self = (GnLocalProvider *)provider;
   g_autoptr(GTask) task = NULL;
+  SaveData *save_data;
+  GFile *file;
 
   GN_ENTRY;
 
@@ -402,14 +1052,51 @@ gn_local_provider_save_item_async (GnProvider          *provider,
   g_assert (GN_IS_ITEM (item));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
+  /* The "file" data is only read and changed in the main thread */
+  file = g_object_get_data (G_OBJECT (item), "file");
+
+  if (file == NULL && GN_IS_NOTE (item))
+    {
+      g_autoptr(GFile) new_file = NULL;
+
+      new_file = gn_local_provider_get_new_file (self, item);
+      gn_local_provider_set_file (item, new_file);
+      file = new_file;
+    }
+
+  save_data = g_slice_new (SaveData);
+  save_data->item = g_object_ref (item);
+  save_data->file = file ? g_object_ref (file) : NULL;
+
   task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, gn_local_provider_save_item_async);
-  g_task_set_task_data (task, g_object_ref (item), g_object_unref);
+  g_task_set_task_data (task, save_data, save_data_free);
   g_task_run_in_thread (task, gn_local_provider_real_save_item);
 
   GN_EXIT;
 }
 
+static void
+gn_local_provider_set_uid_from_file (GnItem *item)
+{
+  g_autofree gchar *file_name = NULL;
+  GFile *file;
+  gchar *end;
+
+  g_assert (GN_IS_ITEM (item));
+
+  file = g_object_get_data (G_OBJECT (item), "file");
+  g_assert (file != NULL);
+  file_name = g_file_get_basename (file);
+  end = g_strrstr (file_name, ".");
+
+  /* strip the extension to get the uid */
+  if (end != NULL)
+    *end = '\0';
+
+  gn_item_set_uid (item, file_name);
+}
+
 static gboolean
 gn_local_provider_save_item_finish (GnProvider    *provider,
                                     GAsyncResult  *result,
@@ -424,44 +1111,43 @@ gn_local_provider_save_item_finish (GnProvider    *provider,
   if (!ret)
     return ret;
 
-  item = g_task_get_task_data (G_TASK (result));
+  item = ((SaveData *)g_task_get_task_data (G_TASK (result)))->item;
   g_signal_emit_by_name (self, "item-added", item);
 
   if (gn_item_is_new (item))
     {
-      GFile *file;
-      g_autofree gchar *file_name = NULL;
-      gchar *end;
-
       if (GN_IS_NOTE (item))
         {
-          file = g_object_get_data (G_OBJECT (item), "file");
-          g_assert (file != NULL);
-          file_name = g_file_get_basename (file);
-          end = g_strrstr (file_name, ".");
-
-          /* strip the extension to get the uid */
-          if (end != NULL)
-            *end = '\0';
-
-          gn_item_set_uid (item, file_name);
-          g_list_store_insert_sorted (self->notes_store, item,
-                                      gn_item_compare, NULL);
+          gn_local_provider_set_uid_from_file (item);
+          gn_item_store_insert_sorted (self->notes_store, item,
+                                       gn_item_compare, NULL);
         }
     }
   else
     {
-      guint position;
-
-      if (gn_utils_get_item_position (G_LIST_MODEL (self->notes_store), item, &position))
-        g_list_model_items_changed (G_LIST_MODEL (self->notes_store), position, 1, 1);
-      else if (gn_utils_get_item_position (G_LIST_MODEL (self->trash_store), item, &position))
-        g_list_model_items_changed (G_LIST_MODEL (self->trash_store), position, 1, 1);
+      if (!gn_item_store_item_changed (self->notes_store, item))
+        gn_item_store_item_changed (self->trash_store, item);
     }
 
   return ret;
 }
 
+static GFile *
+gn_local_provider_get_trash_file (GnLocalProvider *self,
+                                  GFile           *file)
+{
+  g_autofree gchar *base_name = NULL;
+  g_autofree gchar *trash_file_name = NULL;
+
+  g_assert (GN_IS_LOCAL_PROVIDER (self));
+  g_assert (G_IS_FILE (file));
+
+  base_name = g_file_get_basename (file);
+  trash_file_name = g_build_filename (self->trash_location, base_name, NULL);
+
+  return g_file_new_for_path (trash_file_name);
+}
+
 static gboolean
 gn_local_provider_trash_item (GnProvider    *provider,
                               GnItem        *item,
@@ -469,10 +1155,8 @@ gn_local_provider_trash_item (GnProvider    *provider,
                               GError       **error)
 {
   GnLocalProvider *self = (GnLocalProvider *)provider;
-  g_autofree gchar *base_name = NULL;
-  g_autofree gchar *trash_file_name = NULL;
+  g_autoptr(GFile) trash_file = NULL;
   GFile *file;
-  GFile *trash_file;
   gboolean success;
 
   GN_ENTRY;
@@ -482,28 +1166,240 @@ gn_local_provider_trash_item (GnProvider    *provider,
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
   file = g_object_get_data (G_OBJECT (item), "file");
-  base_name = g_file_get_basename (file);
-  trash_file_name = g_build_filename (self->trash_location, base_name, NULL);
-  trash_file = g_file_new_for_path (trash_file_name);
+  trash_file = gn_local_provider_get_trash_file (self, file);
 
   success = g_file_move (file, trash_file, G_FILE_COPY_NONE,
-                         NULL, NULL, NULL, error);
+                         cancellable, NULL, NULL, error);
 
   if (!success)
     GN_RETURN (success);
 
-  g_object_set_data_full (G_OBJECT (item), "file", trash_file_name,
-                          g_object_unref);
+  /* Lazily loaded notes read their content from this file */
+  gn_local_provider_set_file (item, trash_file);
   /* self->notes = g_list_remove (self->notes, item); */
-  g_list_store_insert_sorted (self->trash_store, item,
-                              gn_item_compare, NULL);
+  gn_item_store_insert_sorted (self->trash_store, item,
+                               gn_item_compare, NULL);
   /* self->trash_notes = g_list_prepend (self->trash_notes, item); */
   g_signal_emit_by_name (provider, "item-trashed", item);
 
   GN_RETURN (success);
 }
 
-static GListStore *
+static void
+batch_data_free (gpointer data)
+{
+  BatchData *batch_data = data;
+
+  g_clear_object (&batch_data->task);
+  g_ptr_array_unref (batch_data->items);
+  g_ptr_array_unref (batch_data->files);
+  g_ptr_array_unref (batch_data->new_files);
+  g_slice_free (BatchData, batch_data);
+}
+
+static BatchData *
+batch_data_new (GnLocalProvider     *self,
+                guint                n_items,
+                GCancellable        *cancellable,
+                GAsyncReadyCallback  callback,
+                gpointer             user_data,
+                gpointer             source_tag)
+{
+  BatchData *batch_data;
+
+  batch_data = g_slice_new0 (BatchData);
+  batch_data->task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (batch_data->task, source_tag);
+  batch_data->items = g_ptr_array_new_full (n_items, g_object_unref);
+  batch_data->files = g_ptr_array_new_full (n_items, g_object_unref);
+  batch_data->new_files = g_ptr_array_new_full (n_items, g_object_unref);
+
+  return batch_data;
+}
+
+/*
+ * The "file" data is only read and changed in the main thread,
+ * so the files are found here and handed over to the worker.
+ */
+static void
+gn_local_provider_add_batch_item (BatchData *batch_data,
+                                  GnItem    *item)
+{
+  GFile *file;
+
+  g_assert (GN_IS_ITEM (item));
+
+  file = g_object_get_data (G_OBJECT (item), "file");
+  g_assert (file != NULL);
+
+  g_ptr_array_add (batch_data->items, g_object_ref (item));
+  g_ptr_array_add (batch_data->files, g_object_ref (file));
+}
+
+/* Lazily loaded notes read their content from the "file" data */
+static void
+gn_local_provider_update_files (BatchData *batch_data,
+                                GPtrArray *items)
+{
+  for (guint i = 0; i < items->len; i++)
+    gn_local_provider_set_file (items->pdata[i], batch_data->new_files->pdata[i]);
+}
+
+/* Move @items from @from to @to, once for each store */
+static void
+gn_local_provider_move_items (GnItemStore *from,
+                              GnItemStore *to,
+                              GPtrArray   *items)
+{
+  g_autoptr(GPtrArray) added = NULL;
+
+  gn_item_store_remove_items (from, (GnItem **)items->pdata, items->len);
+
+  added = g_ptr_array_sized_new (items->len);
+
+  for (guint i = 0; i < items->len; i++)
+    if (!gn_item_store_contains (to, items->pdata[i]))
+      g_ptr_array_add (added, items->pdata[i]);
+
+  gn_item_store_insert_sorted_items (to, (GnItem **)added->pdata, added->len,
+                                     gn_item_compare, NULL);
+}
+
+static void
+gn_local_provider_items_trashed (GnLocalProvider *self,
+                                 BatchData       *batch_data,
+                                 GPtrArray       *items)
+{
+  gn_local_provider_update_files (batch_data, items);
+  gn_local_provider_move_items (self->notes_store, self->trash_store, items);
+  g_signal_emit_by_name (self, "items-trashed", items);
+}
+
+static void
+gn_local_provider_real_run_batch (GTask        *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
+{
+  BatchData *batch_data = task_data;
+  g_autoptr(GError) error = NULL;
+
+  GN_ENTRY;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  /* Stop at the first failure, the items before are still done */
+  for (guint i = 0; i < batch_data->files->len; i++)
+    {
+      if (g_cancellable_set_error_if_cancelled (cancellable, &error))
+        break;
+
+      if (!g_file_move (batch_data->files->pdata[i], batch_data->new_files->pdata[i],
+                        G_FILE_COPY_NONE, cancellable, NULL, NULL, &error))
+        break;
+
+      batch_data->n_done++;
+    }
+
+  if (error != NULL)
+    g_task_return_error (task, g_steal_pointer (&error));
+  else
+    g_task_return_boolean (task, TRUE);
+
+  GN_EXIT;
+}
+
+static void
+gn_local_provider_run_batch_cb (GObject      *object,
+                                GAsyncResult *result,
+                                gpointer      user_data)
+{
+  GnLocalProvider *self = (GnLocalProvider *)object;
+  BatchData *batch_data = g_task_get_task_data (G_TASK (result));
+  g_autoptr(GPtrArray) done = NULL;
+  GError *error = NULL;
+
+  GN_ENTRY;
+
+  g_assert (GN_IS_LOCAL_PROVIDER (self));
+
+  done = g_ptr_array_sized_new (batch_data->n_done);
+
+  for (guint i = 0; i < batch_data->n_done; i++)
+    g_ptr_array_add (done, batch_data->items->pdata[i]);
+
+  /* The stores are updated, and the signal emitted, once for the batch */
+  if (done->len > 0)
+    gn_local_provider_items_trashed (self, batch_data, done);
+
+  if (g_task_propagate_boolean (G_TASK (result), &error))
+    g_task_return_boolean (batch_data->task, TRUE);
+  else
+    g_task_return_error (batch_data->task, error);
+
+  GN_EXIT;
+}
+
+/* Run @batch_data in a worker, and free it when done */
+static void
+gn_local_provider_run_batch (GnLocalProvider *self,
+                             BatchData       *batch_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_assert (GN_IS_LOCAL_PROVIDER (self));
+
+  task = g_task_new (self, g_task_get_cancellable (batch_data->task),
+                     gn_local_provider_run_batch_cb, NULL);
+  g_task_set_source_tag (task, gn_local_provider_run_batch);
+  g_task_set_task_data (task, batch_data, batch_data_free);
+  g_task_run_in_thread (task, gn_local_provider_real_run_batch);
+}
+
+static void
+gn_local_provider_trash_items_async (GnProvider          *provider,
+                                     GPtrArray           *items,
+                                     GCancellable        *cancellable,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             user_data)
+{
+  GnLocalProvider *self = (GnLocalProvider *)provider;
+  BatchData *batch_data;
+
+  GN_ENTRY;
+
+  g_assert (GN_IS_LOCAL_PROVIDER (self));
+  g_assert (items != NULL);
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  batch_data = batch_data_new (self, items->len, cancellable, callback, user_data,
+                               gn_local_provider_trash_items_async);
+
+  for (guint i = 0; i < items->len; i++)
+    {
+      gn_local_provider_add_batch_item (batch_data, items->pdata[i]);
+      g_ptr_array_add (batch_data->new_files,
+                       gn_local_provider_get_trash_file (self, batch_data->files->pdata[i]));
+    }
+
+  gn_local_provider_run_batch (self, batch_data);
+
+  GN_EXIT;
+}
+
+static gboolean
+gn_local_provider_items_finish (GnProvider    *provider,
+                                GAsyncResult  *result,
+                                GError       **error)
+{
+  g_assert (GN_IS_LOCAL_PROVIDER (provider));
+  g_assert (g_task_is_valid (result, provider));
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static GnItemStore *
 gn_local_provider_get_notes (GnProvider *provider)
 {
   GN_ENTRY;
@@ -527,7 +1423,7 @@ gn_local_provider_get_tags (GnProvider *provider)
   GN_RETURN (G_LIST_STORE (gn_tag_store_get_model (tag_store)));
 }
 
-static GListStore *
+static GnItemStore *
 gn_local_provider_get_trash_notes (GnProvider *provider)
 {
   GN_ENTRY;
@@ -560,13 +1456,15 @@ gn_local_provider_class_init (GnLocalProviderClass *klass)
   provider_class->save_item_async = gn_local_provider_save_item_async;
   provider_class->save_item_finish = gn_local_provider_save_item_finish;
   provider_class->trash_item = gn_local_provider_trash_item;
+  provider_class->trash_items_async = gn_local_provider_trash_items_async;
+  provider_class->trash_items_finish = gn_local_provider_items_finish;
 }
 
 static void
 gn_local_provider_init (GnLocalProvider *self)
 {
-  self->notes_store = g_list_store_new (GN_TYPE_ITEM);
-  self->trash_store = g_list_store_new (GN_TYPE_ITEM);
+  self->notes_store = gn_item_store_new ();
+  self->trash_store = gn_item_store_new ();
   self->tag_store = gn_tag_store_new ();
 
   if (self->location == NULL)
@@ -57,7 +57,7 @@ struct _GnMemoProvider
   ECalClient *client;
   ECalClientView *client_view;
 
-  GListStore *notes_store;
+  GnItemStore *notes_store;
 };
 
 G_DEFINE_TYPE (GnMemoProvider, gn_memo_provider, GN_TYPE_PROVIDER)
@@ -106,7 +106,7 @@ gn_memo_provider_get_rgba (GnProvider *provider,
   return TRUE;
 }
 
-static GListStore *
+static GnItemStore *
 gn_memo_provider_get_notes (GnProvider *provider)
 {
   return GN_MEMO_PROVIDER (provider)->notes_store;
@@ -164,7 +164,7 @@ gn_memo_provider_objects_added_cb (ECalClientView *client_view,
                               g_object_ref (component),
                               g_object_unref);
 
-      g_list_store_append (self->notes_store, note);
+      gn_item_store_append (self->notes_store, GN_ITEM (note));
       /* self->notes = g_list_prepend (self->notes, note); */
     }
 
@@ -452,7 +452,7 @@ gn_memo_provider_class_init (GnMemoProviderClass *klass)
 static void
 gn_memo_provider_init (GnMemoProvider *self)
 {
-  self->notes_store = g_list_store_new (GN_TYPE_ITEM);
+  self->notes_store = gn_item_store_new ();
 }
 
 GnProvider *
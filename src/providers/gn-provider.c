@@ -55,6 +55,10 @@ enum {
   ITEM_DELETED,
   ITEM_TRASHED,
   ITEM_RESTORED,
+  ITEMS_ADDED,
+  ITEMS_DELETED,
+  ITEMS_TRASHED,
+  ITEMS_RESTORED,
   N_SIGNALS
 };
 
@@ -144,7 +148,7 @@ gn_provider_real_get_location_name (GnProvider *self)
   return "";
 }
 
-static GListStore *
+static GnItemStore *
 gn_provider_real_get_notes (GnProvider *self)
 {
   g_assert (GN_IS_PROVIDER (self));
@@ -162,7 +166,7 @@ gn_provider_real_get_tags (GnProvider *self)
   return NULL;
 }
 
-static GListStore *
+static GnItemStore *
 gn_provider_real_get_trash_notes (GnProvider *self)
 {
   g_assert (GN_IS_PROVIDER (self));
@@ -314,6 +318,162 @@ gn_provider_real_delete_item_finish (GnProvider    *self,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+typedef void     (*ItemAsyncFunc)  (GnProvider          *self,
+                                    GnItem              *item,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data);
+typedef gboolean (*ItemFinishFunc) (GnProvider          *self,
+                                    GAsyncResult        *result,
+                                    GError             **error);
+
+/* A batch operation done one item at a time, in the default implementations */
+typedef struct
+{
+  ItemFinishFunc finish_func;
+  guint          n_pending;
+  GError        *error;
+} BatchData;
+
+static void
+batch_data_free (gpointer data)
+{
+  BatchData *batch_data = data;
+
+  g_clear_error (&batch_data->error);
+  g_slice_free (BatchData, batch_data);
+}
+
+/* Mark an item of the batch @task done, and complete @task after the last */
+static void
+gn_provider_batch_item_done (GTask  *task,
+                             GError *error)
+{
+  BatchData *batch_data = g_task_get_task_data (task);
+
+  g_assert (batch_data->n_pending > 0);
+
+  if (error != NULL && batch_data->error == NULL)
+    batch_data->error = g_error_copy (error);
+
+  batch_data->n_pending--;
+
+  if (batch_data->n_pending > 0)
+    return;
+
+  if (batch_data->error != NULL)
+    g_task_return_error (task, g_steal_pointer (&batch_data->error));
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+gn_provider_batch_item_cb (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+  BatchData *batch_data = g_task_get_task_data (task);
+
+  batch_data->finish_func (GN_PROVIDER (object), result, &error);
+  gn_provider_batch_item_done (task, error);
+}
+
+/*
+ * Run @async_func for each of @items, all at once, and complete
+ * the task when every item is done.  The error, if any, is that
+ * of the first item to fail.
+ */
+static void
+gn_provider_batch_run (GnProvider          *self,
+                       GPtrArray           *items,
+                       GCancellable        *cancellable,
+                       GAsyncReadyCallback  callback,
+                       gpointer             user_data,
+                       gpointer             source_tag,
+                       ItemAsyncFunc        async_func,
+                       ItemFinishFunc       finish_func)
+{
+  g_autoptr(GTask) task = NULL;
+  BatchData *batch_data;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, source_tag);
+
+  batch_data = g_slice_new0 (BatchData);
+  batch_data->finish_func = finish_func;
+  /* Keep one pending till every item is started */
+  batch_data->n_pending = items->len + 1;
+  g_task_set_task_data (task, batch_data, batch_data_free);
+
+  for (guint i = 0; i < items->len; i++)
+    async_func (self, items->pdata[i], cancellable,
+                gn_provider_batch_item_cb, g_object_ref (task));
+
+  gn_provider_batch_item_done (task, NULL);
+}
+
+static gboolean
+gn_provider_real_items_finish (GnProvider    *self,
+                               GAsyncResult  *result,
+                               GError       **error)
+{
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+gn_provider_real_save_items_async (GnProvider          *self,
+                                   GPtrArray           *items,
+                                   GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             user_data)
+{
+  gn_provider_batch_run (self, items, cancellable, callback, user_data,
+                         gn_provider_real_save_items_async,
+                         gn_provider_save_item_async,
+                         gn_provider_save_item_finish);
+}
+
+static void
+gn_provider_real_trash_items_async (GnProvider          *self,
+                                    GPtrArray           *items,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+  gn_provider_batch_run (self, items, cancellable, callback, user_data,
+                         gn_provider_real_trash_items_async,
+                         gn_provider_trash_item_async,
+                         gn_provider_trash_item_finish);
+}
+
+static void
+gn_provider_real_restore_items_async (GnProvider          *self,
+                                      GPtrArray           *items,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data)
+{
+  gn_provider_batch_run (self, items, cancellable, callback, user_data,
+                         gn_provider_real_restore_items_async,
+                         gn_provider_restore_item_async,
+                         gn_provider_restore_item_finish);
+}
+
+static void
+gn_provider_real_delete_items_async (GnProvider          *self,
+                                     GPtrArray           *items,
+                                     GCancellable        *cancellable,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             user_data)
+{
+  gn_provider_batch_run (self, items, cancellable, callback, user_data,
+                         gn_provider_real_delete_items_async,
+                         gn_provider_delete_item_async,
+                         gn_provider_delete_item_finish);
+}
+
 static void
 gn_provider_class_init (GnProviderClass *klass)
 {
@@ -336,13 +496,21 @@ gn_provider_class_init (GnProviderClass *klass)
   klass->load_items_finish = gn_provider_real_load_items_finish;
   klass->save_item_async = gn_provider_real_save_item_async;
   klass->save_item_finish = gn_provider_real_save_item_finish;
+  klass->save_items_async = gn_provider_real_save_items_async;
+  klass->save_items_finish = gn_provider_real_items_finish;
   klass->trash_item = gn_provider_real_trash_item;
   klass->trash_item_async = gn_provider_real_trash_item_async;
   klass->trash_item_finish = gn_provider_real_trash_item_finish;
+  klass->trash_items_async = gn_provider_real_trash_items_async;
+  klass->trash_items_finish = gn_provider_real_items_finish;
   klass->restore_item_async = gn_provider_real_restore_item_async;
   klass->restore_item_finish = gn_provider_real_restore_item_finish;
+  klass->restore_items_async = gn_provider_real_restore_items_async;
+  klass->restore_items_finish = gn_provider_real_items_finish;
   klass->delete_item_async = gn_provider_real_delete_item_async;
   klass->delete_item_finish = gn_provider_real_delete_item_finish;
+  klass->delete_items_async = gn_provider_real_delete_items_async;
+  klass->delete_items_finish = gn_provider_real_items_finish;
 
   properties[PROP_UID] =
     g_param_spec_string ("uid",
@@ -444,6 +612,70 @@ gn_provider_class_init (GnProviderClass *klass)
                   0, NULL, NULL,
                   g_cclosure_marshal_VOID__OBJECT,
                   G_TYPE_NONE, 1, GN_TYPE_ITEM);
+
+  /**
+   * GnProvider::items-added:
+   * @self: a #GnProvider
+   * @items: a #GPtrArray of #GnItem
+   *
+   * items-added signal is emitted once when a batch of items
+   * is saved, instead of #GnProvider::item-added for each item.
+   */
+  signals [ITEMS_ADDED] =
+    g_signal_new ("items-added",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__BOXED,
+                  G_TYPE_NONE, 1, G_TYPE_PTR_ARRAY);
+
+  /**
+   * GnProvider::items-deleted:
+   * @self: a #GnProvider
+   * @items: a #GPtrArray of #GnItem
+   *
+   * items-deleted signal is emitted once when a batch of items
+   * is deleted, instead of #GnProvider::item-deleted for each item.
+   */
+  signals [ITEMS_DELETED] =
+    g_signal_new ("items-deleted",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__BOXED,
+                  G_TYPE_NONE, 1, G_TYPE_PTR_ARRAY);
+
+  /**
+   * GnProvider::items-trashed:
+   * @self: a #GnProvider
+   * @items: a #GPtrArray of #GnItem
+   *
+   * items-trashed signal is emitted once when a batch of items
+   * is trashed, instead of #GnProvider::item-trashed for each item.
+   */
+  signals [ITEMS_TRASHED] =
+    g_signal_new ("items-trashed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__BOXED,
+                  G_TYPE_NONE, 1, G_TYPE_PTR_ARRAY);
+
+  /**
+   * GnProvider::items-restored:
+   * @self: a #GnProvider
+   * @items: a #GPtrArray of #GnItem
+   *
+   * items-restored signal is emitted once when a batch of items
+   * is restored from the trash, instead of #GnProvider::item-restored for each item.
+   */
+  signals [ITEMS_RESTORED] =
+    g_signal_new ("items-restored",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__BOXED,
+                  G_TYPE_NONE, 1, G_TYPE_PTR_ARRAY);
 }
 
 static void
@@ -786,6 +1018,77 @@ gn_provider_save_item_finish (GnProvider    *self,
   GN_RETURN (ret);
 }
 
+/**
+ * gn_provider_save_items_async:
+ * @self: a #GnProvider
+ * @items: a #GPtrArray of #GnItem
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @callback: a #GAsyncReadyCallback, or %NULL
+ * @user_data: closure data for @callback
+ *
+ * Asynchronously save every item in @items, like
+ * gn_provider_save_item_async() does for a single item.
+ * The items are saved in one go if the provider supports it,
+ * which is much faster than saving the items one by one.
+ *
+ * @callback should complete the operation by calling
+ * gn_provider_save_items_finish().
+ */
+void
+gn_provider_save_items_async (GnProvider          *self,
+                              GPtrArray           *items,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+  GN_ENTRY;
+
+  g_return_if_fail (GN_IS_PROVIDER (self));
+  g_return_if_fail (items != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  /* Keep running till the items are saved */
+  g_application_hold (g_application_get_default ());
+
+  GN_PROVIDER_GET_CLASS (self)->save_items_async (self, items,
+                                                  cancellable, callback,
+                                                  user_data);
+  GN_EXIT;
+}
+
+/**
+ * gn_provider_save_items_finish:
+ * @self: a #GnProvider
+ * @result: a #GAsyncResult provided to callback
+ * @error: a location for a #GError or %NULL
+ *
+ * Completes saving items initiated with
+ * gn_provider_save_items_async().  The error, if any,
+ * is that of the first item that failed; the rest of
+ * the items may still have been saved.
+ *
+ * Returns: %TRUE if every item was saved
+ * successfully.  %FALSE otherwise.
+ */
+gboolean
+gn_provider_save_items_finish (GnProvider    *self,
+                               GAsyncResult  *result,
+                               GError       **error)
+{
+  gboolean ret;
+
+  GN_ENTRY;
+
+  g_return_val_if_fail (GN_IS_PROVIDER (self), FALSE);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), FALSE);
+
+  ret = GN_PROVIDER_GET_CLASS (self)->save_items_finish (self, result, error);
+
+  g_application_release (g_application_get_default ());
+
+  GN_RETURN (ret);
+}
+
 /**
  * gn_provider_trash_item:
  * @self: a #GnProvider
@@ -883,6 +1186,72 @@ gn_provider_trash_item_finish (GnProvider    *self,
   GN_RETURN (ret);
 }
 
+/**
+ * gn_provider_trash_items_async:
+ * @self: a #GnProvider
+ * @items: a #GPtrArray of #GnItem
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @callback: a #GAsyncReadyCallback, or %NULL
+ * @user_data: closure data for @callback
+ *
+ * Asynchronously trash every item in @items, like
+ * gn_provider_trash_item_async() does for a single item.
+ * Providers may trash the whole batch in one go, which is
+ * much faster than trashing the items one by one.
+ *
+ * @callback should complete the operation by calling
+ * gn_provider_trash_items_finish().
+ */
+void
+gn_provider_trash_items_async (GnProvider          *self,
+                               GPtrArray           *items,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  GN_ENTRY;
+
+  g_return_if_fail (GN_IS_PROVIDER (self));
+  g_return_if_fail (items != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  GN_PROVIDER_GET_CLASS (self)->trash_items_async (self, items,
+                                                   cancellable, callback,
+                                                   user_data);
+  GN_EXIT;
+}
+
+/**
+ * gn_provider_trash_items_finish:
+ * @self: a #GnProvider
+ * @result: a #GAsyncResult provided to callback
+ * @error: a location for a #GError or %NULL
+ *
+ * Completes trashing items initiated with
+ * gn_provider_trash_items_async().  The error, if any,
+ * is that of the first item that failed; the rest of
+ * the items may still have been trashed.
+ *
+ * Returns: %TRUE if every item was trashed/deleted
+ * successfully.  %FALSE otherwise.
+ */
+gboolean
+gn_provider_trash_items_finish (GnProvider    *self,
+                                GAsyncResult  *result,
+                                GError       **error)
+{
+  gboolean ret;
+
+  GN_ENTRY;
+
+  g_return_val_if_fail (GN_IS_PROVIDER (self), FALSE);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), FALSE);
+
+  ret = GN_PROVIDER_GET_CLASS (self)->trash_items_finish (self, result, error);
+
+  GN_RETURN (ret);
+}
+
 /**
  * gn_provider_restore_item_async:
  * @self: a #GnProvider
@@ -944,6 +1313,72 @@ gn_provider_restore_item_finish (GnProvider   *self,
   GN_RETURN (ret);
 }
 
+/**
+ * gn_provider_restore_items_async:
+ * @self: a #GnProvider
+ * @items: a #GPtrArray of #GnItem
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @callback: a #GAsyncReadyCallback, or %NULL
+ * @user_data: closure data for @callback
+ *
+ * Asynchronously restore every item in @items, like
+ * gn_provider_restore_item_async() does for a single item.
+ * The items are restored in one go if the provider supports
+ * it, which is much faster than restoring the items one by one.
+ *
+ * @callback should complete the operation by calling
+ * gn_provider_restore_items_finish().
+ */
+void
+gn_provider_restore_items_async (GnProvider          *self,
+                                 GPtrArray           *items,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+  GN_ENTRY;
+
+  g_return_if_fail (GN_IS_PROVIDER (self));
+  g_return_if_fail (items != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  GN_PROVIDER_GET_CLASS (self)->restore_items_async (self, items,
+                                                     cancellable, callback,
+                                                     user_data);
+  GN_EXIT;
+}
+
+/**
+ * gn_provider_restore_items_finish:
+ * @self: a #GnProvider
+ * @result: a #GAsyncResult provided to callback
+ * @error: a location for a #GError or %NULL
+ *
+ * Completes restoring items initiated with
+ * gn_provider_restore_items_async().  The error, if any,
+ * is that of the first item that failed; the rest of
+ * the items may still have been restored.
+ *
+ * Returns: %TRUE if every item was restored
+ * successfully.  %FALSE otherwise.
+ */
+gboolean
+gn_provider_restore_items_finish (GnProvider    *self,
+                                  GAsyncResult  *result,
+                                  GError       **error)
+{
+  gboolean ret;
+
+  GN_ENTRY;
+
+  g_return_val_if_fail (GN_IS_PROVIDER (self), FALSE);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), FALSE);
+
+  ret = GN_PROVIDER_GET_CLASS (self)->restore_items_finish (self, result, error);
+
+  GN_RETURN (ret);
+}
+
 /**
  * gn_provider_delete_item_async:
  * @self: a #GnProvider
@@ -1004,6 +1439,72 @@ gn_provider_delete_item_finish (GnProvider   *self,
   GN_RETURN (ret);
 }
 
+/**
+ * gn_provider_delete_items_async:
+ * @self: a #GnProvider
+ * @items: a #GPtrArray of #GnItem
+ * @cancellable: (nullable): a #GCancellable or %NULL
+ * @callback: a #GAsyncReadyCallback, or %NULL
+ * @user_data: closure data for @callback
+ *
+ * Asynchronously delete every item in @items, like
+ * gn_provider_delete_item_async() does for a single item.
+ * The items are deleted in one go if the provider supports it,
+ * which is much faster than deleting the items one by one.
+ *
+ * @callback should complete the operation by calling
+ * gn_provider_delete_items_finish().
+ */
+void
+gn_provider_delete_items_async (GnProvider          *self,
+                                GPtrArray           *items,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data)
+{
+  GN_ENTRY;
+
+  g_return_if_fail (GN_IS_PROVIDER (self));
+  g_return_if_fail (items != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  GN_PROVIDER_GET_CLASS (self)->delete_items_async (self, items,
+                                                    cancellable, callback,
+                                                    user_data);
+  GN_EXIT;
+}
+
+/**
+ * gn_provider_delete_items_finish:
+ * @self: a #GnProvider
+ * @result: a #GAsyncResult provided to callback
+ * @error: a location for a #GError or %NULL
+ *
+ * Completes deleting items initiated with
+ * gn_provider_delete_items_async().  The error, if any,
+ * is that of the first item that failed; the rest of
+ * the items may still have been deleted.
+ *
+ * Returns: %TRUE if every item was deleted
+ * successfully.  %FALSE otherwise.
+ */
+gboolean
+gn_provider_delete_items_finish (GnProvider    *self,
+                                 GAsyncResult  *result,
+                                 GError       **error)
+{
+  gboolean ret;
+
+  GN_ENTRY;
+
+  g_return_val_if_fail (GN_IS_PROVIDER (self), FALSE);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), FALSE);
+
+  ret = GN_PROVIDER_GET_CLASS (self)->delete_items_finish (self, result, error);
+
+  GN_RETURN (ret);
+}
+
 /**
  * gn_provider_get_notes:
  * @self: a #GnProvider
@@ -1012,13 +1513,13 @@ gn_provider_delete_item_finish (GnProvider   *self,
  * should be called only after gn_provider_load_items()
  * or gn_provider_load_items_async() is called.
  *
- * Returns: (transfer none) (nullable): A #GList of
- * #GnItem or %NULL if empty.
+ * Returns: (transfer none) (nullable): A #GnItemStore
+ * of #GnItem or %NULL if not supported.
  */
-GListStore *
+GnItemStore *
 gn_provider_get_notes (GnProvider *self)
 {
-  GListStore *notes;
+  GnItemStore *notes;
 
   GN_ENTRY;
 
@@ -1062,13 +1563,13 @@ gn_provider_get_tags (GnProvider *self)
  * should be called only after gn_provider_load_items()
  * or gn_provider_load_items_async() is called.
  *
- * Returns: (transfer none) (nullable): A #GList of
- * #GnItem or %NULL if empty.
+ * Returns: (transfer none) (nullable): A #GnItemStore
+ * of #GnItem or %NULL if not supported.
  */
-GListStore *
+GnItemStore *
 gn_provider_get_trash_notes (GnProvider *self)
 {
-  GListStore *notes;
+  GnItemStore *notes;
 
   GN_ENTRY;
 
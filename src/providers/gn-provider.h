@@ -24,6 +24,7 @@
 #include <gio/gio.h>
 
 #include "gn-item.h"
+#include "gn-item-store.h"
 
 G_BEGIN_DECLS
 
@@ -54,6 +55,14 @@ struct _GnProviderClass
   gboolean     (*save_item_finish)     (GnProvider           *self,
                                         GAsyncResult         *result,
                                         GError              **error);
+  void         (*save_items_async)     (GnProvider           *self,
+                                        GPtrArray            *items,
+                                        GCancellable         *cancellable,
+                                        GAsyncReadyCallback   callback,
+                                        gpointer              user_data);
+  gboolean     (*save_items_finish)    (GnProvider           *self,
+                                        GAsyncResult         *result,
+                                        GError              **error);
 
   gboolean     (*trash_item)           (GnProvider           *self,
                                         GnItem               *item,
@@ -67,6 +76,14 @@ struct _GnProviderClass
   gboolean     (*trash_item_finish)    (GnProvider           *self,
                                         GAsyncResult         *result,
                                         GError              **error);
+  void         (*trash_items_async)    (GnProvider           *self,
+                                        GPtrArray            *items,
+                                        GCancellable         *cancellable,
+                                        GAsyncReadyCallback   callback,
+                                        gpointer              user_data);
+  gboolean     (*trash_items_finish)   (GnProvider           *self,
+                                        GAsyncResult         *result,
+                                        GError              **error);
 
   void         (*restore_item_async)   (GnProvider           *self,
                                         GnItem               *item,
@@ -76,6 +93,14 @@ struct _GnProviderClass
   gboolean     (*restore_item_finish)  (GnProvider           *self,
                                         GAsyncResult         *result,
                                         GError              **error);
+  void         (*restore_items_async)  (GnProvider           *self,
+                                        GPtrArray            *items,
+                                        GCancellable         *cancellable,
+                                        GAsyncReadyCallback   callback,
+                                        gpointer              user_data);
+  gboolean     (*restore_items_finish) (GnProvider           *self,
+                                        GAsyncResult         *result,
+                                        GError              **error);
 
   void         (*delete_item_async)    (GnProvider           *self,
                                         GnItem               *item,
@@ -85,10 +110,18 @@ struct _GnProviderClass
   gboolean     (*delete_item_finish)   (GnProvider           *self,
                                         GAsyncResult         *result,
                                         GError              **error);
+  void         (*delete_items_async)   (GnProvider           *self,
+                                        GPtrArray            *items,
+                                        GCancellable         *cancellable,
+                                        GAsyncReadyCallback   callback,
+                                        gpointer              user_data);
+  gboolean     (*delete_items_finish)  (GnProvider           *self,
+                                        GAsyncResult         *result,
+                                        GError              **error);
 
-  GListStore  *(*get_notes)            (GnProvider           *self);
+  GnItemStore *(*get_notes)            (GnProvider           *self);
   GListStore  *(*get_tags)             (GnProvider           *self);
-  GListStore  *(*get_trash_notes)      (GnProvider           *self);
+  GnItemStore *(*get_trash_notes)      (GnProvider           *self);
   GListStore  *(*get_notebooks)        (GnProvider           *self);
 
   gchar       *(*get_uid)              (GnProvider           *self);
@@ -133,6 +166,14 @@ void         gn_provider_save_item_async      (GnProvider           *self,
 gboolean     gn_provider_save_item_finish     (GnProvider           *self,
                                                GAsyncResult         *result,
                                                GError              **error);
+void         gn_provider_save_items_async     (GnProvider           *self,
+                                               GPtrArray            *items,
+                                               GCancellable         *cancellable,
+                                               GAsyncReadyCallback   callback,
+                                               gpointer              user_data);
+gboolean     gn_provider_save_items_finish    (GnProvider           *self,
+                                               GAsyncResult         *result,
+                                               GError              **error);
 
 gboolean     gn_provider_trash_item           (GnProvider           *self,
                                                GnItem               *item,
@@ -146,6 +187,14 @@ void         gn_provider_trash_item_async     (GnProvider           *self,
 gboolean     gn_provider_trash_item_finish    (GnProvider           *self,
                                                GAsyncResult         *result,
                                                GError              **error);
+void         gn_provider_trash_items_async    (GnProvider           *self,
+                                               GPtrArray            *items,
+                                               GCancellable         *cancellable,
+                                               GAsyncReadyCallback   callback,
+                                               gpointer              user_data);
+gboolean     gn_provider_trash_items_finish   (GnProvider           *self,
+                                               GAsyncResult         *result,
+                                               GError              **error);
 
 void         gn_provider_restore_item_async   (GnProvider           *self,
                                                GnItem               *item,
@@ -155,6 +204,14 @@ void         gn_provider_restore_item_async   (GnProvider           *self,
 gboolean     gn_provider_restore_item_finish  (GnProvider           *self,
                                                GAsyncResult         *result,
                                                GError              **error);
+void         gn_provider_restore_items_async  (GnProvider           *self,
+                                               GPtrArray            *items,
+                                               GCancellable         *cancellable,
+                                               GAsyncReadyCallback   callback,
+                                               gpointer              user_data);
+gboolean     gn_provider_restore_items_finish (GnProvider           *self,
+                                               GAsyncResult         *result,
+                                               GError              **error);
 
 void         gn_provider_delete_item_async    (GnProvider           *self,
                                                GnItem               *item,
@@ -164,10 +221,18 @@ void         gn_provider_delete_item_async    (GnProvider           *self,
 gboolean     gn_provider_delete_item_finish   (GnProvider           *self,
                                                GAsyncResult         *result,
                                                GError              **error);
+void         gn_provider_delete_items_async   (GnProvider           *self,
+                                               GPtrArray            *items,
+                                               GCancellable         *cancellable,
+                                               GAsyncReadyCallback   callback,
+                                               gpointer              user_data);
+gboolean     gn_provider_delete_items_finish  (GnProvider           *self,
+                                               GAsyncResult         *result,
+                                               GError              **error);
 
-GListStore  *gn_provider_get_notes            (GnProvider           *self);
+GnItemStore *gn_provider_get_notes            (GnProvider           *self);
 GListStore  *gn_provider_get_tags             (GnProvider           *self);
-GListStore  *gn_provider_get_trash_notes      (GnProvider           *self);
+GnItemStore *gn_provider_get_trash_notes      (GnProvider           *self);
 GListStore  *gn_provider_get_notebooks        (GnProvider           *self);
 gboolean     gn_provider_has_loaded           (GnProvider           *self);
 
@@ -28,6 +28,7 @@
 #include "gn-note.h"
 #include "gn-note-buffer.h"
 #include "gn-manager.h"
+#include "gn-search-query.h"
 #include "gn-text-view.h"
 #include "gn-tag-store.h"
 #include "gn-editor.h"
@@ -51,6 +52,7 @@ struct _GnEditor
   GnItem        *item;
   GListModel    *model;
   GtkTextBuffer *note_buffer;
+  GtkTextTag    *search_tag;
 
   GtkWidget *editor_view;
 
@@ -63,8 +65,18 @@ struct _GnEditor
   GtkWidget *detach_button;
 
   guint save_timeout_id;
+
+  /* Snapshots waiting for the current save to complete */
+  GQueue   pending_saves;
+  gboolean save_in_progress;
 };
 
+typedef struct
+{
+  GnItem         *item;
+  GnNoteSnapshot *snapshot;
+} PendingSave;
+
 G_DEFINE_TYPE (GnEditor, gn_editor, GTK_TYPE_GRID)
 
 static void
@@ -129,11 +141,100 @@ gn_editor_redo (GnEditor *self)
   gn_text_view_redo (GN_TEXT_VIEW (self->editor_view));
 }
 
+static void
+pending_save_free (PendingSave *save)
+{
+  g_object_unref (save->item);
+  gn_note_snapshot_unref (save->snapshot);
+  g_free (save);
+}
+
+static void gn_editor_save_snapshot (GnEditor       *self,
+                                     GnItem         *item,
+                                     GnNoteSnapshot *snapshot);
+
+static void
+gn_editor_save_snapshot_cb (GObject      *object,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  g_autoptr(GnEditor) self = user_data;
+  GnNote *note = (GnNote *)object;
+  g_autoptr(GError) error = NULL;
+  PendingSave *save;
+
+  GN_ENTRY;
+
+  g_assert (GN_IS_EDITOR (self));
+  g_assert (GN_IS_NOTE (note));
+
+  self->save_in_progress = FALSE;
+  g_application_release (g_application_get_default ());
+
+  if (gn_note_set_content_from_snapshot_finish (note, result, &error))
+    gn_manager_save_item (gn_manager_get_default (), GN_ITEM (note));
+  else
+    g_warning ("Failed to save note: %s", error->message);
+
+  save = g_queue_pop_head (&self->pending_saves);
+
+  if (save != NULL)
+    {
+      gn_editor_save_snapshot (self, save->item, save->snapshot);
+      pending_save_free (save);
+    }
+
+  GN_EXIT;
+}
+
+/*
+ * Save @snapshot to @item.  The content is serialized in a thread.
+ * Only one save is run at a time, so that the saves are done in
+ * order, and the snapshots to be saved in between are queued.
+ */
+static void
+gn_editor_save_snapshot (GnEditor       *self,
+                         GnItem         *item,
+                         GnNoteSnapshot *snapshot)
+{
+  PendingSave *save;
+
+  g_assert (GN_IS_EDITOR (self));
+  g_assert (GN_IS_NOTE (item));
+  g_assert (snapshot != NULL);
+
+  if (!self->save_in_progress)
+    {
+      /* Don't quit before the content is saved */
+      g_application_hold (g_application_get_default ());
+      self->save_in_progress = TRUE;
+      gn_note_set_content_from_snapshot_async (GN_NOTE (item), snapshot, NULL,
+                                               gn_editor_save_snapshot_cb,
+                                               g_object_ref (self));
+      return;
+    }
+
+  /* Only the latest snapshot of an item has to be saved */
+  save = g_queue_peek_tail (&self->pending_saves);
+
+  if (save != NULL && save->item == item)
+    {
+      gn_note_snapshot_unref (save->snapshot);
+      save->snapshot = gn_note_snapshot_ref (snapshot);
+      return;
+    }
+
+  save = g_new0 (PendingSave, 1);
+  save->item = g_object_ref (item);
+  save->snapshot = gn_note_snapshot_ref (snapshot);
+  g_queue_push_tail (&self->pending_saves, save);
+}
+
 static gboolean
 gn_editor_save_note (gpointer user_data)
 {
   GnEditor *self = (GnEditor *)user_data;
-  GnManager *manager;
+  g_autoptr(GnNoteSnapshot) snapshot = NULL;
 
   GN_ENTRY;
 
@@ -141,11 +242,15 @@ gn_editor_save_note (gpointer user_data)
 
   g_clear_handle_id (&self->save_timeout_id,
                      g_source_remove);
-  manager = gn_manager_get_default ();
 
-  gn_note_set_content_from_buffer (GN_NOTE (self->item), self->note_buffer);
+  /*
+   * Only take a copy of the buffer here.  Serializing the note and
+   * writing the file is done in threads, so that the user can
+   * continue typing.
+   */
+  snapshot = gn_note_snapshot_new (self->note_buffer);
   gtk_text_buffer_set_modified (self->note_buffer, FALSE);
-  gn_manager_save_item (manager, self->item);
+  gn_editor_save_snapshot (self, self->item, snapshot);
 
   GN_RETURN (G_SOURCE_REMOVE);
 }
@@ -154,6 +259,8 @@ static void
 gn_editor_buffer_modified_cb (GnEditor      *self,
                               GtkTextBuffer *buffer)
 {
+  GtkTextIter start, end;
+
   g_assert (GN_IS_EDITOR (self));
   g_assert (GTK_IS_TEXT_BUFFER (buffer));
 
@@ -161,6 +268,10 @@ gn_editor_buffer_modified_cb (GnEditor      *self,
       self->item == NULL)
     return;
 
+  /* The matches highlighted may no longer match once edited */
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  gtk_text_buffer_remove_tag (buffer, self->search_tag, &start, &end);
+
   if (self->save_timeout_id == 0)
     self->save_timeout_id = g_timeout_add (SAVE_TIMEOUT,
                                            gn_editor_save_note, self);
@@ -249,6 +360,40 @@ gn_editor_delete_range_cb (GtkTextBuffer *buffer,
     gn_editor_update_window_title (self, buffer);
 }
 
+/* Highlight the matches of the current search, if any */
+static void
+gn_editor_highlight_search_matches (GnEditor *self)
+{
+  g_autoptr(GArray) matches = NULL;
+  g_autofree gchar *text = NULL;
+  GtkTextIter start, end;
+  gint offset = 0, char_offset = 0;
+
+  g_assert (GN_IS_EDITOR (self));
+
+  gtk_text_buffer_get_bounds (self->note_buffer, &start, &end);
+  gtk_text_buffer_remove_tag (self->note_buffer, self->search_tag, &start, &end);
+  text = gtk_text_buffer_get_text (self->note_buffer, &start, &end, FALSE);
+  matches = gn_manager_find_search_matches (gn_manager_get_default (), text, -1);
+
+  if (matches == NULL)
+    return;
+
+  for (guint i = 0; i < matches->len; i++)
+    {
+      GnSearchMatch *match = &g_array_index (matches, GnSearchMatch, i);
+
+      /* The matches are in byte offsets, in order */
+      char_offset += g_utf8_strlen (text + offset, match->start - offset);
+      gtk_text_buffer_get_iter_at_offset (self->note_buffer, &start, char_offset);
+      char_offset += g_utf8_strlen (text + match->start, match->end - match->start);
+      gtk_text_buffer_get_iter_at_offset (self->note_buffer, &end, char_offset);
+      offset = match->end;
+
+      gtk_text_buffer_apply_tag (self->note_buffer, self->search_tag, &start, &end);
+    }
+}
+
 static void
 gn_editor_block_buffer_signals (GnEditor *self)
 {
@@ -296,6 +441,17 @@ gn_editor_dispose (GObject *object)
   G_OBJECT_CLASS (gn_editor_parent_class)->dispose (object);
 }
 
+static void
+gn_editor_finalize (GObject *object)
+{
+  GnEditor *self = (GnEditor *)object;
+
+  g_queue_foreach (&self->pending_saves, (GFunc)pending_save_free, NULL);
+  g_queue_clear (&self->pending_saves);
+
+  G_OBJECT_CLASS (gn_editor_parent_class)->finalize (object);
+}
+
 static void
 gn_editor_class_init (GnEditorClass *klass)
 {
@@ -303,6 +459,7 @@ gn_editor_class_init (GnEditorClass *klass)
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
   object_class->dispose = gn_editor_dispose;
+  object_class->finalize = gn_editor_finalize;
 
   g_type_ensure (GN_TYPE_TEXT_VIEW);
 
@@ -359,6 +516,12 @@ gn_editor_init (GnEditor *self)
   g_object_bind_property (self->settings, "font",
                           font_tag, "font",
                           G_BINDING_DEFAULT | G_BINDING_SYNC_CREATE);
+
+  /* Not a format tag, so it's neither saved nor undone */
+  self->search_tag = gtk_text_buffer_create_tag (self->note_buffer, "search-match",
+                                                 "background", "#fce94f",
+                                                 "foreground", "#2e3436",
+                                                 NULL);
 }
 
 GtkWidget *
@@ -409,6 +572,7 @@ gn_editor_set_item (GnEditor   *self,
     gn_note_set_content_to_buffer (GN_NOTE (item),
                                    GN_NOTE_BUFFER (self->note_buffer));
 
+  gn_editor_highlight_search_matches (self);
   gn_editor_update_window_title (self, GTK_TEXT_BUFFER (self->note_buffer));
   gn_editor_update_window_subtitle (self, GN_NOTE (item));
   gtk_text_buffer_set_modified (self->note_buffer, FALSE);
@@ -27,6 +27,7 @@
 #include "gn-note.h"
 #include "gn-item-thumbnail.h"
 #include "gn-manager.h"
+#include "gn-main-view.h"
 #include "gn-settings.h"
 #include "gn-tag-preview.h"
 #include "gn-list-view-item.h"
@@ -69,6 +70,53 @@ gn_list_view_item_toggled (GnListViewItem  *self,
   gn_list_view_item_set_selected (self, is_selected);
 }
 
+/*
+ * Get the markup for @title, with the matches of the current
+ * search highlighted if @highlight is %TRUE.  A space is
+ * appended to keep the height of the label on empty title.
+ */
+static gchar *
+gn_list_view_item_get_title_markup (const gchar *title,
+                                    gboolean     highlight)
+{
+  GnManager *manager;
+  GString *markup;
+  g_autofree gchar *escaped = NULL;
+  gint position = 0, copied = 0;
+  gint start, end;
+
+  manager = gn_manager_get_default ();
+  markup = g_string_new ("<span font='Cantarell' size='large'>");
+
+  while (highlight && title[position] != '\0' &&
+         gn_manager_find_search_match (manager, title, -1, position, &start, &end))
+    {
+      g_autofree gchar *text = NULL;
+      g_autofree gchar *match = NULL;
+
+      /* Skip empty matches, like that of “re:x*” */
+      if (end == start)
+        {
+          if (title[start] == '\0')
+            break;
+
+          position = g_utf8_next_char (title + start) - title;
+          continue;
+        }
+
+      text = g_markup_escape_text (title + copied, start - copied);
+      match = g_markup_escape_text (title + start, end - start);
+      g_string_append_printf (markup, "%s<span background='#fce94f' foreground='#2e3436'>%s</span>",
+                              text, match);
+      copied = position = end;
+    }
+
+  escaped = g_markup_escape_text (title + copied, -1);
+  g_string_append_printf (markup, "%s </span>", escaped);
+
+  return g_string_free (markup, FALSE);
+}
+
 static void
 gn_list_view_item_class_init (GnListViewItemClass *klass)
 {
@@ -108,6 +156,7 @@ gn_list_view_item_new (gpointer data,
   GList *tags;
   GdkRGBA rgba;
   gint64 modification_time;
+  gboolean is_search;
 
   GN_ENTRY;
 
@@ -120,10 +169,11 @@ gn_list_view_item_new (gpointer data,
   time_label = gn_utils_get_human_time (modification_time);
   tags = gn_note_get_tags (GN_NOTE (item));
 
-  /* A space is appended to title so as to keep height on empty title */
-  title_markup = g_strconcat ("<span font='Cantarell' size='large'>",
-                              gn_item_get_title (item), " </span>",
-                              NULL);
+  /* Only the results of the search are highlighted */
+  is_search = GN_IS_MAIN_VIEW (object) &&
+    gn_main_view_get_model (GN_MAIN_VIEW (object)) ==
+    gn_manager_get_search_store (gn_manager_get_default ());
+  title_markup = gn_list_view_item_get_title_markup (gn_item_get_title (item), is_search);
   g_object_set (self->title_label, "label", title_markup, NULL);
   gtk_label_set_label (GTK_LABEL (self->time_label), time_label);
 
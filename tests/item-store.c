@@ -0,0 +1,384 @@
+/* item-store.c
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "gn-item-store.h"
+#include "gn-plain-note.h"
+#include "gn-utils.h"
+
+static guint n_emissions;
+
+/* Keep a copy of the store, updated only from "items-changed" */
+static void
+items_changed_cb (GListModel *model,
+                  guint       position,
+                  guint       removed,
+                  guint       added,
+                  GPtrArray  *copy)
+{
+  g_ptr_array_remove_range (copy, position, removed);
+
+  for (guint i = 0; i < added; i++)
+    {
+      g_autoptr(GnItem) item = g_list_model_get_item (model, position + i);
+
+      g_ptr_array_insert (copy, position + i, item);
+    }
+
+  n_emissions++;
+}
+
+/* Get the number of emissions since the last call */
+static guint
+get_n_emissions (void)
+{
+  guint count = n_emissions;
+
+  n_emissions = 0;
+
+  return count;
+}
+
+/* Check that @store, @copy and the positions of items agree */
+static void
+check_store (GnItemStore *store,
+             GPtrArray   *copy)
+{
+  guint n_items;
+
+  n_items = g_list_model_get_n_items (G_LIST_MODEL (store));
+  g_assert_cmpint (n_items, ==, copy->len);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr(GnItem) item = g_list_model_get_item (G_LIST_MODEL (store), i);
+      guint position;
+
+      g_assert_true (item == copy->pdata[i]);
+      g_assert_true (gn_item_store_contains (store, item));
+      g_assert_true (gn_item_store_get_position (store, item, &position));
+      g_assert_cmpint (position, ==, i);
+    }
+
+  g_assert_null (g_list_model_get_item (G_LIST_MODEL (store), n_items));
+}
+
+static GPtrArray *
+create_items (guint n_items)
+{
+  GPtrArray *items;
+
+  items = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autofree gchar *title = g_strdup_printf ("Note %05u", i);
+
+      g_ptr_array_add (items, gn_plain_note_new_from_data (title, -1));
+    }
+
+  return items;
+}
+
+static void
+test_item_store_basic (void)
+{
+  g_autoptr(GnItemStore) store = NULL;
+  g_autoptr(GPtrArray) items = NULL;
+  g_autoptr(GPtrArray) copy = NULL;
+  guint position;
+
+  store = gn_item_store_new ();
+  copy = g_ptr_array_new ();
+  items = create_items (6);
+  g_signal_connect (store, "items-changed", G_CALLBACK (items_changed_cb), copy);
+
+  g_assert_true (g_list_model_get_item_type (G_LIST_MODEL (store)) == GN_TYPE_ITEM);
+  check_store (store, copy);
+  g_assert_false (gn_item_store_get_position (store, items->pdata[0], NULL));
+
+  gn_item_store_append (store, items->pdata[2]);
+  gn_item_store_append (store, items->pdata[4]);
+  check_store (store, copy);
+
+  /* Insert in the order of titles */
+  position = gn_item_store_insert_sorted (store, items->pdata[3], gn_item_compare, NULL);
+  g_assert_cmpint (position, ==, 1);
+  position = gn_item_store_insert_sorted (store, items->pdata[0], gn_item_compare, NULL);
+  g_assert_cmpint (position, ==, 0);
+  position = gn_item_store_insert_sorted (store, items->pdata[5], gn_item_compare, NULL);
+  g_assert_cmpint (position, ==, 4);
+  check_store (store, copy);
+  g_assert_cmpint (get_n_emissions (), ==, 5);
+
+  g_assert_true (gn_item_store_remove_item (store, items->pdata[3]));
+  g_assert_false (gn_item_store_remove_item (store, items->pdata[3]));
+  g_assert_false (gn_item_store_contains (store, items->pdata[3]));
+  gn_item_store_remove (store, 0);
+  g_assert_false (gn_item_store_contains (store, items->pdata[0]));
+  check_store (store, copy);
+  g_assert_cmpint (get_n_emissions (), ==, 2);
+
+  /* An item removed by the splice can be added back */
+  gn_item_store_splice (store, 0, 2, &items->pdata[0], 4);
+  check_store (store, copy);
+  g_assert_cmpint (get_n_emissions (), ==, 1);
+  g_assert_cmpint (g_list_model_get_n_items (G_LIST_MODEL (store)), ==, 5);
+  g_assert_true (copy->pdata[2] == items->pdata[2]);
+  g_assert_true (copy->pdata[4] == items->pdata[5]);
+
+  g_assert_true (gn_item_store_item_changed (store, items->pdata[3]));
+  g_assert_cmpint (get_n_emissions (), ==, 1);
+  check_store (store, copy);
+
+  gn_item_store_splice (store, 0, 5, NULL, 0);
+  g_assert_false (gn_item_store_item_changed (store, items->pdata[3]));
+  check_store (store, copy);
+
+  g_signal_handlers_disconnect_by_data (store, copy);
+}
+
+static void
+test_item_store_remove_items (void)
+{
+  g_autoptr(GnItemStore) store = NULL;
+  g_autoptr(GPtrArray) items = NULL;
+  g_autoptr(GPtrArray) copy = NULL;
+  g_autoptr(GPtrArray) removals = NULL;
+  guint n_removed;
+
+  store = gn_item_store_new ();
+  copy = g_ptr_array_new ();
+  items = create_items (10);
+  g_signal_connect (store, "items-changed", G_CALLBACK (items_changed_cb), copy);
+
+  gn_item_store_splice (store, 0, 0, items->pdata, 8);
+  get_n_emissions ();
+
+  /* Two ranges, an item given twice, and two items not in store */
+  removals = g_ptr_array_new ();
+  g_ptr_array_add (removals, items->pdata[5]);
+  g_ptr_array_add (removals, items->pdata[1]);
+  g_ptr_array_add (removals, items->pdata[9]);
+  g_ptr_array_add (removals, items->pdata[2]);
+  g_ptr_array_add (removals, items->pdata[6]);
+  g_ptr_array_add (removals, items->pdata[1]);
+  g_ptr_array_add (removals, items->pdata[8]);
+  g_ptr_array_add (removals, items->pdata[3]);
+
+  n_removed = gn_item_store_remove_items (store, (GnItem **)removals->pdata, removals->len);
+  g_assert_cmpint (n_removed, ==, 5);
+  g_assert_cmpint (get_n_emissions (), ==, 2);
+  check_store (store, copy);
+
+  g_assert_true (copy->pdata[0] == items->pdata[0]);
+  g_assert_true (copy->pdata[1] == items->pdata[4]);
+  g_assert_true (copy->pdata[2] == items->pdata[7]);
+
+  n_removed = gn_item_store_remove_items (store, (GnItem **)removals->pdata, removals->len);
+  g_assert_cmpint (n_removed, ==, 0);
+  g_assert_cmpint (get_n_emissions (), ==, 0);
+
+  g_signal_handlers_disconnect_by_data (store, copy);
+}
+
+static void
+test_item_store_insert_items (void)
+{
+  g_autoptr(GnItemStore) store = NULL;
+  g_autoptr(GPtrArray) items = NULL;
+  g_autoptr(GPtrArray) copy = NULL;
+  g_autoptr(GPtrArray) removals = NULL;
+
+  store = gn_item_store_new ();
+  copy = g_ptr_array_new ();
+  items = create_items (10);
+  g_signal_connect (store, "items-changed", G_CALLBACK (items_changed_cb), copy);
+
+  gn_item_store_splice (store, 0, 0, items->pdata, items->len);
+
+  /* Remove two ranges, and restore them in a different order */
+  removals = g_ptr_array_new ();
+  g_ptr_array_add (removals, items->pdata[7]);
+  g_ptr_array_add (removals, items->pdata[2]);
+  g_ptr_array_add (removals, items->pdata[9]);
+  g_ptr_array_add (removals, items->pdata[3]);
+  g_ptr_array_add (removals, items->pdata[0]);
+  g_ptr_array_add (removals, items->pdata[8]);
+  gn_item_store_remove_items (store, (GnItem **)removals->pdata, removals->len);
+  g_assert_cmpint (g_list_model_get_n_items (G_LIST_MODEL (store)), ==, 4);
+  get_n_emissions ();
+
+  gn_item_store_insert_sorted_items (store, (GnItem **)removals->pdata, removals->len,
+                                     gn_item_compare, NULL);
+  g_assert_cmpint (get_n_emissions (), ==, 3);
+  check_store (store, copy);
+
+  for (guint i = 0; i < items->len; i++)
+    g_assert_true (copy->pdata[i] == items->pdata[i]);
+
+  gn_item_store_insert_sorted_items (store, NULL, 0, gn_item_compare, NULL);
+  g_assert_cmpint (get_n_emissions (), ==, 0);
+
+  g_signal_handlers_disconnect_by_data (store, copy);
+}
+
+static void
+test_item_store_random (void)
+{
+  g_autoptr(GnItemStore) store = NULL;
+  g_autoptr(GPtrArray) items = NULL;
+  g_autoptr(GPtrArray) copy = NULL;
+
+  store = gn_item_store_new ();
+  copy = g_ptr_array_new ();
+  items = create_items (200);
+  g_signal_connect (store, "items-changed", G_CALLBACK (items_changed_cb), copy);
+
+  for (guint i = 0; i < 1000; i++)
+    {
+      GnItem *item = items->pdata[g_test_rand_int_range (0, items->len)];
+      guint n_items = g_list_model_get_n_items (G_LIST_MODEL (store));
+
+      if (!gn_item_store_contains (store, item))
+        {
+          if (g_test_rand_bit ())
+            gn_item_store_append (store, item);
+          else
+            gn_item_store_splice (store, g_test_rand_int_range (0, n_items + 1),
+                                  0, (gpointer *)&item, 1);
+        }
+      else if (g_test_rand_bit ())
+        {
+          g_assert_true (gn_item_store_remove_item (store, item));
+        }
+      else
+        {
+          g_autoptr(GPtrArray) removals = g_ptr_array_new ();
+
+          for (guint j = 0; j < 10; j++)
+            g_ptr_array_add (removals, items->pdata[g_test_rand_int_range (0, items->len)]);
+
+          gn_item_store_remove_items (store, (GnItem **)removals->pdata, removals->len);
+        }
+
+      /* Walk in both directions to test cached lookups */
+      if (i % 50 == 0)
+        {
+          check_store (store, copy);
+
+          for (guint j = copy->len; j > 0; j--)
+            {
+              g_autoptr(GnItem) object = g_list_model_get_item (G_LIST_MODEL (store), j - 1);
+
+              g_assert_true (object == copy->pdata[j - 1]);
+            }
+        }
+    }
+
+  check_store (store, copy);
+  g_signal_handlers_disconnect_by_data (store, copy);
+}
+
+static void
+test_item_store_perf (void)
+{
+  g_autoptr(GnItemStore) store = NULL;
+  g_autoptr(GPtrArray) items = NULL;
+  g_autoptr(GPtrArray) removals = NULL;
+  gdouble elapsed, linear_elapsed;
+  guint n_items = 20000;
+  guint n_lookups = 1000;
+  guint n_removed;
+
+  if (!g_test_perf ())
+    return;
+
+  store = gn_item_store_new ();
+  items = create_items (n_items);
+  gn_item_store_splice (store, 0, 0, items->pdata, items->len);
+
+  g_test_timer_start ();
+
+  for (guint i = 0; i < n_lookups; i++)
+    {
+      guint position;
+
+      g_assert_true (gn_item_store_get_position (store, items->pdata[i * 19 % n_items],
+                                                 &position));
+    }
+
+  elapsed = g_test_timer_elapsed ();
+
+  g_test_timer_start ();
+
+  for (guint i = 0; i < n_lookups; i++)
+    {
+      guint position;
+
+      g_assert_true (gn_utils_get_item_position (G_LIST_MODEL (store),
+                                                 items->pdata[i * 19 % n_items],
+                                                 &position));
+    }
+
+  linear_elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed * 1000,
+                           "Found %u of %u items in %.3f ms "
+                           "(walking the list: %.3f ms)",
+                           n_lookups, n_items, elapsed * 1000,
+                           linear_elapsed * 1000);
+
+  /* Remove every fourth item, the worst case for ranges */
+  removals = g_ptr_array_new ();
+
+  for (guint i = 0; i < n_items; i += 4)
+    g_ptr_array_add (removals, items->pdata[i]);
+
+  g_test_timer_start ();
+  n_removed = gn_item_store_remove_items (store, (GnItem **)removals->pdata, removals->len);
+  elapsed = g_test_timer_elapsed ();
+
+  g_assert_cmpint (n_removed, ==, n_items / 4);
+  g_test_minimized_result (elapsed * 1000, "Removed %u of %u items in %.3f ms",
+                           n_removed, n_items, elapsed * 1000);
+
+  g_test_timer_start ();
+  gn_item_store_insert_sorted_items (store, (GnItem **)removals->pdata, removals->len,
+                                     gn_item_compare, NULL);
+  elapsed = g_test_timer_elapsed ();
+
+  g_assert_cmpint (g_list_model_get_n_items (G_LIST_MODEL (store)), ==, n_items);
+  g_test_minimized_result (elapsed * 1000, "Restored %u of %u items in %.3f ms",
+                           removals->len, n_items, elapsed * 1000);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/item-store/basic", test_item_store_basic);
+  g_test_add_func ("/item-store/remove-items", test_item_store_remove_items);
+  g_test_add_func ("/item-store/insert-items", test_item_store_insert_items);
+  g_test_add_func ("/item-store/random", test_item_store_random);
+  g_test_add_func ("/item-store/perf", test_item_store_perf);
+
+  return g_test_run ();
+}
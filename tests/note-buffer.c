@@ -19,10 +19,21 @@
  */
 
 #include <glib.h>
+#include <string.h>
+
+#define XML_NOTE_HEAD \
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" \
+  "<note version=\"2\" xmlns:link=\"http://projects.gnome.org/bijiben/link\" " \
+  "xmlns:size=\"http://projects.gnome.org/bijiben/size\" " \
+  "xmlns=\"http://projects.gnome.org/bijiben\">\n" \
+  "<title>Shopping list</title>\n" \
+  "<text xml:space=\"preserve\"><note-content>"
+#define XML_NOTE_TAIL "</note-content></text></note>\n"
 
 #include "notes/gn-item.h"
 #include "notes/gn-note.h"
 #include "notes/gn-plain-note.h"
+#include "notes/gn-xml-note.h"
 #include "notes/gn-note-buffer.h"
 
 void
@@ -83,6 +94,444 @@ test_note_buffer_plain (void)
   g_assert_cmpstr (content, ==, "Random title 🐐");
 }
 
+static void
+assert_tag_range (GtkTextBuffer *buffer,
+                  const gchar   *tag_name,
+                  gint           start_offset,
+                  gint           end_offset)
+{
+  GtkTextTag *tag;
+  GtkTextIter start, end;
+
+  tag = gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (buffer),
+                                   tag_name);
+  g_assert_nonnull (tag);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, start_offset);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, end_offset);
+  g_assert_true (gtk_text_iter_starts_tag (&start, tag));
+  g_assert_true (gtk_text_iter_ends_tag (&end, tag));
+
+  gtk_text_iter_forward_to_tag_toggle (&start, tag);
+  g_assert_true (gtk_text_iter_equal (&start, &end));
+}
+
+void
+test_note_buffer_xml (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  g_autofree gchar *content = NULL;
+
+  xml_note = gn_xml_note_new_from_data (XML_NOTE_HEAD
+                                        "Milk, <b>eggs &amp; <i>br€ad</i></b>\n"
+                                        "<u>End</u>"
+                                        XML_NOTE_TAIL, -1, NULL);
+
+  buffer = GTK_TEXT_BUFFER (gn_note_buffer_new ());
+  gn_note_set_content_to_buffer (GN_NOTE (xml_note), GN_NOTE_BUFFER (buffer));
+
+  g_object_get (G_OBJECT (buffer), "text", &content, NULL);
+  g_assert_cmpstr (content, ==, "Shopping list\nMilk, eggs & br€ad\nEnd");
+  g_assert_false (gtk_text_buffer_get_modified (buffer));
+
+  assert_tag_range (buffer, "title", 0, 14);
+  assert_tag_range (buffer, "b", 20, 32);
+  assert_tag_range (buffer, "i", 27, 32);
+  assert_tag_range (buffer, "u", 33, 36);
+}
+
+void
+test_note_buffer_xml_save (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  g_autofree gchar *content = NULL;
+  GtkTextIter start, end;
+
+  buffer = GTK_TEXT_BUFFER (gn_note_buffer_new ());
+  gtk_text_buffer_set_text (buffer, "Title\nabcdefghi\n\"x\" & <y>", -1);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, 6);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, 12);
+  gtk_text_buffer_apply_tag_by_name (buffer, "b", &start, &end);
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, 9);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, 15);
+  gtk_text_buffer_apply_tag_by_name (buffer, "i", &start, &end);
+
+  xml_note = gn_xml_note_new_from_data (NULL, 0, NULL);
+  gn_note_set_content_from_buffer (GN_NOTE (xml_note), buffer);
+
+  g_assert_cmpstr (gn_item_get_title (GN_ITEM (xml_note)), ==, "Title");
+  content = gn_note_get_raw_content (GN_NOTE (xml_note));
+  g_assert_nonnull (strstr (content, "<note-content>"
+                            "<b>abc<i>def</i></b><i>ghi</i>\n"
+                            "&quot;x&quot; &amp; &lt;y&gt;"
+                            "</note-content>"));
+  g_clear_pointer (&content, g_free);
+
+  /* The content should survive a round trip through the buffer */
+  g_clear_object (&xml_note);
+  xml_note = gn_xml_note_new_from_data (XML_NOTE_HEAD
+                                        "Milk, <b>eggs &amp; <i>br€ad</i></b>\n"
+                                        "<u>End</u>"
+                                        XML_NOTE_TAIL, -1, NULL);
+  gn_note_set_content_to_buffer (GN_NOTE (xml_note), GN_NOTE_BUFFER (buffer));
+  gn_note_set_content_from_buffer (GN_NOTE (xml_note), buffer);
+
+  content = gn_note_get_raw_content (GN_NOTE (xml_note));
+  g_assert_nonnull (strstr (content, "<note-content>"
+                            "Milk, <b>eggs &amp; <i>br€ad</i></b>\n"
+                            "<u>End</u>"
+                            "</note-content>"));
+  g_clear_pointer (&content, g_free);
+
+  /* Tags spanning lines are kept open, as in the file */
+  g_clear_object (&xml_note);
+  xml_note = gn_xml_note_new_from_data (XML_NOTE_HEAD
+                                        "<b>Milk\n<i>eggs</b>\nbr€ad</i>\n<u>End\n</u>"
+                                        XML_NOTE_TAIL, -1, NULL);
+  gn_note_set_content_to_buffer (GN_NOTE (xml_note), GN_NOTE_BUFFER (buffer));
+  gn_note_set_content_from_buffer (GN_NOTE (xml_note), buffer);
+
+  content = gn_note_get_raw_content (GN_NOTE (xml_note));
+  g_assert_nonnull (strstr (content, "<note-content>"
+                            "<b>Milk\n<i>eggs</i></b><i>\nbr€ad</i>\n<u>End\n</u>"
+                            "</note-content>"));
+}
+
+void
+test_note_buffer_changed_lines (void)
+{
+  g_autoptr(GnNoteBuffer) note_buffer = NULL;
+  GtkTextBuffer *buffer;
+  GtkTextIter start, end;
+  guint serial, head, tail;
+
+  note_buffer = gn_note_buffer_new ();
+  buffer = GTK_TEXT_BUFFER (note_buffer);
+  gtk_text_buffer_set_text (buffer, "Title\none\ntwo\nthree\nfour", -1);
+
+  /* Changes are tracked only after a reset */
+  g_assert_false (gn_note_buffer_get_changed_lines (note_buffer, 0, &head, &tail));
+
+  serial = gn_note_buffer_reset_changes (note_buffer);
+  g_assert_cmpint (serial, !=, 0);
+  g_assert_true (gn_note_buffer_get_changed_lines (note_buffer, serial, &head, &tail));
+  g_assert_cmpint (head, ==, 5);
+  g_assert_cmpint (tail, ==, 0);
+
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 2);
+  gtk_text_buffer_insert (buffer, &start, "X", -1);
+  g_assert_true (gn_note_buffer_get_changed_lines (note_buffer, serial, &head, &tail));
+  g_assert_cmpint (head, ==, 2);
+  g_assert_cmpint (tail, ==, 2);
+
+  /* Splitting a line changes both the lines */
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 3);
+  gtk_text_buffer_insert (buffer, &start, "\n", -1);
+  g_assert_true (gn_note_buffer_get_changed_lines (note_buffer, serial, &head, &tail));
+  g_assert_cmpint (head, ==, 2);
+  g_assert_cmpint (tail, ==, 1);
+
+  /* Joining lines at the end */
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 4);
+  gtk_text_buffer_get_end_iter (buffer, &end);
+  gtk_text_buffer_delete (buffer, &start, &end);
+  g_assert_true (gn_note_buffer_get_changed_lines (note_buffer, serial, &head, &tail));
+  g_assert_cmpint (head, ==, 2);
+  g_assert_cmpint (tail, ==, 0);
+
+  serial = gn_note_buffer_reset_changes (note_buffer);
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 1);
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &end, 1, 2);
+  gtk_text_buffer_apply_tag_by_name (buffer, "b", &start, &end);
+  g_assert_true (gn_note_buffer_get_changed_lines (note_buffer, serial, &head, &tail));
+  g_assert_cmpint (head, ==, 1);
+  g_assert_cmpint (tail, ==, 3);
+
+  /* Another reset invalidates the older serial */
+  gn_note_buffer_reset_changes (note_buffer);
+  g_assert_false (gn_note_buffer_get_changed_lines (note_buffer, serial, &head, &tail));
+}
+
+void
+test_note_buffer_xml_incremental_save (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autoptr(GnXmlNote) new_note = NULL;
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  g_autofree gchar *content = NULL;
+  g_autofree gchar *expected = NULL;
+  GtkTextIter start, end;
+
+  xml_note = gn_xml_note_new_from_data (XML_NOTE_HEAD
+                                        "one\n<b>two</b>\nthree\n<i>four</i>"
+                                        XML_NOTE_TAIL, -1, NULL);
+  buffer = GTK_TEXT_BUFFER (gn_note_buffer_new ());
+  gn_note_set_content_to_buffer (GN_NOTE (xml_note), GN_NOTE_BUFFER (buffer));
+  gn_note_set_content_from_buffer (GN_NOTE (xml_note), buffer);
+
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 3);
+  gtk_text_buffer_insert (buffer, &start, "X&", -1);
+  gn_note_set_content_from_buffer (GN_NOTE (xml_note), buffer);
+
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &start, 3, 4);
+  gtk_text_buffer_insert (buffer, &start, "\n", -1);
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 1);
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &end, 1, 2);
+  gtk_text_buffer_apply_tag_by_name (buffer, "u", &start, &end);
+  gn_note_set_content_from_buffer (GN_NOTE (xml_note), buffer);
+
+  gtk_text_buffer_get_iter_at_line (buffer, &start, 4);
+  gtk_text_buffer_get_iter_at_line (buffer, &end, 5);
+  gtk_text_buffer_delete (buffer, &start, &end);
+  gn_note_set_content_from_buffer (GN_NOTE (xml_note), buffer);
+
+  content = gn_note_get_raw_content (GN_NOTE (xml_note));
+  g_assert_nonnull (strstr (content, "<note-content>"
+                            "<u>on</u>e\n"
+                            "<b>two</b>\n"
+                            "X&amp;th\n"
+                            "<i>four</i>"
+                            "</note-content>"));
+
+  /* The result should be the same as that of a full save */
+  new_note = gn_xml_note_new_from_data (NULL, 0, NULL);
+  gn_note_set_content_from_buffer (GN_NOTE (new_note), buffer);
+  expected = gn_note_get_raw_content (GN_NOTE (new_note));
+  g_assert_cmpstr (strstr (content, "<note-content>"), ==,
+                   strstr (expected, "<note-content>"));
+}
+
+void
+test_note_buffer_snapshot (void)
+{
+  g_autoptr(GnNoteSnapshot) snapshot = NULL;
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  const GnTextRun *runs;
+  GtkTextIter start, end;
+  guint n_runs;
+  gsize length;
+
+  buffer = GTK_TEXT_BUFFER (gn_note_buffer_new ());
+  gtk_text_buffer_set_text (buffer, "Title\nabc€ef\ngh", -1);
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, 8);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, 14);
+  gtk_text_buffer_apply_tag_by_name (buffer, "b", &start, &end);
+
+  snapshot = gn_note_snapshot_new (buffer);
+
+  g_assert_cmpstr (gn_note_snapshot_get_title (snapshot), ==, "Title");
+  g_assert_cmpstr (gn_note_snapshot_get_text (snapshot, &length), ==, "abc€ef\ngh");
+  g_assert_cmpint (length, ==, strlen ("abc€ef\ngh"));
+  g_assert_cmpint (gn_note_snapshot_get_n_lines (snapshot), ==, 2);
+
+  /* Offsets are in bytes, "€" is 3 bytes long */
+  runs = gn_note_snapshot_get_runs (snapshot, &n_runs);
+  g_assert_cmpint (n_runs, ==, 3);
+  g_assert_cmpint (runs[0].end, ==, 2);
+  g_assert_cmpint (runs[0].tags, ==, 0);
+  g_assert_cmpint (runs[1].end, ==, 10);
+  g_assert_cmpint (runs[1].tags, ==, GN_TEXT_TAG_BOLD);
+  g_assert_cmpint (runs[2].end, ==, length);
+  g_assert_cmpint (runs[2].tags, ==, 0);
+
+  /* The snapshot doesn't change with the buffer */
+  gtk_text_buffer_set_text (buffer, "", -1);
+  g_assert_cmpstr (gn_note_snapshot_get_text (snapshot, NULL), ==, "abc€ef\ngh");
+}
+
+static void
+snapshot_saved_cb (GObject      *object,
+                   GAsyncResult *result,
+                   gpointer      user_data)
+{
+  g_autoptr(GError) error = NULL;
+  GMainLoop *loop = user_data;
+
+  g_assert_true (gn_note_set_content_from_snapshot_finish (GN_NOTE (object),
+                                                           result, &error));
+  g_assert_no_error (error);
+  g_main_loop_quit (loop);
+}
+
+void
+test_note_buffer_xml_async_save (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autoptr(GnNoteSnapshot) snapshot = NULL;
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  g_autoptr(GMainLoop) loop = NULL;
+  g_autofree gchar *content = NULL;
+  GtkTextIter start, end;
+
+  buffer = GTK_TEXT_BUFFER (gn_note_buffer_new ());
+  gtk_text_buffer_set_text (buffer, "Title\nSome bold", -1);
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, 11);
+  gtk_text_buffer_get_end_iter (buffer, &end);
+  gtk_text_buffer_apply_tag_by_name (buffer, "b", &start, &end);
+
+  xml_note = gn_xml_note_new_from_data (NULL, 0, NULL);
+  snapshot = gn_note_snapshot_new (buffer);
+
+  /* Changes after the snapshot shouldn't be saved */
+  gtk_text_buffer_set_text (buffer, "Changed", -1);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  gn_note_set_content_from_snapshot_async (GN_NOTE (xml_note), snapshot, NULL,
+                                           snapshot_saved_cb, loop);
+  g_main_loop_run (loop);
+
+  g_assert_cmpstr (gn_item_get_title (GN_ITEM (xml_note)), ==, "Title");
+  content = gn_note_get_raw_content (GN_NOTE (xml_note));
+  g_assert_nonnull (strstr (content, "<note-content>Some <b>bold</b></note-content>"));
+}
+
+static GnXmlNote *
+create_large_note (gsize size)
+{
+  GnXmlNote *xml_note;
+  GString *data;
+
+  /* A heavily formatted note of about @size bytes */
+  data = g_string_new (XML_NOTE_HEAD);
+  while (data->len < size)
+    g_string_append (data, "Some <b>bold</b> and <i>italic <u>underlined</u></i> "
+                     "text &amp; <s>more</s>\n");
+  g_string_append (data, XML_NOTE_TAIL);
+
+  xml_note = gn_xml_note_new_from_data (data->str, data->len, NULL);
+  g_string_free (data, TRUE);
+
+  return xml_note;
+}
+
+void
+test_note_buffer_xml_load_perf (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  gdouble elapsed;
+  guint n_loads = 10;
+
+  if (!g_test_perf ())
+    return;
+
+  xml_note = create_large_note (1024 * 1024);
+  buffer = GTK_TEXT_BUFFER (gn_note_buffer_new ());
+  g_test_timer_start ();
+
+  for (guint i = 0; i < n_loads; i++)
+    gn_note_set_content_to_buffer (GN_NOTE (xml_note), GN_NOTE_BUFFER (buffer));
+
+  elapsed = g_test_timer_elapsed ();
+  g_assert_cmpint (gtk_text_buffer_get_line_count (buffer), >, 1);
+  g_test_minimized_result (elapsed * 1000 / n_loads,
+                           "Loaded 1 MiB note %u times in %.3f seconds, "
+                           "%.2f ms per load", n_loads, elapsed,
+                           elapsed * 1000 / n_loads);
+}
+
+void
+test_note_buffer_xml_save_perf (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  gdouble elapsed;
+  guint n_saves = 10;
+
+  if (!g_test_perf ())
+    return;
+
+  xml_note = create_large_note (1024 * 1024);
+  buffer = GTK_TEXT_BUFFER (gn_note_buffer_new ());
+  gn_note_set_content_to_buffer (GN_NOTE (xml_note), GN_NOTE_BUFFER (buffer));
+  g_test_timer_start ();
+
+  for (guint i = 0; i < n_saves; i++)
+    gn_note_set_content_from_buffer (GN_NOTE (xml_note), buffer);
+
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed * 1000 / n_saves,
+                           "Saved 1 MiB note %u times in %.3f seconds, "
+                           "%.2f ms per save", n_saves, elapsed,
+                           elapsed * 1000 / n_saves);
+}
+
+void
+test_note_buffer_xml_autosave_perf (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  GtkTextIter iter;
+  gdouble elapsed;
+  guint n_saves = 100;
+
+  if (!g_test_perf ())
+    return;
+
+  xml_note = create_large_note (5 * 1024 * 1024);
+  buffer = GTK_TEXT_BUFFER (gn_note_buffer_new ());
+  gn_note_set_content_to_buffer (GN_NOTE (xml_note), GN_NOTE_BUFFER (buffer));
+  gn_note_set_content_from_buffer (GN_NOTE (xml_note), buffer);
+  g_test_timer_start ();
+
+  /* Type a character, and save, like an autosave would do */
+  for (guint i = 0; i < n_saves; i++)
+    {
+      gtk_text_buffer_get_iter_at_line (buffer, &iter, 1 + i * 100);
+      gtk_text_buffer_insert (buffer, &iter, "x", 1);
+      gn_note_set_content_from_buffer (GN_NOTE (xml_note), buffer);
+    }
+
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed * 1000 / n_saves,
+                           "Saved 5 MiB note after an edit %u times in %.3f seconds, "
+                           "%.2f ms per save", n_saves, elapsed,
+                           elapsed * 1000 / n_saves);
+}
+
+/*
+ * Compare the time spent in the main thread on every autosave:
+ * serializing the whole note there, and taking a snapshot to be
+ * serialized in a thread.
+ */
+void
+test_note_buffer_save_latency_perf (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autoptr(GtkTextBuffer) buffer = NULL;
+  gdouble serialize_time, snapshot_time;
+  guint n_saves = 10;
+
+  if (!g_test_perf ())
+    return;
+
+  xml_note = create_large_note (5 * 1024 * 1024);
+  buffer = GTK_TEXT_BUFFER (gn_note_buffer_new ());
+  gn_note_set_content_to_buffer (GN_NOTE (xml_note), GN_NOTE_BUFFER (buffer));
+
+  g_test_timer_start ();
+  for (guint i = 0; i < n_saves; i++)
+    {
+      g_autoptr(GnXmlNote) note = gn_xml_note_new_from_data (NULL, 0, NULL);
+
+      gn_note_set_content_from_buffer (GN_NOTE (note), buffer);
+    }
+  serialize_time = g_test_timer_elapsed () * 1000 / n_saves;
+
+  g_test_timer_start ();
+  for (guint i = 0; i < n_saves; i++)
+    gn_note_snapshot_unref (gn_note_snapshot_new (buffer));
+  snapshot_time = g_test_timer_elapsed () * 1000 / n_saves;
+
+  g_test_message ("Serializing a 5 MiB note in the main thread: %.2f ms", serialize_time);
+  g_test_minimized_result (snapshot_time,
+                           "Taking a snapshot of a 5 MiB note: %.2f ms",
+                           snapshot_time);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -91,6 +540,17 @@ main (int   argc,
 
   g_test_add_func ("/note/buffer/empty", test_note_buffer_empty);
   g_test_add_func ("/note/buffer/plain", test_note_buffer_plain);
+  g_test_add_func ("/note/buffer/xml", test_note_buffer_xml);
+  g_test_add_func ("/note/buffer/xml-save", test_note_buffer_xml_save);
+  g_test_add_func ("/note/buffer/changed-lines", test_note_buffer_changed_lines);
+  g_test_add_func ("/note/buffer/xml-incremental-save",
+                   test_note_buffer_xml_incremental_save);
+  g_test_add_func ("/note/buffer/snapshot", test_note_buffer_snapshot);
+  g_test_add_func ("/note/buffer/xml-async-save", test_note_buffer_xml_async_save);
+  g_test_add_func ("/note/buffer/perf/xml-load", test_note_buffer_xml_load_perf);
+  g_test_add_func ("/note/buffer/perf/xml-save", test_note_buffer_xml_save_perf);
+  g_test_add_func ("/note/buffer/perf/xml-autosave", test_note_buffer_xml_autosave_perf);
+  g_test_add_func ("/note/buffer/perf/save-latency", test_note_buffer_save_latency_perf);
 
   return g_test_run ();
 }
@@ -326,6 +326,121 @@ test_plain_note_time (void)
   g_assert_cmpint (gn_item_get_modification_time (item), ==, 0);
 }
 
+static void
+test_plain_note_compare (void)
+{
+  g_autoptr(GnPlainNote) apple = NULL;
+  g_autoptr(GnPlainNote) banana = NULL;
+  GnItem *a, *b;
+
+  apple = gn_plain_note_new_from_data ("apple", -1);
+  banana = gn_plain_note_new_from_data ("Banana", -1);
+  a = GN_ITEM (apple);
+  b = GN_ITEM (banana);
+
+  g_assert_cmpint (gn_item_compare (a, b, NULL), <, 0);
+  g_assert_cmpint (gn_item_compare (b, a, NULL), >, 0);
+  g_assert_cmpint (gn_item_compare (a, a, NULL), ==, 0);
+
+  /* The order should follow title changes */
+  gn_item_set_title (a, "Cherry");
+  g_assert_cmpint (gn_item_compare (a, b, NULL), >, 0);
+  gn_item_set_title (b, "CHERRY");
+  g_assert_cmpint (gn_item_compare (a, b, NULL), ==, 0);
+}
+
+static void
+test_plain_note_compare_modes (void)
+{
+  g_autoptr(GnPlainNote) apple = NULL;
+  g_autoptr(GnPlainNote) banana = NULL;
+  GdkRGBA red = { 0.9, 0.1, 0.1, 1.0 };
+  GdkRGBA blue = { 0.1, 0.1, 0.9, 1.0 };
+  GnItem *a, *b;
+
+  apple = gn_plain_note_new_from_data ("apple", -1);
+  banana = gn_plain_note_new_from_data ("banana", -1);
+  a = GN_ITEM (apple);
+  b = GN_ITEM (banana);
+
+  /* Same time and no color, so compared by title */
+  g_assert_cmpint (gn_item_compare_modification_time (a, b, NULL), <, 0);
+  g_assert_cmpint (gn_item_compare_creation_time (a, b, NULL), <, 0);
+  g_assert_cmpint (gn_item_compare_color (a, b, NULL), <, 0);
+
+  /* The recent ones first */
+  g_object_set (b, "modification-time", (gint64)200, "creation-time", (gint64)100, NULL);
+  g_object_set (a, "modification-time", (gint64)100, "creation-time", (gint64)200, NULL);
+  g_assert_cmpint (gn_item_compare_modification_time (a, b, NULL), >, 0);
+  g_assert_cmpint (gn_item_compare_modification_time (b, a, NULL), <, 0);
+  g_assert_cmpint (gn_item_compare_creation_time (a, b, NULL), <, 0);
+  g_assert_cmpint (gn_item_compare_creation_time (b, a, NULL), >, 0);
+
+  /* Colored items first, and by hue */
+  gn_item_set_rgba (b, &blue);
+  g_assert_cmpint (gn_item_compare_color (a, b, NULL), >, 0);
+  g_assert_cmpint (gn_item_compare_color (b, a, NULL), <, 0);
+  gn_item_set_rgba (a, &red);
+  g_assert_cmpint (gn_item_compare_color (a, b, NULL), <, 0);
+  gn_item_set_rgba (a, &blue);
+  g_assert_cmpint (gn_item_compare_color (a, b, NULL), <, 0);
+  g_assert_cmpint (gn_item_compare_color (a, a, NULL), ==, 0);
+}
+
+/* Compare by allocating casefolded titles each time, as done before */
+static gint
+compare_casefold (gconstpointer a,
+                  gconstpointer b,
+                  gpointer      user_data)
+{
+  g_autofree gchar *title_a = NULL;
+  g_autofree gchar *title_b = NULL;
+
+  title_a = g_utf8_casefold (gn_item_get_title ((GnItem *)a), -1);
+  title_b = g_utf8_casefold (gn_item_get_title ((GnItem *)b), -1);
+
+  return g_strcmp0 (title_a, title_b);
+}
+
+static void
+test_plain_note_sort_perf (void)
+{
+  g_autoptr(GListStore) store = NULL;
+  g_autoptr(GListStore) casefold_store = NULL;
+  g_autoptr(GPtrArray) notes = NULL;
+  gdouble elapsed, casefold_elapsed;
+  guint n_items = 40000;
+
+  if (!g_test_perf ())
+    return;
+
+  notes = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autofree gchar *title = NULL;
+
+      title = g_strdup_printf ("Note %u", g_test_rand_int ());
+      g_ptr_array_add (notes, gn_plain_note_new_from_data (title, -1));
+    }
+
+  store = g_list_store_new (GN_TYPE_ITEM);
+  g_test_timer_start ();
+  for (guint i = 0; i < notes->len; i++)
+    g_list_store_insert_sorted (store, notes->pdata[i], gn_item_compare, NULL);
+  elapsed = g_test_timer_elapsed ();
+
+  casefold_store = g_list_store_new (GN_TYPE_ITEM);
+  g_test_timer_start ();
+  for (guint i = 0; i < notes->len; i++)
+    g_list_store_insert_sorted (casefold_store, notes->pdata[i], compare_casefold, NULL);
+  casefold_elapsed = g_test_timer_elapsed ();
+
+  g_test_minimized_result (elapsed, "Inserted %u sorted items in %.3f seconds "
+                           "(casefolding each time: %.3f seconds)",
+                           n_items, elapsed, casefold_elapsed);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -340,6 +455,9 @@ main (int   argc,
   g_test_add_func ("/note/plain/markup", test_plain_note_markup);
   g_test_add_func ("/note/plain/search", test_plain_note_search);
   g_test_add_func ("/note/plain/time", test_plain_note_time);
+  g_test_add_func ("/note/plain/compare", test_plain_note_compare);
+  g_test_add_func ("/note/plain/compare-modes", test_plain_note_compare_modes);
+  g_test_add_func ("/note/plain/perf/sort", test_plain_note_sort_perf);
 
   return g_test_run ();
 }
@@ -0,0 +1,62 @@
+/* search-fixture.h
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+static const gchar *words[] = {
+  "apple", "banana", "cherry", "grape", "lemon", "mango", "orange",
+  "peach", "pear", "plum", "milk", "bread", "butter", "cheese", "eggs",
+  "flour", "sugar", "salt", "pepper", "rice", "tea", "coffee", "honey",
+  "jam", "meeting", "notes", "monday", "friday", "call", "email",
+};
+
+/*
+ * Create a random text of @n_words words from words[], preceded
+ * by a title line of one word if @with_title is %TRUE
+ */
+static inline gchar *
+create_text (guint    n_words,
+             gboolean with_title)
+{
+  GString *text;
+
+  text = g_string_new (NULL);
+
+  if (with_title)
+    {
+      g_string_append (text, words[g_test_rand_int_range (0, G_N_ELEMENTS (words))]);
+      g_string_append_c (text, '\n');
+    }
+
+  for (guint i = 0; i < n_words; i++)
+    {
+      if (i > 0)
+        g_string_append_c (text, ' ');
+      g_string_append (text, words[g_test_rand_int_range (0, G_N_ELEMENTS (words))]);
+    }
+
+  return g_string_free (text, FALSE);
+}
+
+G_END_DECLS
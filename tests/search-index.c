@@ -0,0 +1,340 @@
+/* search-index.c
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "gn-search-index.h"
+#include "search-fixture.h"
+
+static void
+test_search_index_lookup (void)
+{
+  GnSearchIndex *index;
+  GHashTable *items;
+  gchar *a = "a", *b = "b", *c = "c";
+
+  index = gn_search_index_new (NULL);
+  gn_search_index_add (index, a, "shopping list\nmilk, bread");
+  gn_search_index_add (index, b, "meeting notes\nmonday");
+  gn_search_index_add (index, c, "bread recipe\nflour, salt");
+  g_assert_cmpint (gn_search_index_get_n_items (index), ==, 3);
+  g_assert_true (gn_search_index_contains (index, a));
+
+  items = gn_search_index_lookup (index, "bread");
+  g_assert_nonnull (items);
+  g_assert_cmpint (g_hash_table_size (items), ==, 2);
+  g_assert_true (g_hash_table_contains (items, a));
+  g_assert_true (g_hash_table_contains (items, c));
+  g_hash_table_unref (items);
+
+  items = gn_search_index_lookup (index, "tuesday");
+  g_assert_nonnull (items);
+  g_assert_cmpint (g_hash_table_size (items), ==, 0);
+  g_hash_table_unref (items);
+
+  /* Too short to be looked up in the index */
+  g_assert_null (gn_search_index_lookup (index, "mi"));
+  g_assert_null (gn_search_index_lookup (index, ""));
+
+  /* Replace the text of an item */
+  gn_search_index_add (index, c, "cake recipe\nsugar");
+  g_assert_cmpint (gn_search_index_get_n_items (index), ==, 3);
+  items = gn_search_index_lookup (index, "bread");
+  g_assert_cmpint (g_hash_table_size (items), ==, 1);
+  g_assert_true (g_hash_table_contains (items, a));
+  g_hash_table_unref (items);
+  items = gn_search_index_lookup (index, "recipe");
+  g_assert_cmpint (g_hash_table_size (items), ==, 1);
+  g_assert_true (g_hash_table_contains (items, c));
+  g_hash_table_unref (items);
+
+  g_assert_true (gn_search_index_remove (index, a));
+  g_assert_false (gn_search_index_remove (index, a));
+  g_assert_false (gn_search_index_contains (index, a));
+  items = gn_search_index_lookup (index, "bread");
+  g_assert_cmpint (g_hash_table_size (items), ==, 0);
+  g_hash_table_unref (items);
+
+  /* Non ASCII text is indexed as bytes */
+  gn_search_index_add (index, a, "crème brûlée");
+  items = gn_search_index_lookup (index, "brûl");
+  g_assert_cmpint (g_hash_table_size (items), ==, 1);
+  g_assert_true (g_hash_table_contains (items, a));
+  g_hash_table_unref (items);
+
+  gn_search_index_free (index);
+}
+
+static void
+test_search_index_random (void)
+{
+  GnSearchIndex *index;
+  GPtrArray *texts;
+
+  index = gn_search_index_new (NULL);
+  texts = g_ptr_array_new_with_free_func (g_free);
+
+  for (guint i = 0; i < 500; i++)
+    {
+      gchar *text = create_text (g_test_rand_int_range (0, 20), FALSE);
+
+      g_ptr_array_add (texts, text);
+      gn_search_index_add (index, text, text);
+    }
+
+  /* Remove some, so that there are holes in the lists */
+  for (guint i = 0; i < texts->len; i += 7)
+    g_assert_true (gn_search_index_remove (index, texts->pdata[i]));
+
+  for (guint i = 0; i < G_N_ELEMENTS (words); i++)
+    {
+      g_autoptr(GHashTable) items = NULL;
+      const gchar *needle = words[i];
+
+      items = gn_search_index_lookup (index, needle);
+      g_assert_nonnull (items);
+
+      /* Every item having the needle should be found */
+      for (guint j = 0; j < texts->len; j++)
+        {
+          gboolean indexed = j % 7 != 0;
+
+          if (indexed && strstr (texts->pdata[j], needle) != NULL)
+            g_assert_true (g_hash_table_contains (items, texts->pdata[j]));
+
+          if (!indexed)
+            g_assert_false (g_hash_table_contains (items, texts->pdata[j]));
+        }
+    }
+
+  gn_search_index_free (index);
+  g_ptr_array_unref (texts);
+}
+
+static gboolean
+match_text (gpointer     item,
+            const gchar *needle,
+            gpointer     user_data)
+{
+  guint *n_matches = user_data;
+
+  if (n_matches != NULL)
+    (*n_matches)++;
+
+  return strstr (item, needle) != NULL;
+}
+
+static void
+test_search_index_search (void)
+{
+  GnSearchIndex *index;
+  GPtrArray *texts;
+  const gchar *needles[] = { "m", "me", "mee", "meet", "meeti", "meetin",
+                             "meeting", "meetin", "meet", "m", "meeting m" };
+  gchar *item = "meeting";
+  GHashTable *items;
+  guint last_size = G_MAXUINT;
+
+  index = gn_search_index_new (NULL);
+  texts = g_ptr_array_new_with_free_func (g_free);
+
+  for (guint i = 0; i < 500; i++)
+    {
+      gchar *text = create_text (g_test_rand_int_range (0, 20), FALSE);
+
+      g_ptr_array_add (texts, text);
+      gn_search_index_add (index, text, text);
+    }
+
+  for (guint i = 0; i < G_N_ELEMENTS (needles); i++)
+    {
+      guint n_matches = 0;
+      guint n_expected = 0;
+
+      items = gn_search_index_search (index, needles[i], match_text, &n_matches);
+
+      for (guint j = 0; j < texts->len; j++)
+        {
+          gboolean has_needle = strstr (texts->pdata[j], needles[i]) != NULL;
+
+          n_expected += has_needle;
+          g_assert_cmpint (has_needle, ==, g_hash_table_contains (items, texts->pdata[j]));
+        }
+
+      g_assert_cmpint (g_hash_table_size (items), ==, n_expected);
+
+      /* The needle grows from "mee" till "meeting", so only the last results are checked */
+      if (i > 2 && i < 7)
+        g_assert_cmpint (n_matches, <=, last_size);
+
+      /* The needles were searched before */
+      if (i >= 7 && i < 10)
+        g_assert_cmpint (n_matches, ==, 0);
+
+      last_size = g_hash_table_size (items);
+      g_hash_table_unref (items);
+    }
+
+  /* Adding an item should invalidate the results */
+  gn_search_index_add (index, item, item);
+  items = gn_search_index_search (index, "meeting", match_text, NULL);
+  g_assert_true (g_hash_table_contains (items, item));
+  g_hash_table_unref (items);
+
+  gn_search_index_free (index);
+  g_ptr_array_unref (texts);
+}
+
+static void
+test_search_index_free_func (void)
+{
+  GnSearchIndex *index;
+
+  /* Leaks are reported by valgrind or asan, if any */
+  index = gn_search_index_new (g_free);
+  gn_search_index_add (index, g_strdup ("a"), "first item");
+  gn_search_index_add (index, g_strdup ("b"), "second item");
+  gn_search_index_add (index, g_strdup ("c"), "");
+  g_assert_cmpint (gn_search_index_get_n_items (index), ==, 3);
+  gn_search_index_free (index);
+}
+
+static void
+test_search_index_lookup_perf (void)
+{
+  GnSearchIndex *index;
+  GPtrArray *texts;
+  gdouble elapsed;
+  guint n_items = 50000;
+  guint n_lookups = 1000;
+  guint n_found = 0;
+
+  if (!g_test_perf ())
+    return;
+
+  index = gn_search_index_new (NULL);
+  texts = g_ptr_array_new_with_free_func (g_free);
+
+  g_test_timer_start ();
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      gchar *text = create_text (100, FALSE);
+
+      g_ptr_array_add (texts, text);
+      gn_search_index_add (index, text, text);
+    }
+
+  elapsed = g_test_timer_elapsed ();
+  g_test_message ("Indexed %u items in %.3f seconds", n_items, elapsed);
+
+  g_test_timer_start ();
+
+  for (guint i = 0; i < n_lookups; i++)
+    {
+      g_autoptr(GHashTable) items = NULL;
+      g_autofree gchar *needle = NULL;
+
+      needle = g_strdup_printf ("%s %s",
+                                words[i % G_N_ELEMENTS (words)],
+                                words[(i / G_N_ELEMENTS (words)) % G_N_ELEMENTS (words)]);
+      items = gn_search_index_lookup (index, needle);
+      n_found += g_hash_table_size (items);
+    }
+
+  elapsed = g_test_timer_elapsed ();
+  g_test_message ("Found %u items in total", n_found);
+  g_test_minimized_result (elapsed * 1000 / n_lookups,
+                           "Looked up %u items %u times in %.3f seconds, "
+                           "%.3f ms per lookup", n_items, n_lookups, elapsed,
+                           elapsed * 1000 / n_lookups);
+
+  gn_search_index_free (index);
+  g_ptr_array_unref (texts);
+}
+
+static void
+test_search_index_typing_perf (void)
+{
+  GnSearchIndex *index;
+  GPtrArray *texts;
+  const gchar *needle = "meeting monday";
+  gdouble total = 0;
+  guint n_items = 50000;
+
+  if (!g_test_perf ())
+    return;
+
+  index = gn_search_index_new (NULL);
+  texts = g_ptr_array_new_with_free_func (g_free);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      gchar *text = create_text (100, FALSE);
+
+      g_ptr_array_add (texts, text);
+      gn_search_index_add (index, text, text);
+    }
+
+  /* Type the needle, then delete it, one character at a time */
+  for (guint i = 1; i <= 2 * strlen (needle) - 1; i++)
+    {
+      g_autoptr(GHashTable) items = NULL;
+      g_autofree gchar *part = NULL;
+      gsize length;
+      gdouble elapsed;
+      guint n_matches = 0;
+
+      length = i <= strlen (needle) ? i : 2 * strlen (needle) - i;
+      part = g_strndup (needle, length);
+
+      g_test_timer_start ();
+      items = gn_search_index_search (index, part, match_text, &n_matches);
+      elapsed = g_test_timer_elapsed ();
+      total += elapsed;
+
+      g_test_message ("\"%s\": %u results, %u matched, %.3f ms",
+                      part, g_hash_table_size (items), n_matches, elapsed * 1000);
+    }
+
+  g_test_minimized_result (total * 1000,
+                           "Typed and deleted \"%s\" on %u items in %.3f ms",
+                           needle, n_items, total * 1000);
+
+  gn_search_index_free (index);
+  g_ptr_array_unref (texts);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/search-index/lookup", test_search_index_lookup);
+  g_test_add_func ("/search-index/random", test_search_index_random);
+  g_test_add_func ("/search-index/search", test_search_index_search);
+  g_test_add_func ("/search-index/free-func", test_search_index_free_func);
+  g_test_add_func ("/search-index/perf/lookup", test_search_index_lookup_perf);
+  g_test_add_func ("/search-index/perf/typing", test_search_index_typing_perf);
+
+  return g_test_run ();
+}
@@ -0,0 +1,468 @@
+/* search-query.c
+ *
+ * Copyright 2018 Mohammed Sadiq <sadiq@sadiqpk.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "gn-search-index.h"
+#include "gn-search-query.h"
+#include "search-fixture.h"
+
+/* 2018-06-15 00:00:00 UTC */
+#define JUNE_2018 1529020800
+
+static GnSearchIndex *
+create_index (guint n_items,
+              guint n_words)
+{
+  GnSearchIndex *index;
+
+  index = gn_search_index_new (g_free);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autofree gchar *text = create_text (n_words, TRUE);
+
+      gn_search_index_add_full (index, g_strdup (text), text, NULL,
+                                JUNE_2018 - g_test_rand_int_range (0, 1000000));
+    }
+
+  return index;
+}
+
+static gboolean
+query_matches (const gchar *query_string,
+               const gchar *text,
+               const gchar *tags,
+               gint64       modification_time)
+{
+  g_autoptr(GnSearchQuery) query = NULL;
+  GnSearchDocument document;
+  const gchar *title_end;
+
+  title_end = strchr (text, '\n');
+  document.text = text;
+  document.title_length = title_end ? (gsize)(title_end - text) : strlen (text);
+  document.tags = tags ? tags : "\n";
+  document.modification_time = modification_time;
+
+  query = gn_search_query_new (query_string);
+
+  return gn_search_query_match (query, &document, modification_time, NULL);
+}
+
+static void
+test_search_query_match (void)
+{
+  const gchar *text = "shopping list\nmilk, bread and butter";
+  const gchar *tags = "\nhome\nfood\n";
+
+  /* Every term should match */
+  g_assert_true (query_matches ("milk", text, tags, 0));
+  g_assert_true (query_matches ("MILK Bread", text, tags, 0));
+  g_assert_true (query_matches ("  milk   shopping  ", text, tags, 0));
+  g_assert_false (query_matches ("milk eggs", text, tags, 0));
+
+  /* Phrases */
+  g_assert_true (query_matches ("\"bread and butter\"", text, tags, 0));
+  g_assert_false (query_matches ("\"butter and bread\"", text, tags, 0));
+  g_assert_true (query_matches ("\"and butter", text, tags, 0));
+
+  /* Excluded terms */
+  g_assert_true (query_matches ("milk -eggs", text, tags, 0));
+  g_assert_false (query_matches ("milk -bread", text, tags, 0));
+  g_assert_false (query_matches ("-\"bread and\"", text, tags, 0));
+  g_assert_true (query_matches ("-\"bread or\"", text, tags, 0));
+  g_assert_true (query_matches ("-", "a - b", NULL, 0));
+
+  /* Tags */
+  g_assert_true (query_matches ("tag:food", text, tags, 0));
+  g_assert_true (query_matches ("tag:Home milk", text, tags, 0));
+  g_assert_false (query_matches ("tag:foo", text, tags, 0));
+  g_assert_false (query_matches ("tag:work", text, tags, 0));
+  g_assert_false (query_matches ("-tag:food", text, tags, 0));
+  g_assert_true (query_matches ("-tag:work", text, tags, 0));
+  g_assert_false (query_matches ("tag:food", text, NULL, 0));
+
+  /* Dates.  The day boundaries are in local time, so keep a day off */
+  g_assert_true (query_matches ("after:2018-06-01", text, tags, JUNE_2018));
+  g_assert_false (query_matches ("after:2018-07-01", text, tags, JUNE_2018));
+  g_assert_true (query_matches ("before:2018-07-01", text, tags, JUNE_2018));
+  g_assert_false (query_matches ("before:2018-06-01", text, tags, JUNE_2018));
+  g_assert_true (query_matches ("after:2018-06-01 before:2018-07-01 milk",
+                                text, tags, JUNE_2018));
+  g_assert_false (query_matches ("after:2018-06-01 before:2018-07-01 eggs",
+                                 text, tags, JUNE_2018));
+
+  /* Invalid dates are searched as text */
+  g_assert_false (query_matches ("after:2018-13-01", text, tags, JUNE_2018));
+  g_assert_true (query_matches ("after:yesterday", "after:yesterday", NULL, 0));
+  g_assert_true (query_matches ("after:2018-02-30", "after:2018-02-30", NULL, JUNE_2018));
+  g_assert_true (query_matches ("after:2018-6-1", "after:2018-6-1", NULL, JUNE_2018));
+  g_assert_true (query_matches ("after:+2018-06-01", "after:+2018-06-01", NULL, JUNE_2018));
+  g_assert_true (query_matches ("before:2018-06-01x", "before:2018-06-01x", NULL, JUNE_2018));
+  g_assert_false (query_matches ("after:2018-6-1", text, tags, JUNE_2018));
+
+  /* An empty query matches everything */
+  g_assert_true (query_matches ("", text, tags, 0));
+  g_assert_true (query_matches ("\"\"", text, tags, 0));
+}
+
+static void
+test_search_query_rank (void)
+{
+  GnSearchIndex *index;
+  g_autoptr(GnSearchQuery) query = NULL;
+  g_autoptr(GPtrArray) items = NULL;
+  gchar *title = "title", *body = "body", *frequent = "frequent";
+  gchar *old = "old", *recent = "recent", *none = "none";
+  gint64 now = JUNE_2018;
+
+  index = gn_search_index_new (NULL);
+  gn_search_index_add_full (index, body, "notes\nsome milk", NULL, now - 100);
+  gn_search_index_add_full (index, title, "milk\nto buy", NULL, now - 100);
+  gn_search_index_add_full (index, frequent, "notes\nmilk milk milk", NULL, now - 100);
+  gn_search_index_add_full (index, none, "notes\nbread", NULL, now);
+
+  query = gn_search_query_new ("milk");
+  items = gn_search_query_run (query, index, now);
+  g_assert_cmpint (items->len, ==, 3);
+  g_assert_true (items->pdata[0] == title);
+  g_assert_true (items->pdata[1] == frequent);
+  g_assert_true (items->pdata[2] == body);
+  g_clear_pointer (&items, g_ptr_array_unref);
+  g_clear_pointer (&query, gn_search_query_free);
+
+  /* The recent one wins, if everything else is the same */
+  gn_search_index_add_full (index, old, "bread\nold", NULL, now - 365 * 24 * 3600);
+  gn_search_index_add_full (index, recent, "bread\nnew", NULL, now - 3600);
+  query = gn_search_query_new ("bread -notes");
+  items = gn_search_query_run (query, index, now);
+  g_assert_cmpint (items->len, ==, 2);
+  g_assert_true (items->pdata[0] == recent);
+  g_assert_true (items->pdata[1] == old);
+  g_clear_pointer (&items, g_ptr_array_unref);
+  g_clear_pointer (&query, gn_search_query_free);
+
+  /* Without text terms, every item is checked */
+  query = gn_search_query_new ("-milk");
+  items = gn_search_query_run (query, index, now);
+  g_assert_cmpint (items->len, ==, 3);
+  g_assert_true (items->pdata[0] == none);
+
+  gn_search_index_free (index);
+}
+
+static void
+test_search_query_regex (void)
+{
+  g_autoptr(GnSearchQuery) query = NULL;
+  const gchar *text = "shopping list\nmilk, bread and butter";
+  gint start, end;
+
+  g_assert_true (query_matches ("re:b[a-z]+d", text, NULL, 0));
+  g_assert_true (query_matches ("re:^shop", text, NULL, 0));
+  g_assert_true (query_matches ("re:MILK milk", text, NULL, 0));
+  g_assert_false (query_matches ("re:b[0-9]+d", text, NULL, 0));
+  g_assert_false (query_matches ("-re:b[a-z]+d", text, NULL, 0));
+  g_assert_true (query_matches ("-re:^bread", text, NULL, 0));
+
+  /* The title and the content are matched separately */
+  g_assert_true (query_matches ("re:list$", text, NULL, 0));
+  g_assert_true (query_matches ("re:^milk", text, NULL, 0));
+  g_assert_false (query_matches ("re:list\\smilk", text, NULL, 0));
+  g_assert_true (query_matches ("-re:list\\smilk", text, NULL, 0));
+
+  /* Invalid patterns, and quoted ones are searched as text */
+  g_assert_false (query_matches ("re:(milk", text, NULL, 0));
+  g_assert_true (query_matches ("re:(milk", "re:(milk", NULL, 0));
+  g_assert_false (query_matches ("\"re:milk\"", text, NULL, 0));
+
+  /* Matches are found in text that isn't casefolded */
+  query = gn_search_query_new ("bread re:m[a-z]+k -butter");
+  g_assert_true (gn_search_query_find (query, "Milk and BREAD, no Butter", -1, 0, &start, &end));
+  g_assert_cmpint (start, ==, 0);
+  g_assert_cmpint (end, ==, 4);
+  g_assert_true (gn_search_query_find (query, "Milk and BREAD, no Butter", -1, end, &start, &end));
+  g_assert_cmpint (start, ==, 9);
+  g_assert_cmpint (end, ==, 14);
+  g_assert_false (gn_search_query_find (query, "Milk and BREAD, no Butter", -1, end, NULL, NULL));
+  g_assert_false (gn_search_query_find (query, "Milk and BREAD", 3, 0, NULL, NULL));
+}
+
+static void
+test_search_query_find (void)
+{
+  g_autoptr(GnSearchQuery) query = NULL;
+  g_autoptr(GArray) matches = NULL;
+  GnSearchMatch *match;
+  gint start, end;
+
+  /* Matches are found as casefolded, and mapped back to the text */
+  query = gn_search_query_new ("ss");
+  g_assert_true (gn_search_query_find (query, "Straße", -1, 0, &start, &end));
+  g_assert_cmpint (start, ==, 4);
+  g_assert_cmpint (end, ==, 6);
+  g_clear_pointer (&query, gn_search_query_free);
+
+  query = gn_search_query_new ("re:se$");
+  g_assert_true (gn_search_query_find (query, "Straße", -1, 0, &start, &end));
+  g_assert_cmpint (start, ==, 4);
+  g_assert_cmpint (end, ==, 7);
+  g_assert_false (gn_search_query_find (query, "Straße", -1, 6, NULL, NULL));
+  g_clear_pointer (&query, gn_search_query_free);
+
+  query = gn_search_query_new ("bread re:m[a-z]+k -butter");
+  matches = gn_search_query_find_all (query, "Milk and BREAD, milk, butter", -1);
+  g_assert_cmpint (matches->len, ==, 3);
+  match = &g_array_index (matches, GnSearchMatch, 0);
+  g_assert_cmpint (match->start, ==, 0);
+  g_assert_cmpint (match->end, ==, 4);
+  match = &g_array_index (matches, GnSearchMatch, 1);
+  g_assert_cmpint (match->start, ==, 9);
+  g_assert_cmpint (match->end, ==, 14);
+  match = &g_array_index (matches, GnSearchMatch, 2);
+  g_assert_cmpint (match->start, ==, 16);
+  g_assert_cmpint (match->end, ==, 20);
+  g_clear_pointer (&matches, g_array_unref);
+  g_clear_pointer (&query, gn_search_query_free);
+
+  /* No match crosses the title and the content */
+  query = gn_search_query_new ("re:t\\sm re:^m");
+  matches = gn_search_query_find_all (query, "List\nMilk", -1);
+  g_assert_cmpint (matches->len, ==, 1);
+  match = &g_array_index (matches, GnSearchMatch, 0);
+  g_assert_cmpint (match->start, ==, 5);
+  g_assert_cmpint (match->end, ==, 6);
+  g_clear_pointer (&matches, g_array_unref);
+  g_clear_pointer (&query, gn_search_query_free);
+
+  /* Empty matches are skipped */
+  query = gn_search_query_new ("re:x*");
+  matches = gn_search_query_find_all (query, "ab x", -1);
+  g_assert_cmpint (matches->len, ==, 1);
+  match = &g_array_index (matches, GnSearchMatch, 0);
+  g_assert_cmpint (match->start, ==, 3);
+  g_assert_cmpint (match->end, ==, 4);
+}
+
+static gboolean
+query_matches_fuzzy (const gchar *query_string,
+                     const gchar *text,
+                     guint        max_distance,
+                     gdouble     *score)
+{
+  g_autoptr(GnSearchQuery) query = NULL;
+  GnSearchDocument document;
+  const gchar *title_end;
+
+  title_end = strchr (text, '\n');
+  document.text = text;
+  document.title_length = title_end ? (gsize)(title_end - text) : strlen (text);
+  document.tags = "\n";
+  document.modification_time = 0;
+
+  query = gn_search_query_new (query_string);
+  gn_search_query_set_max_distance (query, max_distance);
+
+  return gn_search_query_match (query, &document, 0, score);
+}
+
+static void
+test_search_query_fuzzy (void)
+{
+  const gchar *text = "meeting notes\ncall john on monday";
+  gdouble exact, one_edit, two_edits;
+
+  g_assert_false (query_matches_fuzzy ("meetign", text, 0, NULL));
+  g_assert_true (query_matches_fuzzy ("meetign", text, 2, NULL));
+  g_assert_true (query_matches_fuzzy ("meetign", text, 1, NULL));
+
+  /* Insertions, deletions and replacements */
+  g_assert_true (query_matches_fuzzy ("mondday", text, 1, NULL));
+  g_assert_true (query_matches_fuzzy ("mondy", text, 1, NULL));
+  g_assert_true (query_matches_fuzzy ("mondaj", text, 1, NULL));
+  g_assert_true (query_matches_fuzzy ("\"cal jon\"", text, 2, NULL));
+  g_assert_false (query_matches_fuzzy ("tuesday", text, 3, NULL));
+
+  /* Short terms and excluded terms should match exactly */
+  g_assert_false (query_matches_fuzzy ("cll", text, 3, NULL));
+  g_assert_true (query_matches_fuzzy ("-mondy", text, 3, NULL));
+  g_assert_false (query_matches_fuzzy ("-monday", text, 3, NULL));
+
+  /* Fewer edits rank first */
+  g_assert_true (query_matches_fuzzy ("monday", text, 2, &exact));
+  g_assert_true (query_matches_fuzzy ("mondy", text, 2, &one_edit));
+  g_assert_true (query_matches_fuzzy ("mondaaay", text, 2, &two_edits));
+  g_assert_cmpfloat (exact, >, one_edit);
+  g_assert_cmpfloat (one_edit, >, two_edits);
+
+  /* Typos in the title still rank higher */
+  g_assert_true (query_matches_fuzzy ("meetin", "meeting\nnotes", 2, &exact));
+  g_assert_true (query_matches_fuzzy ("meetin", "notes\nmeeting", 2, &one_edit));
+  g_assert_cmpfloat (exact, ==, one_edit + 10.0);
+}
+
+static void
+test_search_query_evaluate (void)
+{
+  GnSearchIndex *index;
+  g_autoptr(GnSearchQuery) query = NULL;
+  g_autoptr(GPtrArray) documents = NULL;
+  g_autoptr(GPtrArray) items = NULL;
+  g_autoptr(GCancellable) cancellable = NULL;
+  g_autoptr(GHashTable) expected = NULL;
+  GError *error = NULL;
+  gdouble last_score = G_MAXDOUBLE;
+
+  /* Enough items to be split into chunks */
+  index = create_index (20000, 10);
+  query = gn_search_query_new ("milk -tea");
+  documents = gn_search_query_collect (query, index);
+  expected = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+  for (guint i = 0; i < documents->len; i++)
+    {
+      const GnSearchDocument *document = documents->pdata[i];
+      gdouble score;
+
+      if (gn_search_query_match (query, document, JUNE_2018, &score))
+        g_hash_table_insert (expected, document->item, g_memdup (&score, sizeof score));
+    }
+
+  items = gn_search_query_evaluate (query, documents, JUNE_2018, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (items->len, ==, g_hash_table_size (expected));
+
+  /* Every match should be found once, the best first */
+  for (guint i = 0; i < items->len; i++)
+    {
+      gdouble *score = g_hash_table_lookup (expected, items->pdata[i]);
+
+      g_assert_nonnull (score);
+      g_assert_cmpfloat (*score, <=, last_score);
+      last_score = *score;
+      g_hash_table_remove (expected, items->pdata[i]);
+    }
+
+  g_clear_pointer (&items, g_ptr_array_unref);
+
+  /* The items in the documents live even after removed from the index */
+  gn_search_index_free (index);
+  items = gn_search_query_evaluate (query, documents, JUNE_2018, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (items->len, >, 0);
+  g_clear_pointer (&items, g_ptr_array_unref);
+
+  cancellable = g_cancellable_new ();
+  g_cancellable_cancel (cancellable);
+  items = gn_search_query_evaluate (query, documents, JUNE_2018, cancellable, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_null (items);
+  g_clear_error (&error);
+}
+
+static void
+test_search_query_fuzzy_perf (void)
+{
+  GnSearchIndex *index;
+  g_autoptr(GnSearchQuery) query = NULL;
+  g_autoptr(GPtrArray) documents = NULL;
+  g_autoptr(GPtrArray) items = NULL;
+  gdouble elapsed;
+  guint n_items = 50000;
+
+  if (!g_test_perf ())
+    return;
+
+  index = create_index (n_items, 100);
+  query = gn_search_query_new ("meetign mondya");
+  gn_search_query_set_max_distance (query, 2);
+  documents = gn_search_query_collect (query, index);
+
+  g_test_timer_start ();
+  items = gn_search_query_evaluate (query, documents, JUNE_2018, NULL, NULL);
+  elapsed = g_test_timer_elapsed ();
+
+  g_test_minimized_result (elapsed * 1000,
+                           "Matched %u items with typos in %.3f ms, %u found",
+                           documents->len, elapsed * 1000, items->len);
+
+  g_clear_pointer (&items, g_ptr_array_unref);
+  g_clear_pointer (&documents, g_ptr_array_unref);
+  gn_search_index_free (index);
+}
+
+static void
+test_search_query_evaluate_perf (void)
+{
+  GnSearchIndex *index;
+  g_autoptr(GnSearchQuery) query = NULL;
+  g_autoptr(GPtrArray) documents = NULL;
+  gdouble elapsed;
+  guint n_items = 100000;
+  guint n_runs = 20;
+  guint n_found = 0;
+
+  if (!g_test_perf ())
+    return;
+
+  index = create_index (n_items, 100);
+  query = gn_search_query_new ("-\"milk bread\"");
+  documents = gn_search_query_collect (query, index);
+
+  g_test_timer_start ();
+
+  for (guint i = 0; i < n_runs; i++)
+    {
+      g_autoptr(GPtrArray) items = NULL;
+
+      items = gn_search_query_evaluate (query, documents, JUNE_2018, NULL, NULL);
+      n_found += items->len;
+    }
+
+  elapsed = g_test_timer_elapsed ();
+  g_test_message ("Found %u items in total", n_found);
+  g_test_minimized_result (elapsed * 1000 / n_runs,
+                           "Evaluated %u items %u times in %.3f seconds, "
+                           "%.3f ms per run", documents->len, n_runs, elapsed,
+                           elapsed * 1000 / n_runs);
+
+  g_clear_pointer (&documents, g_ptr_array_unref);
+  gn_search_index_free (index);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/search-query/match", test_search_query_match);
+  g_test_add_func ("/search-query/rank", test_search_query_rank);
+  g_test_add_func ("/search-query/regex", test_search_query_regex);
+  g_test_add_func ("/search-query/find", test_search_query_find);
+  g_test_add_func ("/search-query/fuzzy", test_search_query_fuzzy);
+  g_test_add_func ("/search-query/evaluate", test_search_query_evaluate);
+  g_test_add_func ("/search-query/perf/fuzzy", test_search_query_fuzzy_perf);
+  g_test_add_func ("/search-query/perf/evaluate", test_search_query_evaluate_perf);
+
+  return g_test_run ();
+}
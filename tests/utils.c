@@ -19,6 +19,7 @@
  */
 
 #include <glib.h>
+#include <string.h>
 
 #include "gn-utils.h"
 
@@ -49,6 +50,316 @@ test_utils_main_thread (void)
   g_thread_join (thread);
 }
 
+static void
+test_utils_iso_time_round_trip (void)
+{
+  gint64 times[] = {
+    0, 1, 86399, 86400, 951782400 /* 2000-02-29 */, 1529601331,
+    4107542400 /* 2100-03-01 */, 253402300799 /* 9999-12-31T23:59:59 */,
+    -1, -86401, -2208988800 /* 1900-01-01 */,
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (times) + 1000; i++)
+    {
+      g_autoptr(GDateTime) date_time = NULL;
+      g_autofree gchar *expected = NULL;
+      gchar buffer[GN_ISO_TIME_BUFFER_SIZE];
+      gint64 unix_time, parsed_time;
+      gsize length;
+
+      if (i < G_N_ELEMENTS (times))
+        unix_time = times[i];
+      else
+        unix_time = g_test_rand_int_range (0, G_MAXINT32) * (gint64)4 - G_MAXINT32;
+
+      date_time = g_date_time_new_from_unix_utc (unix_time);
+      expected = g_date_time_format (date_time, "%FT%TZ");
+
+      length = gn_utils_unix_time_to_iso_buffer (unix_time, buffer);
+      g_assert_cmpstr (buffer, ==, expected);
+      g_assert_cmpint (length, ==, strlen (expected));
+
+      g_assert_true (gn_utils_iso_to_unix_time (buffer, -1, &parsed_time));
+      g_assert_cmpint (parsed_time, ==, unix_time);
+
+      /* The string need not be NUL terminated */
+      buffer[length] = 'x';
+      g_assert_true (gn_utils_iso_to_unix_time (buffer, length, &parsed_time));
+      g_assert_cmpint (parsed_time, ==, unix_time);
+    }
+}
+
+static void
+test_utils_iso_time_parse (void)
+{
+  const gchar *valid[] = {
+    "2018-06-21T17:15:31+05:30",
+    "2018-06-21T17:15:31.123Z",
+    "2018-06-21T17:15:31-01:00",
+  };
+  const gchar *invalid[] = {
+    "",
+    "garbage",
+    "2018-13-21T17:15:31Z",
+    "2018-02-29T17:15:31Z",
+    "2018-04-31T17:15:31Z",
+    "2018-06-21T24:15:31Z",
+    "2018-06-21T17:60:31Z",
+    "2018-06-21T17:15:60Z",
+    "2018-06-21 17:15:31Z",
+    "2018-0a-21T17:15:31Z",
+  };
+  gint64 unix_time;
+
+  /* Other formats should give the same result as GLib */
+  for (guint i = 0; i < G_N_ELEMENTS (valid); i++)
+    {
+      g_autoptr(GDateTime) date_time = NULL;
+
+      date_time = g_date_time_new_from_iso8601 (valid[i], NULL);
+      g_assert_nonnull (date_time);
+
+      g_assert_true (gn_utils_iso_to_unix_time (valid[i], -1, &unix_time));
+      g_assert_cmpint (unix_time, ==, g_date_time_to_unix (date_time));
+    }
+
+  for (guint i = 0; i < G_N_ELEMENTS (invalid); i++)
+    g_assert_false (gn_utils_iso_to_unix_time (invalid[i], -1, &unix_time));
+
+  g_assert_true (gn_utils_iso_to_unix_time ("2016-02-29T00:00:00Z", -1, &unix_time));
+  g_assert_cmpint (unix_time, ==, 1456704000);
+}
+
+static void
+test_utils_iso_time_perf (void)
+{
+  gchar buffer[GN_ISO_TIME_BUFFER_SIZE];
+  gdouble fast_time, glib_time;
+  gint64 unix_time;
+  guint n_items = 1000000;
+
+  if (!g_test_perf ())
+    return;
+
+  gn_utils_unix_time_to_iso_buffer (1529601331, buffer);
+
+  g_test_timer_start ();
+  for (guint i = 0; i < n_items; i++)
+    gn_utils_iso_to_unix_time (buffer, -1, &unix_time);
+  fast_time = g_test_timer_elapsed ();
+
+  g_test_timer_start ();
+  for (guint i = 0; i < n_items; i++)
+    {
+      GDateTime *date_time;
+
+      date_time = g_date_time_new_from_iso8601 (buffer, NULL);
+      unix_time = g_date_time_to_unix (date_time);
+      g_date_time_unref (date_time);
+    }
+  glib_time = g_test_timer_elapsed ();
+
+  g_test_minimized_result (fast_time, "Parsed %u times in %.3f seconds (GLib: %.3f seconds)",
+                           n_items, fast_time, glib_time);
+
+  g_test_timer_start ();
+  for (guint i = 0; i < n_items; i++)
+    gn_utils_unix_time_to_iso_buffer (unix_time + i, buffer);
+  fast_time = g_test_timer_elapsed ();
+
+  g_test_timer_start ();
+  for (guint i = 0; i < n_items; i++)
+    {
+      GDateTime *date_time;
+
+      date_time = g_date_time_new_from_unix_utc (unix_time + i);
+      g_free (g_date_time_format (date_time, "%FT%TZ"));
+      g_date_time_unref (date_time);
+    }
+  glib_time = g_test_timer_elapsed ();
+
+  g_test_minimized_result (fast_time, "Formatted %u times in %.3f seconds (GLib: %.3f seconds)",
+                           n_items, fast_time, glib_time);
+}
+
+static gboolean
+casefold_contains (const gchar *haystack,
+                   const gchar *needle)
+{
+  g_autofree gchar *casefold = NULL;
+
+  casefold = g_utf8_casefold (haystack, -1);
+
+  return strstr (casefold, needle) != NULL;
+}
+
+/* Create a random string of @length bytes, with characters around the ASCII letters */
+static gchar *
+create_random_string (guint    length,
+                      gboolean ascii)
+{
+  const gchar chars[] = "aAbByYzZ@[`{ 09";
+  GString *str;
+
+  str = g_string_new (NULL);
+
+  for (guint i = 0; i < length; i++)
+    {
+      if (!ascii && g_test_rand_int_range (0, 50) == 0)
+        g_string_append (str, "É");
+      else
+        g_string_append_c (str, chars[g_test_rand_int_range (0, strlen (chars))]);
+    }
+
+  return g_string_free (str, FALSE);
+}
+
+static void
+test_utils_casefold_contains (void)
+{
+  const gchar *haystack = "Shopping List: MILK, bread and Butter";
+
+  g_assert_true (gn_utils_str_casefold_contains (haystack, -1, "milk"));
+  g_assert_true (gn_utils_str_casefold_contains (haystack, -1, "shopping"));
+  g_assert_true (gn_utils_str_casefold_contains (haystack, -1, "butter"));
+  g_assert_true (gn_utils_str_casefold_contains (haystack, -1, ""));
+  g_assert_false (gn_utils_str_casefold_contains (haystack, -1, "eggs"));
+  g_assert_false (gn_utils_str_casefold_contains (haystack, -1, "butter!"));
+  g_assert_false (gn_utils_str_casefold_contains (haystack, -1, "brëad"));
+  g_assert_false (gn_utils_str_casefold_contains (haystack, 12, "list"));
+  g_assert_true (gn_utils_str_casefold_contains (haystack, 13, "list"));
+
+  /* Non ASCII text is casefolded */
+  g_assert_true (gn_utils_str_casefold_contains ("CRÈME BRÛLÉE", -1, "brûlée"));
+  g_assert_false (gn_utils_str_casefold_contains ("CRÈME BRÛLÉE", -1, "brulee"));
+
+  /* Check with the SIMD block sizes and the bytes around the letters */
+  for (guint i = 0; i < 2000; i++)
+    {
+      g_autofree gchar *str = NULL;
+      g_autofree gchar *needle = NULL;
+      gsize length;
+
+      str = create_random_string (g_test_rand_int_range (0, 100), i % 2);
+      length = strlen (str);
+
+      if (length > 0 && g_test_rand_bit ())
+        {
+          gsize start = g_test_rand_int_range (0, length);
+          gsize end = g_test_rand_int_range (start, length + 1);
+          g_autofree gchar *part = NULL;
+
+          /* Don't split multibyte characters */
+          while (start > 0 && (str[start] & 0xC0) == 0x80)
+            start--;
+          while (end < length && (str[end] & 0xC0) == 0x80)
+            end++;
+
+          part = g_strndup (str + start, end - start);
+          needle = g_utf8_casefold (part, -1);
+        }
+      else
+        {
+          g_autofree gchar *part = NULL;
+
+          part = create_random_string (g_test_rand_int_range (1, 4), i % 2);
+          needle = g_utf8_casefold (part, -1);
+        }
+
+      g_assert_cmpint (gn_utils_str_casefold_contains (str, -1, needle), ==,
+                       casefold_contains (str, needle));
+    }
+}
+
+static void
+test_utils_str_find (void)
+{
+  const gchar *haystack = "milk, bread, milk and butter\nbrëad";
+
+  g_assert_true (gn_utils_str_find (haystack, strlen (haystack), "milk", 4) == haystack);
+  g_assert_true (gn_utils_str_find (haystack + 1, strlen (haystack) - 1, "milk", 4) == haystack + 13);
+  g_assert_true (gn_utils_str_find (haystack, strlen (haystack), "brëad", strlen ("brëad")) ==
+                 strstr (haystack, "brëad"));
+  g_assert_true (gn_utils_str_find (haystack, strlen (haystack), "", 0) == haystack);
+  g_assert_null (gn_utils_str_find (haystack, strlen (haystack), "Milk", 4));
+  g_assert_null (gn_utils_str_find (haystack, 16, "milk", 4));
+  g_assert_nonnull (gn_utils_str_find (haystack, 17, "milk", 4));
+
+  /* Check with the SIMD block sizes against strstr() */
+  for (guint i = 0; i < 2000; i++)
+    {
+      g_autofree gchar *text = NULL;
+      g_autofree gchar *str = NULL;
+      g_autofree gchar *needle = NULL;
+      gsize length;
+
+      text = create_random_string (g_test_rand_int_range (0, 100), i % 2);
+      str = g_utf8_casefold (text, -1);
+      length = strlen (str);
+
+      if (length > 0 && g_test_rand_bit ())
+        {
+          gsize start = g_test_rand_int_range (0, length);
+          gsize end = g_test_rand_int_range (start, length + 1);
+
+          needle = g_strndup (str + start, MAX (end - start, 1));
+        }
+      else
+        {
+          g_autofree gchar *part = NULL;
+
+          part = create_random_string (g_test_rand_int_range (1, 4), i % 2);
+          needle = g_utf8_casefold (part, -1);
+        }
+
+      g_assert_true (gn_utils_str_find (str, length, needle, strlen (needle)) ==
+                     strstr (str, needle));
+    }
+}
+
+static void
+test_utils_casefold_contains_perf (void)
+{
+  g_autoptr(GPtrArray) texts = NULL;
+  const gchar *needles[] = { "meeting", "zzz", "a", "friday call" };
+  gdouble fast_time, glib_time;
+  guint n_found = 0, n_found_glib = 0;
+  guint n_items = 10000;
+
+  if (!g_test_perf ())
+    return;
+
+  texts = g_ptr_array_new_with_free_func (g_free);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      GString *text = g_string_new (NULL);
+
+      /* About 2 KiB of text, as in a usual note */
+      for (guint j = 0; j < 40; j++)
+        g_string_append (text, j % 2 ? "Meeting notes on Monday, " : "call Mom on FRIDAY. ");
+
+      g_ptr_array_add (texts, g_string_free (text, FALSE));
+    }
+
+  g_test_timer_start ();
+  for (guint i = 0; i < texts->len; i++)
+    for (guint j = 0; j < G_N_ELEMENTS (needles); j++)
+      n_found += gn_utils_str_casefold_contains (texts->pdata[i], -1, needles[j]);
+  fast_time = g_test_timer_elapsed ();
+
+  g_test_timer_start ();
+  for (guint i = 0; i < texts->len; i++)
+    for (guint j = 0; j < G_N_ELEMENTS (needles); j++)
+      n_found_glib += casefold_contains (texts->pdata[i], needles[j]);
+  glib_time = g_test_timer_elapsed ();
+
+  g_assert_cmpint (n_found, ==, n_found_glib);
+  g_test_minimized_result (fast_time, "Searched %u texts %u times in %.3f seconds "
+                           "(casefold and strstr: %.3f seconds)",
+                           n_items, (guint)G_N_ELEMENTS (needles), fast_time, glib_time);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -56,6 +367,12 @@ main (int   argc,
   g_test_init (&argc, &argv, NULL);
 
   g_test_add_func ("/utils/main_thread", test_utils_main_thread);
+  g_test_add_func ("/utils/iso_time/round_trip", test_utils_iso_time_round_trip);
+  g_test_add_func ("/utils/iso_time/parse", test_utils_iso_time_parse);
+  g_test_add_func ("/utils/iso_time/perf", test_utils_iso_time_perf);
+  g_test_add_func ("/utils/casefold_contains", test_utils_casefold_contains);
+  g_test_add_func ("/utils/str_find", test_utils_str_find);
+  g_test_add_func ("/utils/casefold_contains/perf", test_utils_casefold_contains_perf);
 
   return g_test_run ();
 }
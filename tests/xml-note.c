@@ -22,6 +22,20 @@
 
 #include "gn-xml-note.h"
 
+#define BIJIBEN_2_NOTE \
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" \
+  "<note version=\"2\" xmlns:link=\"http://projects.gnome.org/bijiben/link\" " \
+  "xmlns:size=\"http://projects.gnome.org/bijiben/size\" " \
+  "xmlns=\"http://projects.gnome.org/bijiben\">\n" \
+  "<title>Shopping list</title>\n" \
+  "<last-change-date>2018-06-24T09:10:07Z</last-change-date>\n" \
+  "<last-metadata-change-date>2018-06-24T09:10:07Z</last-metadata-change-date>\n" \
+  "<create-date>2018-06-21T17:15:31Z</create-date>\n" \
+  "<color>rgb(114,159,207)</color>\n" \
+  "<tags>\n<tag>Personal</tag>\n<tag>Home</tag>\n</tags>\n" \
+  "<text xml:space=\"preserve\"><note-content>Milk, <b>eggs</b>" \
+  "</note-content></text></note>\n"
+
 struct Note
 {
   gchar *file_content;
@@ -257,6 +271,333 @@ test_xml_note_markup (gconstpointer user_data)
   g_assert_cmpstr (markup, ==, test_note.markup);
 }
 
+static void
+test_xml_note_markup_tags (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autofree gchar *markup = NULL;
+  const gchar *data;
+
+  /* Overlapping and nested tags of the same kind */
+  data = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<note version=\"2\" xmlns:link=\"http://projects.gnome.org/bijiben/link\" "
+    "xmlns:size=\"http://projects.gnome.org/bijiben/size\" "
+    "xmlns=\"http://projects.gnome.org/bijiben\">\n"
+    "<title>Shopping list</title>\n"
+    "<text xml:space=\"preserve\"><note-content>Milk, <b>eggs <i>and</b> bread</i>"
+    " &amp; <b><b>jam</b></b></note-content></text></note>\n";
+
+  xml_note = gn_xml_note_new_from_data (data, -1, NULL);
+  g_assert_true (GN_IS_XML_NOTE (xml_note));
+
+  markup = gn_note_get_markup (GN_NOTE (xml_note));
+  g_assert_cmpstr (markup, ==, "<markup><span font='Cantarell'>Milk, <b>eggs <i>and</i></b>"
+                   "<i> bread</i> &amp; <b>jam</b></span></markup>");
+}
+
+static void
+test_xml_note_metadata (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autoptr(GnXmlNote) cached_note = NULL;
+  g_autoptr(GVariant) metadata = NULL;
+  g_autoptr(GFileIOStream) stream = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *content = NULL;
+  g_autofree gchar *cached_content = NULL;
+  GnTagStore *tag_store;
+  GList *tags, *cached_tags;
+  GdkRGBA rgba, cached_rgba;
+  const gchar *data;
+
+  data = BIJIBEN_2_NOTE;
+
+  file = g_file_new_tmp ("gn-note-XXXXXX.note", &stream, &error);
+  g_assert_no_error (error);
+  g_file_replace_contents (file, data, strlen (data),
+                           NULL, FALSE, 0, NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  tag_store = gn_tag_store_new ();
+
+  xml_note = gn_xml_note_new_from_data (data, -1, tag_store);
+  g_assert_true (GN_IS_XML_NOTE (xml_note));
+
+  metadata = gn_xml_note_get_metadata (xml_note);
+  g_assert_nonnull (metadata);
+  g_variant_ref_sink (metadata);
+  g_assert_true (g_variant_is_of_type (metadata,
+                                       G_VARIANT_TYPE (GN_XML_NOTE_METADATA_TYPE)));
+
+  cached_note = gn_xml_note_new_from_file (file, metadata, tag_store, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (GN_IS_XML_NOTE (cached_note));
+
+  g_assert_cmpstr (gn_item_get_title (GN_ITEM (cached_note)), ==,
+                   gn_item_get_title (GN_ITEM (xml_note)));
+  g_assert_cmpint (gn_item_get_creation_time (GN_ITEM (cached_note)), ==,
+                   gn_item_get_creation_time (GN_ITEM (xml_note)));
+  g_assert_cmpint (gn_item_get_modification_time (GN_ITEM (cached_note)), ==,
+                   gn_item_get_modification_time (GN_ITEM (xml_note)));
+  g_assert_cmpint (gn_item_get_meta_modification_time (GN_ITEM (cached_note)), ==,
+                   gn_item_get_meta_modification_time (GN_ITEM (xml_note)));
+
+  g_assert_true (gn_item_get_rgba (GN_ITEM (xml_note), &rgba));
+  g_assert_true (gn_item_get_rgba (GN_ITEM (cached_note), &cached_rgba));
+  g_assert_true (gdk_rgba_equal (&rgba, &cached_rgba));
+
+  tags = gn_note_get_tags (GN_NOTE (xml_note));
+  cached_tags = gn_note_get_tags (GN_NOTE (cached_note));
+  g_assert_cmpint (g_list_length (tags), ==, 2);
+  g_assert_cmpint (g_list_length (cached_tags), ==, 2);
+
+  for (; tags != NULL; tags = tags->next, cached_tags = cached_tags->next)
+    g_assert_true (tags->data == cached_tags->data);
+
+  content = gn_note_get_raw_content (GN_NOTE (xml_note));
+  cached_content = gn_note_get_raw_content (GN_NOTE (cached_note));
+  g_assert_cmpstr (content, ==, cached_content);
+
+  g_file_delete (file, NULL, NULL);
+
+  g_clear_object (&xml_note);
+  g_clear_object (&cached_note);
+  gn_tag_store_free (tag_store);
+}
+
+static void
+test_xml_note_lazy (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autoptr(GnXmlNote) cached_note = NULL;
+  g_autoptr(GVariant) metadata = NULL;
+  g_autoptr(GFileIOStream) stream = NULL;
+  g_autoptr(GFileIOStream) moved_stream = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GFile) moved_file = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *content = NULL;
+  GnTagStore *tag_store;
+
+  file = g_file_new_tmp ("gn-note-XXXXXX.note", &stream, &error);
+  g_assert_no_error (error);
+  g_file_replace_contents (file, BIJIBEN_2_NOTE, strlen (BIJIBEN_2_NOTE),
+                           NULL, FALSE, 0, NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  tag_store = gn_tag_store_new ();
+
+  xml_note = gn_xml_note_new_from_file (file, NULL, tag_store, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (GN_IS_XML_NOTE (xml_note));
+  g_assert_true (g_object_get_data (G_OBJECT (xml_note), "file") == file);
+
+  g_assert_cmpstr (gn_item_get_title (GN_ITEM (xml_note)), ==, "Shopping list");
+  g_assert_cmpint (g_list_length (gn_note_get_tags (GN_NOTE (xml_note))), ==, 2);
+
+  metadata = gn_xml_note_get_metadata (xml_note);
+  g_assert_nonnull (metadata);
+  g_variant_ref_sink (metadata);
+
+  /* The file shouldn’t be read if metadata is given */
+  cached_note = gn_xml_note_new_from_file (file, metadata, tag_store, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (gn_item_get_title (GN_ITEM (cached_note)), ==, "Shopping list");
+  g_assert_cmpint (gn_item_get_creation_time (GN_ITEM (cached_note)), ==,
+                   gn_item_get_creation_time (GN_ITEM (xml_note)));
+
+  /* Content is loaded from the file on demand */
+  content = gn_note_get_raw_content (GN_NOTE (cached_note));
+  g_assert_cmpstr (content, ==, BIJIBEN_2_NOTE);
+  g_clear_pointer (&content, g_free);
+
+  g_assert_true (gn_item_match (GN_ITEM (xml_note), "eggs"));
+
+  /* Content is loaded from the file set last, say once trashed */
+  g_clear_object (&cached_note);
+  moved_file = g_file_new_tmp ("gn-note-XXXXXX.note", &moved_stream, &error);
+  g_assert_no_error (error);
+  g_file_move (file, moved_file, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, &error);
+  g_assert_no_error (error);
+  cached_note = gn_xml_note_new_from_file (file, metadata, tag_store, NULL, &error);
+  g_assert_no_error (error);
+  gn_xml_note_set_file (cached_note, moved_file);
+  g_assert_true (g_object_get_data (G_OBJECT (cached_note), "file") == moved_file);
+  content = gn_note_get_raw_content (GN_NOTE (cached_note));
+  g_assert_cmpstr (content, ==, BIJIBEN_2_NOTE);
+  g_clear_pointer (&content, g_free);
+  g_file_delete (moved_file, NULL, NULL);
+
+  g_file_delete (file, NULL, NULL);
+
+  /* Content that can’t be loaded shouldn’t be replaced with an empty one */
+  g_clear_object (&cached_note);
+  cached_note = gn_xml_note_new_from_file (file, metadata, tag_store, NULL, &error);
+  g_assert_no_error (error);
+  g_test_expect_message ("gn-xml-note", G_LOG_LEVEL_WARNING,
+                         "Failed to load note content*");
+  content = gn_note_get_raw_content (GN_NOTE (cached_note));
+  g_test_assert_expected_messages ();
+  g_assert_null (content);
+
+  g_clear_object (&xml_note);
+  g_clear_object (&cached_note);
+  gn_tag_store_free (tag_store);
+}
+
+static void
+test_xml_note_parse_fallback (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  GnTagStore *tag_store;
+  const gchar *data;
+
+  /* Entities in values are handled by the XML reader */
+  data = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<note version=\"2\" xmlns:link=\"http://projects.gnome.org/bijiben/link\" "
+    "xmlns:size=\"http://projects.gnome.org/bijiben/size\" "
+    "xmlns=\"http://projects.gnome.org/bijiben\">\n"
+    "<title>Salt &amp; Pepper</title>\n"
+    "<create-date>2018-06-21T17:15:31Z</create-date>\n"
+    "<tags>\n<tag>Home</tag>\n</tags>\n"
+    "<text xml:space=\"preserve\"><note-content></note-content></text></note>\n";
+
+  tag_store = gn_tag_store_new ();
+  xml_note = gn_xml_note_new_from_data (data, -1, tag_store);
+  g_assert_true (GN_IS_XML_NOTE (xml_note));
+
+  g_assert_cmpstr (gn_item_get_title (GN_ITEM (xml_note)), ==, "Salt & Pepper");
+  g_assert_cmpint (gn_item_get_creation_time (GN_ITEM (xml_note)), ==, 1529601331);
+  g_assert_cmpint (g_list_length (gn_note_get_tags (GN_NOTE (xml_note))), ==, 1);
+
+  g_clear_object (&xml_note);
+  gn_tag_store_free (tag_store);
+}
+
+static void
+test_xml_note_convert_legacy (void)
+{
+  g_autoptr(GnXmlNote) xml_note = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *converted = NULL;
+  g_autofree gchar *text = NULL;
+  GnTagStore *tag_store;
+  const gchar *tomboy_note, *bijiben_note;
+
+  tomboy_note = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<note version=\"0.3\" xmlns:link=\"http://beatniksoftware.com/tomboy/link\" "
+    "xmlns:size=\"http://beatniksoftware.com/tomboy/size\" "
+    "xmlns=\"http://beatniksoftware.com/tomboy\">\n"
+    "  <title>Tomboy note</title>\n"
+    "  <text xml:space=\"preserve\"><note-content version=\"0.1\">Tomboy note\n"
+    "Some <bold>bold <italic>text</italic></bold> &amp; <size:large>more</size:large>\n"
+    "</note-content></text>\n"
+    "  <last-change-date>2018-11-02T14:19:57.3370000+05:30</last-change-date>\n"
+    "  <last-metadata-change-date>2018-11-02T14:19:57.3370000+05:30</last-metadata-change-date>\n"
+    "  <create-date>2018-11-02T14:19:57.3370000+05:30</create-date>\n"
+    "  <tags>\n    <tag>system:notebook:Work</tag>\n    <tag>system:template</tag>\n  </tags>\n"
+    "</note>";
+
+  tag_store = gn_tag_store_new ();
+  xml_note = gn_xml_note_new_from_data (tomboy_note, -1, tag_store);
+  g_assert_true (GN_IS_XML_NOTE (xml_note));
+  g_assert_true (gn_xml_note_is_legacy (xml_note));
+  g_assert_null (gn_xml_note_get_metadata (xml_note));
+
+  g_assert_cmpstr (gn_item_get_title (GN_ITEM (xml_note)), ==, "Tomboy note");
+  g_assert_cmpint (gn_item_get_creation_time (GN_ITEM (xml_note)), ==, 1541148597);
+  g_assert_cmpint (g_list_length (gn_note_get_tags (GN_NOTE (xml_note))), ==, 1);
+  g_assert_cmpstr (gn_tag_get_name (gn_note_get_tags (GN_NOTE (xml_note))->data), ==, "Work");
+
+  /* The converted body is searchable */
+  text = gn_note_get_text_content (GN_NOTE (xml_note));
+  g_assert_nonnull (text);
+  g_assert_nonnull (strstr (text, "bold text"));
+  g_assert_true (gn_item_match (GN_ITEM (xml_note), "bold text"));
+  g_assert_false (gn_item_match (GN_ITEM (xml_note), "italic"));
+
+  converted = gn_xml_note_convert_legacy (tomboy_note, -1, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (strstr (converted, "<note version=\"2\" "));
+  g_assert_nonnull (strstr (converted, "<title>Tomboy note</title>"));
+  g_assert_nonnull (strstr (converted, "<create-date>2018-11-02T08:49:57Z</create-date>"));
+  g_assert_nonnull (strstr (converted, "<note-content>Some <b>bold <i>text</i></b> &amp; more"
+                            "</note-content>"));
+  g_clear_pointer (&converted, g_free);
+
+  /* Tags continued from the title may be closed out of order */
+  tomboy_note = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+    "<note version=\"0.3\" xmlns=\"http://beatniksoftware.com/tomboy\">\n"
+    "  <title>Title x</title>\n"
+    "  <text xml:space=\"preserve\"><note-content version=\"0.1\">"
+    "<italic>Title <bold>x\nbody</bold> more</italic> end</note-content></text>\n"
+    "</note>";
+
+  converted = gn_xml_note_convert_legacy (tomboy_note, -1, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (strstr (converted, "<note-content><b><i>body</i></b><i> more</i> end"
+                            "</note-content>"));
+  g_clear_pointer (&converted, g_free);
+
+  bijiben_note = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<note version=\"1\" xmlns:link=\"http://projects.gnome.org/bijiben/link\" "
+    "xmlns:size=\"http://projects.gnome.org/bijiben/size\" "
+    "xmlns=\"http://projects.gnome.org/bijiben\">\n"
+    "  <title>My title</title>\n"
+    "  <text xml:space=\"preserve\"><html xmlns=\"http://www.w3.org/1999/xhtml\"><head></head>"
+    "<body contenteditable=\"true\" id=\"editable\"><div>My title</div><div>Line <b>one</b></div>"
+    "<div><br /></div><div>Line <strike>two</strike></div></body></html></text>\n"
+    "  <last-change-date>2018-11-08T13:23:44Z</last-change-date>\n"
+    "  <create-date>2018-11-08T13:23:38Z</create-date>\n"
+    "  <color>rgb(150,12,12)</color>\n"
+    "</note>";
+
+  converted = gn_xml_note_convert_legacy (bijiben_note, -1, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (strstr (converted, "<title>My title</title>"));
+  g_assert_nonnull (strstr (converted, "<color>rgb(150,12,12)</color>"));
+  g_assert_nonnull (strstr (converted, "<note-content>Line <b>one</b>\n\nLine <s>two</s>"
+                            "</note-content>"));
+  g_clear_pointer (&converted, g_free);
+
+  /* Notes in current format are not converted */
+  converted = gn_xml_note_convert_legacy (BIJIBEN_2_NOTE, -1, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+  g_assert_null (converted);
+
+  g_clear_object (&xml_note);
+  gn_tag_store_free (tag_store);
+}
+
+static void
+test_xml_note_parse_perf (void)
+{
+  GnTagStore *tag_store;
+  gdouble elapsed;
+  guint n_notes = 20000;
+
+  if (!g_test_perf ())
+    return;
+
+  tag_store = gn_tag_store_new ();
+  g_test_timer_start ();
+
+  for (guint i = 0; i < n_notes; i++)
+    {
+      GnXmlNote *xml_note;
+
+      xml_note = gn_xml_note_new_from_data (BIJIBEN_2_NOTE, -1, tag_store);
+      g_object_unref (xml_note);
+    }
+
+  elapsed = g_test_timer_elapsed ();
+  g_test_minimized_result (elapsed * G_USEC_PER_SEC / n_notes,
+                           "Parsed %u notes in %.3f seconds, %.2f µs per note",
+                           n_notes, elapsed, elapsed * G_USEC_PER_SEC / n_notes);
+  gn_tag_store_free (tag_store);
+}
+
 int
 main (int   argc,
       char *argv[])
@@ -269,6 +610,12 @@ main (int   argc,
   g_test_init (&argc, &argv, NULL);
 
   g_test_add_func ("/note/xml/empty", test_xml_note_empty);
+  g_test_add_func ("/note/xml/markup-tags", test_xml_note_markup_tags);
+  g_test_add_func ("/note/xml/metadata", test_xml_note_metadata);
+  g_test_add_func ("/note/xml/lazy", test_xml_note_lazy);
+  g_test_add_func ("/note/xml/parse-fallback", test_xml_note_parse_fallback);
+  g_test_add_func ("/note/xml/convert-legacy", test_xml_note_convert_legacy);
+  g_test_add_func ("/note/xml/perf/parse", test_xml_note_parse_perf);
 
   path = g_test_build_filename (G_TEST_DIST, "xml-notes", NULL);
   dir = g_dir_open (path, 0, &error);